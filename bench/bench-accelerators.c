@@ -0,0 +1,410 @@
+/*
+Micro-benchmark for egg_accelerator_parse_virtual().
+
+Before timing anything, the parser is checked against the implementation
+it replaced on a generated corpus, so a speedup can't hide a change in
+behaviour.  The timings use a handful of recurring accelerators instead,
+like the few hotkeys a panel actually has, parsed with the keyval name
+cache cold and warm.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtk/gtk.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Pulled in rather than linked so the keyval name cache can be emptied */
+#include "eggaccelerators.c"
+
+#define CORPUS_SIZE 100000
+#define ROUNDS 20
+#define COLD_ROUNDS 200
+
+static inline gboolean is_alt(const gchar *string) {
+  return ((string[0] == '<') && (string[1] == 'a' || string[1] == 'A') &&
+          (string[2] == 'l' || string[2] == 'L') &&
+          (string[3] == 't' || string[3] == 'T') && (string[4] == '>'));
+}
+
+static inline gboolean is_ctl(const gchar *string) {
+  return ((string[0] == '<') && (string[1] == 'c' || string[1] == 'C') &&
+          (string[2] == 't' || string[2] == 'T') &&
+          (string[3] == 'l' || string[3] == 'L') && (string[4] == '>'));
+}
+
+static inline gboolean is_modx(const gchar *string) {
+  return ((string[0] == '<') && (string[1] == 'm' || string[1] == 'M') &&
+          (string[2] == 'o' || string[2] == 'O') &&
+          (string[3] == 'd' || string[3] == 'D') &&
+          (string[4] >= '1' && string[4] <= '5') && (string[5] == '>'));
+}
+
+static inline gboolean is_ctrl(const gchar *string) {
+  return ((string[0] == '<') && (string[1] == 'c' || string[1] == 'C') &&
+          (string[2] == 't' || string[2] == 'T') &&
+          (string[3] == 'r' || string[3] == 'R') &&
+          (string[4] == 'l' || string[4] == 'L') && (string[5] == '>'));
+}
+
+static inline gboolean is_shft(const gchar *string) {
+  return ((string[0] == '<') && (string[1] == 's' || string[1] == 'S') &&
+          (string[2] == 'h' || string[2] == 'H') &&
+          (string[3] == 'f' || string[3] == 'F') &&
+          (string[4] == 't' || string[4] == 'T') && (string[5] == '>'));
+}
+
+static inline gboolean is_shift(const gchar *string) {
+  return ((string[0] == '<') && (string[1] == 's' || string[1] == 'S') &&
+          (string[2] == 'h' || string[2] == 'H') &&
+          (string[3] == 'i' || string[3] == 'I') &&
+          (string[4] == 'f' || string[4] == 'F') &&
+          (string[5] == 't' || string[5] == 'T') && (string[6] == '>'));
+}
+
+static inline gboolean is_control(const gchar *string) {
+  return ((string[0] == '<') && (string[1] == 'c' || string[1] == 'C') &&
+          (string[2] == 'o' || string[2] == 'O') &&
+          (string[3] == 'n' || string[3] == 'N') &&
+          (string[4] == 't' || string[4] == 'T') &&
+          (string[5] == 'r' || string[5] == 'R') &&
+          (string[6] == 'o' || string[6] == 'O') &&
+          (string[7] == 'l' || string[7] == 'L') && (string[8] == '>'));
+}
+
+static inline gboolean is_release(const gchar *string) {
+  return ((string[0] == '<') && (string[1] == 'r' || string[1] == 'R') &&
+          (string[2] == 'e' || string[2] == 'E') &&
+          (string[3] == 'l' || string[3] == 'L') &&
+          (string[4] == 'e' || string[4] == 'E') &&
+          (string[5] == 'a' || string[5] == 'A') &&
+          (string[6] == 's' || string[6] == 'S') &&
+          (string[7] == 'e' || string[7] == 'E') && (string[8] == '>'));
+}
+
+static inline gboolean is_meta(const gchar *string) {
+  return ((string[0] == '<') && (string[1] == 'm' || string[1] == 'M') &&
+          (string[2] == 'e' || string[2] == 'E') &&
+          (string[3] == 't' || string[3] == 'T') &&
+          (string[4] == 'a' || string[4] == 'A') && (string[5] == '>'));
+}
+
+static inline gboolean is_super(const gchar *string) {
+  return ((string[0] == '<') && (string[1] == 's' || string[1] == 'S') &&
+          (string[2] == 'u' || string[2] == 'U') &&
+          (string[3] == 'p' || string[3] == 'P') &&
+          (string[4] == 'e' || string[4] == 'E') &&
+          (string[5] == 'r' || string[5] == 'R') && (string[6] == '>'));
+}
+
+static inline gboolean is_hyper(const gchar *string) {
+  return ((string[0] == '<') && (string[1] == 'h' || string[1] == 'H') &&
+          (string[2] == 'y' || string[2] == 'Y') &&
+          (string[3] == 'p' || string[3] == 'P') &&
+          (string[4] == 'e' || string[4] == 'E') &&
+          (string[5] == 'r' || string[5] == 'R') && (string[6] == '>'));
+}
+
+/* egg_accelerator_parse_virtual() before the table driven rewrite */
+static gboolean legacy_parse_virtual(const gchar *accelerator,
+                                     guint *accelerator_key,
+                                     EggVirtualModifierType *accelerator_mods) {
+  guint keyval;
+  GdkModifierType mods;
+  gint len;
+  gboolean bad_keyval;
+
+  if (accelerator_key) *accelerator_key = 0;
+  if (accelerator_mods) *accelerator_mods = 0;
+
+  g_return_val_if_fail(accelerator != NULL, FALSE);
+
+  bad_keyval = FALSE;
+
+  keyval = 0;
+  mods = 0;
+  len = strlen(accelerator);
+  while (len) {
+    if (*accelerator == '<') {
+      if (len >= 9 && is_release(accelerator)) {
+        accelerator += 9;
+        len -= 9;
+        mods |= EGG_VIRTUAL_RELEASE_MASK;
+      } else if (len >= 9 && is_control(accelerator)) {
+        accelerator += 9;
+        len -= 9;
+        mods |= EGG_VIRTUAL_CONTROL_MASK;
+      } else if (len >= 7 && is_shift(accelerator)) {
+        accelerator += 7;
+        len -= 7;
+        mods |= EGG_VIRTUAL_SHIFT_MASK;
+      } else if (len >= 6 && is_shft(accelerator)) {
+        accelerator += 6;
+        len -= 6;
+        mods |= EGG_VIRTUAL_SHIFT_MASK;
+      } else if (len >= 6 && is_ctrl(accelerator)) {
+        accelerator += 6;
+        len -= 6;
+        mods |= EGG_VIRTUAL_CONTROL_MASK;
+      } else if (len >= 6 && is_modx(accelerator)) {
+        static const guint mod_vals[] = {
+            EGG_VIRTUAL_ALT_MASK, EGG_VIRTUAL_MOD2_MASK, EGG_VIRTUAL_MOD3_MASK,
+            EGG_VIRTUAL_MOD4_MASK, EGG_VIRTUAL_MOD5_MASK};
+
+        len -= 6;
+        accelerator += 4;
+        mods |= mod_vals[*accelerator - '1'];
+        accelerator += 2;
+      } else if (len >= 5 && is_ctl(accelerator)) {
+        accelerator += 5;
+        len -= 5;
+        mods |= EGG_VIRTUAL_CONTROL_MASK;
+      } else if (len >= 5 && is_alt(accelerator)) {
+        accelerator += 5;
+        len -= 5;
+        mods |= EGG_VIRTUAL_ALT_MASK;
+      } else if (len >= 6 && is_meta(accelerator)) {
+        accelerator += 6;
+        len -= 6;
+        mods |= EGG_VIRTUAL_META_MASK;
+      } else if (len >= 7 && is_hyper(accelerator)) {
+        accelerator += 7;
+        len -= 7;
+        mods |= EGG_VIRTUAL_HYPER_MASK;
+      } else if (len >= 7 && is_super(accelerator)) {
+        accelerator += 7;
+        len -= 7;
+        mods |= EGG_VIRTUAL_SUPER_MASK;
+      } else {
+        gchar last_ch;
+
+        last_ch = *accelerator;
+        while (last_ch && last_ch != '>') {
+          last_ch = *accelerator;
+          accelerator += 1;
+          len -= 1;
+        }
+      }
+    } else {
+      keyval = gdk_keyval_from_name(accelerator);
+
+      if (keyval == 0) bad_keyval = TRUE;
+
+      accelerator += len;
+      len = 0;
+    }
+  }
+
+  if (accelerator_key) *accelerator_key = gdk_keyval_to_lower(keyval);
+  if (accelerator_mods) *accelerator_mods = mods;
+
+  return !bad_keyval;
+}
+
+
+static const gchar *modifier_names[] = {
+    "Release", "Control", "Shift", "Shft", "Ctrl", "Mod1",   "Mod2",
+    "Mod3",    "Mod4",    "Mod5",  "Ctl",  "Alt",  "Meta",   "Hyper",
+    "Super",   "Mod6",    "Mod0",  "Foo",  "",     "Contro", "Supers"};
+
+static const gchar *key_names[] = {
+    "a",        "Z",         "F1",         "F12",      "space",
+    "Return",   "BackSpace", "KP_Enter",   "Super_L",  "Num_Lock",
+    "Tab",      "1",         "plus",       "Escape",   "XF86AudioMute",
+    "NotAKey",  "f1",        "ISO_Level3_Shift", "",   ">"};
+
+/* Randomly flips the case of each letter */
+static gchar *random_case(GRand *rand, const gchar *name) {
+  gchar *result = g_strdup(name);
+  gchar *c;
+
+  for (c = result; *c != '\0'; c++) {
+    if (g_rand_boolean(rand)) *c = g_ascii_toupper(*c);
+    else *c = g_ascii_tolower(*c);
+  }
+
+  return result;
+}
+
+/* What panels and indicators bind, some spelled more than one way */
+static const gchar *hotkeys[] = {
+    "<Super>n", "<Super>m",
+    "<Super>s", "<Super>space",
+    "<Control><Alt>t", "<Control><Alt>Delete",
+    "<Control><Alt>l", "<Primary><Alt>m",
+    "<Ctrl><Alt>d", "<Alt>F1",
+    "<Alt>F2", "<Mod4>p",
+    "<Shift><Super>s", "Print",
+    "<Alt>Print", "XF86AudioMute",
+    "XF86AudioRaiseVolume", "XF86AudioLowerVolume",
+    "XF86AudioPlay", "XF86MonBrightnessUp",
+    "XF86MonBrightnessDown", "XF86PowerOff",
+    "<Control><Shift>Escape", "<Super>Tab"};
+
+/* Edge cases and random modifier case, for checking behaviour */
+static GPtrArray *build_corpus(void) {
+  GPtrArray *corpus = g_ptr_array_new_with_free_func(g_free);
+  GRand *rand = g_rand_new_with_seed(0x1d1ca7);
+  guint i;
+
+  for (i = 0; i < CORPUS_SIZE; i++) {
+    GString *accel = g_string_new(NULL);
+    gint n_mods = g_rand_int_range(rand, 0, 4);
+    gint m;
+
+    for (m = 0; m < n_mods; m++) {
+      gchar *name = random_case(
+          rand, modifier_names[g_rand_int_range(
+                    rand, 0, G_N_ELEMENTS(modifier_names))]);
+      g_string_append_printf(accel, "<%s>", name);
+      g_free(name);
+    }
+
+    /* Key names are case sensitive, keep most of them as they are */
+    if (g_rand_int_range(rand, 0, 8) == 0) {
+      gchar *name = random_case(
+          rand, key_names[g_rand_int_range(rand, 0, G_N_ELEMENTS(key_names))]);
+      g_string_append(accel, name);
+      g_free(name);
+    } else {
+      g_string_append(
+          accel, key_names[g_rand_int_range(rand, 0, G_N_ELEMENTS(key_names))]);
+    }
+
+    g_ptr_array_add(corpus, g_string_free(accel, FALSE));
+  }
+
+  g_rand_free(rand);
+  return corpus;
+}
+
+/* Recurring hotkeys, for timing */
+static GPtrArray *build_hotkey_corpus(void) {
+  GPtrArray *corpus = g_ptr_array_new();
+  GRand *rand = g_rand_new_with_seed(0x40743e);
+  guint i;
+
+  for (i = 0; i < CORPUS_SIZE; i++) {
+    g_ptr_array_add(corpus, (gpointer)hotkeys[g_rand_int_range(
+                                rand, 0, G_N_ELEMENTS(hotkeys))]);
+  }
+
+  g_rand_free(rand);
+  return corpus;
+}
+
+static void keyval_cache_clear(void) {
+  G_LOCK(keyval_cache);
+  if (keyval_cache != NULL) {
+    g_hash_table_remove_all(keyval_cache);
+  }
+  G_UNLOCK(keyval_cache);
+}
+
+static guint check_corpus(GPtrArray *corpus) {
+  guint mismatches = 0;
+  guint i;
+
+  for (i = 0; i < corpus->len; i++) {
+    const gchar *accel = g_ptr_array_index(corpus, i);
+    guint old_key, new_key;
+    EggVirtualModifierType old_mods, new_mods;
+    gboolean old_ok, new_ok;
+
+    old_ok = legacy_parse_virtual(accel, &old_key, &old_mods);
+    new_ok = egg_accelerator_parse_virtual(accel, &new_key, &new_mods);
+
+    if (old_ok != new_ok || old_key != new_key || old_mods != new_mods) {
+      if (mismatches < 10) {
+        g_printerr("Mismatch for '%s': old (%d, %u, 0x%x) new (%d, %u, 0x%x)\n",
+                   accel, old_ok, old_key, old_mods, new_ok, new_key, new_mods);
+      }
+      mismatches++;
+    }
+  }
+
+  return mismatches;
+}
+
+static gdouble time_parser(GPtrArray *corpus,
+                           gboolean (*parse)(const gchar *, guint *,
+                                             EggVirtualModifierType *)) {
+  gint64 start = g_get_monotonic_time();
+  guint round, i;
+
+  for (round = 0; round < ROUNDS; round++) {
+    for (i = 0; i < corpus->len; i++) {
+      guint key;
+      EggVirtualModifierType mods;
+
+      parse(g_ptr_array_index(corpus, i), &key, &mods);
+    }
+  }
+
+  return (g_get_monotonic_time() - start) * 1000.0 / (ROUNDS * corpus->len);
+}
+
+/* Every hotkey parsed once, just after the keymap changed */
+static gdouble time_parser_cold(
+    gboolean (*parse)(const gchar *, guint *, EggVirtualModifierType *)) {
+  gint64 elapsed = 0;
+  guint round, i;
+
+  for (round = 0; round < COLD_ROUNDS; round++) {
+    keyval_cache_clear();
+
+    gint64 start = g_get_monotonic_time();
+    for (i = 0; i < G_N_ELEMENTS(hotkeys); i++) {
+      guint key;
+      EggVirtualModifierType mods;
+
+      parse(hotkeys[i], &key, &mods);
+    }
+    elapsed += g_get_monotonic_time() - start;
+  }
+
+  return elapsed * 1000.0 / (COLD_ROUNDS * G_N_ELEMENTS(hotkeys));
+}
+
+int main(int argc G_GNUC_UNUSED, char **argv G_GNUC_UNUSED) {
+  GPtrArray *corpus = build_corpus();
+  GPtrArray *hotkey_corpus = build_hotkey_corpus();
+  guint mismatches = check_corpus(corpus) + check_corpus(hotkey_corpus);
+
+  if (mismatches > 0) {
+    g_printerr("%u of %u accelerators parse differently\n", mismatches,
+               corpus->len + hotkey_corpus->len);
+    g_ptr_array_unref(hotkey_corpus);
+    g_ptr_array_unref(corpus);
+    return EXIT_FAILURE;
+  }
+
+  g_print("accelerator parse, legacy:      %.1f ns\n",
+          time_parser(hotkey_corpus, legacy_parse_virtual));
+  g_print("accelerator parse, table cold:  %.1f ns\n",
+          time_parser_cold(egg_accelerator_parse_virtual));
+
+  /* The last cold round left every hotkey in the cache */
+  g_print("accelerator parse, table warm:  %.1f ns\n",
+          time_parser(hotkey_corpus, egg_accelerator_parse_virtual));
+
+  g_ptr_array_unref(hotkey_corpus);
+  g_ptr_array_unref(corpus);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,221 @@
+/*
+Cost of running an indicator module out of process.
+
+Loads a synthetic indicator module once through mate-indicator-module-host
+and once in process, and compares how long its entries take to show up,
+how long label updates take to reach the applet side and the memory used.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <gtk/gtk.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "indicator-remote.h"
+#include "latency-histogram.h"
+
+/* How long the host gets to export the entries */
+#define LOAD_TIMEOUT_USEC (10 * G_USEC_PER_SEC)
+
+static gchar *module = NULL;
+static gint entries = 4;
+static gint interval_ms = 20;
+static gint duration_s = 10;
+
+static const GOptionEntry options[] = {
+    {"module", 'm', 0, G_OPTION_ARG_FILENAME, &module,
+     "Path of the synthetic indicator module", "PATH"},
+    {"entries", 'e', 0, G_OPTION_ARG_INT, &entries,
+     "Entries shown by the indicator", "N"},
+    {"interval", 'i', 0, G_OPTION_ARG_INT, &interval_ms,
+     "Time between label updates, in milliseconds", "MS"},
+    {"duration", 'd', 0, G_OPTION_ARG_INT, &duration_s,
+     "Time to measure label updates for, in seconds", "S"},
+    {NULL}};
+
+typedef struct {
+  LatencyHistogram *latency;
+  /* Label timestamps already seen, a label may be set to the same text */
+  GHashTable *seen;
+} run_t;
+
+static gsize rss_kb(const gchar *pid) {
+  gchar *path = g_strdup_printf("/proc/%s/statm", pid);
+  gchar *contents = NULL;
+  gsize rss = 0;
+
+  if (g_file_get_contents(path, &contents, NULL, NULL)) {
+    gchar **fields = g_strsplit(contents, " ", 3);
+    if (fields[0] != NULL && fields[1] != NULL) {
+      rss = g_ascii_strtoull(fields[1], NULL, 10) * sysconf(_SC_PAGESIZE) /
+            1024;
+    }
+    g_strfreev(fields);
+  }
+
+  g_free(contents);
+  g_free(path);
+  return rss;
+}
+
+static void label_changed_cb(GtkLabel *label, GParamSpec *pspec G_GNUC_UNUSED,
+                             gpointer user_data) {
+  run_t *run = (run_t *)user_data;
+  const gchar *text = gtk_label_get_text(label);
+  const gchar *stamp = strrchr(text, ' ');
+
+  if (stamp == NULL) {
+    return;
+  }
+
+  gint64 sent = g_ascii_strtoll(stamp + 1, NULL, 10);
+  if (sent <= 0 || g_hash_table_contains(run->seen, &sent)) {
+    return;
+  }
+
+  gint64 *key = g_new(gint64, 1);
+  *key = sent;
+  g_hash_table_add(run->seen, key);
+  latency_histogram_record(run->latency, g_get_monotonic_time() - sent);
+}
+
+static void entry_added_cb(IndicatorObject *io G_GNUC_UNUSED,
+                           IndicatorObjectEntry *entry, gpointer user_data) {
+  if (entry->label != NULL) {
+    g_signal_connect(entry->label, "notify::label",
+                     G_CALLBACK(label_changed_cb), user_data);
+  }
+}
+
+static guint count_entries(IndicatorObject *io) {
+  GList *list = indicator_object_get_entries(io);
+  guint count = g_list_length(list);
+
+  g_list_free(list);
+  return count;
+}
+
+static gboolean run_mode(const gchar *mode, gboolean isolated) {
+  run_t run = {latency_histogram_new(),
+               g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free,
+                                     NULL)};
+  IndicatorObject *io = NULL;
+  GError *error = NULL;
+
+  const gint64 start = g_get_monotonic_time();
+  if (isolated) {
+    io = indicator_remote_new(module, &error);
+  } else {
+    io = indicator_object_new_from_file(module);
+  }
+  if (io == NULL) {
+    g_printerr("%s: unable to load %s: %s\n", mode, module,
+               error != NULL ? error->message : "not an indicator module");
+    g_clear_error(&error);
+    return FALSE;
+  }
+
+  g_signal_connect(io, INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED,
+                   G_CALLBACK(entry_added_cb), &run);
+  GList *initial = indicator_object_get_entries(io);
+  GList *entry = NULL;
+  for (entry = initial; entry != NULL; entry = g_list_next(entry)) {
+    entry_added_cb(io, entry->data, &run);
+  }
+  g_list_free(initial);
+
+  while (count_entries(io) < (guint)entries &&
+         g_get_monotonic_time() - start < LOAD_TIMEOUT_USEC) {
+    g_main_context_iteration(NULL, TRUE);
+  }
+  const gint64 loaded = g_get_monotonic_time() - start;
+
+  if (count_entries(io) < (guint)entries) {
+    g_printerr("%s: only %u of %d entries showed up\n", mode,
+               count_entries(io), entries);
+    g_object_unref(io);
+    return FALSE;
+  }
+
+  const gint64 end = g_get_monotonic_time() + duration_s * G_USEC_PER_SEC;
+  while (g_get_monotonic_time() < end) {
+    g_main_context_iteration(NULL, TRUE);
+  }
+
+  gchar *pid = g_strdup_printf("%d", getpid());
+  gsize rss = rss_kb(pid);
+  gsize host_rss = 0;
+  if (isolated && indicator_remote_get_identifier(INDICATOR_REMOTE(io))) {
+    host_rss = rss_kb(indicator_remote_get_identifier(INDICATOR_REMOTE(io)));
+  }
+  g_free(pid);
+
+  g_print("%-10s: %d entries in %6.1f ms, label updates p50 %6" G_GINT64_FORMAT
+          " us, p95 %6" G_GINT64_FORMAT " us, p99 %6" G_GINT64_FORMAT
+          " us, max %6" G_GINT64_FORMAT " us (%" G_GUINT64_FORMAT
+          " updates), rss %" G_GSIZE_FORMAT " KiB + host %" G_GSIZE_FORMAT
+          " KiB\n",
+          mode, entries, loaded / 1000.0,
+          latency_histogram_get_percentile(run.latency, 50.0),
+          latency_histogram_get_percentile(run.latency, 95.0),
+          latency_histogram_get_percentile(run.latency, 99.0),
+          latency_histogram_get_max(run.latency),
+          latency_histogram_get_count(run.latency), rss, host_rss);
+
+  g_object_unref(io);
+  latency_histogram_free(run.latency);
+  g_hash_table_unref(run.seen);
+  return TRUE;
+}
+
+int main(int argc, char **argv) {
+  GOptionContext *context = g_option_context_new(NULL);
+  GError *error = NULL;
+
+  g_option_context_add_main_entries(context, options, NULL);
+  g_option_context_add_group(context, gtk_get_option_group(TRUE));
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+
+  if (module == NULL) {
+    g_printerr("No module given, see --help\n");
+    return EXIT_FAILURE;
+  }
+
+  /* Read by the synthetic module here and in the host */
+  gchar *value = g_strdup_printf("%d", entries);
+  g_setenv("SYNTHETIC_INDICATOR_ENTRIES", value, TRUE);
+  g_free(value);
+  value = g_strdup_printf("%d", interval_ms);
+  g_setenv("SYNTHETIC_INDICATOR_LABEL_CHURN_MS", value, TRUE);
+  g_free(value);
+  g_setenv("SYNTHETIC_INDICATOR_LABEL_CLOCK", "1", TRUE);
+
+  /* Out of process first, so the module is not yet mapped in here */
+  if (!run_mode("isolated", TRUE) || !run_mode("in-process", FALSE)) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
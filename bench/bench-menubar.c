@@ -0,0 +1,421 @@
+/*
+Micro-benchmarks for the menubar entry handling.
+
+Times the applet's own handlers on a mock indicator with a range of
+entry counts: inserting entries (which walks the menubar through
+place_in_menu), removing and moving them, resizing them with
+entry_resized, flipping the panel orientation with
+matepanelapplet_reorient_cb and passing on accessible description
+updates.  It also times the first open of large submenus with and
+without the applet pre-warming them.  The results are written as JSON so
+runs from different releases can be compared.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Pull in the applet itself so its static handlers can be driven */
+#include "applet-main.c"
+
+#include <time.h>
+
+#include "mock-indicator.h"
+
+/* Calls per round for the operations that touch every entry at once */
+#define BULK_CALLS 20
+
+typedef enum {
+  OP_INSERT,
+  OP_MOVE,
+  OP_RESIZE,
+  OP_REORIENT,
+  OP_ACCESSIBLE,
+  OP_REMOVE,
+  N_OPS
+} operation_t;
+
+static const gchar *operation_names[N_OPS] = {
+    "insert", "move", "resize", "reorient", "accessible-desc", "remove"};
+
+/* Per call times of one operation, in nanoseconds, one value per round */
+typedef struct {
+  gint64 *per_call;
+  guint calls;
+} timing_t;
+
+static gint64 now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Runs queued idles and timeouts outside of the timed sections */
+static void drain(void) {
+  while (g_main_context_iteration(NULL, FALSE)) {
+  }
+}
+
+static gint compare_gint64(gconstpointer a, gconstpointer b) {
+  const gint64 x = *(const gint64 *)a;
+  const gint64 y = *(const gint64 *)b;
+
+  return (x > y) - (x < y);
+}
+
+static guint count_menuitems(GtkWidget *menubar) {
+  GList *children = gtk_container_get_children(GTK_CONTAINER(menubar));
+  guint count = g_list_length(children);
+
+  g_list_free(children);
+  return count;
+}
+
+/* A shown menubar in its own window, with the mock indicator added */
+static GtkWidget *menubar_setup(GtkWidget **window, MockIndicator **mock) {
+  *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  GtkWidget *menubar = gtk_menu_bar_new();
+  menubar_attach_state(menubar, MATE_PANEL_APPLET_ORIENT_DOWN, 24);
+  gtk_container_add(GTK_CONTAINER(*window), menubar);
+  gtk_widget_show_all(*window);
+
+  *mock = g_object_new(mock_indicator_get_type(), NULL);
+  add_indicator(menubar, INDICATOR_OBJECT(*mock), "libbench.so");
+  drain();
+
+  return menubar;
+}
+
+/* One round on a fresh menubar with entries entries */
+static gboolean run_round(guint entries, GRand *rand, timing_t *timings,
+                          guint round) {
+  GtkWidget *window = NULL;
+  MockIndicator *mock = NULL;
+  GtkWidget *menubar = menubar_setup(&window, &mock);
+
+  guint i;
+  gint64 begin = now_ns();
+  for (i = 0; i < entries; i++) {
+    mock_add(mock, i);
+  }
+  timings[OP_INSERT].per_call[round] = (now_ns() - begin) / entries;
+  timings[OP_INSERT].calls = entries;
+  drain();
+
+  if (count_menuitems(menubar) != entries) {
+    g_printerr("Expected %u menuitems after inserting, got %u\n", entries,
+               count_menuitems(menubar));
+    return FALSE;
+  }
+
+  /* Pick the positions first so the generator is not timed */
+  guint *moves = g_new(guint, entries * 2);
+  for (i = 0; i < entries * 2; i++) {
+    moves[i] = g_rand_int_range(rand, 0, entries);
+  }
+  begin = now_ns();
+  for (i = 0; i < entries; i++) {
+    mock_move(mock, moves[i * 2], moves[i * 2 + 1]);
+  }
+  timings[OP_MOVE].per_call[round] = (now_ns() - begin) / entries;
+  timings[OP_MOVE].calls = entries;
+  g_free(moves);
+  drain();
+
+  begin = now_ns();
+  for (i = 0; i < BULK_CALLS; i++) {
+    entry_resized(NULL, (i & 1) ? 24 : 32, menubar);
+  }
+  timings[OP_RESIZE].per_call[round] = (now_ns() - begin) / BULK_CALLS;
+  timings[OP_RESIZE].calls = BULK_CALLS;
+  drain();
+
+  begin = now_ns();
+  for (i = 0; i < BULK_CALLS; i++) {
+    matepanelapplet_reorient_cb(NULL,
+                                (i & 1) ? MATE_PANEL_APPLET_ORIENT_DOWN
+                                        : MATE_PANEL_APPLET_ORIENT_LEFT,
+                                menubar);
+  }
+  timings[OP_REORIENT].per_call[round] = (now_ns() - begin) / BULK_CALLS;
+  timings[OP_REORIENT].calls = BULK_CALLS;
+  drain();
+
+  /* Each entry gets a new description, then the queue is flushed as the
+     next frame would */
+  gchar **descs = g_new(gchar *, entries);
+  for (i = 0; i < entries; i++) {
+    descs[i] = g_strdup_printf("Entry %u, round %u", i, round);
+  }
+  accessible_queue_t *queue =
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_ACCESSIBLE_QUEUE);
+  GList *link = NULL;
+  begin = now_ns();
+  for (link = mock->entries, i = 0; link != NULL; link = link->next, i++) {
+    IndicatorObjectEntry *entry = link->data;
+    gchar *old = (gchar *)entry->accessible_desc;
+
+    entry->accessible_desc = descs[i];
+    descs[i] = old;
+    g_signal_emit_by_name(mock, INDICATOR_OBJECT_SIGNAL_ACCESSIBLE_DESC_UPDATE,
+                          entry);
+  }
+  accessible_queue_flush(queue);
+  timings[OP_ACCESSIBLE].per_call[round] = (now_ns() - begin) / entries;
+  timings[OP_ACCESSIBLE].calls = entries;
+  for (i = 0; i < entries; i++) {
+    g_free(descs[i]);
+  }
+  g_free(descs);
+  drain();
+
+  guint *positions = g_new(guint, entries);
+  for (i = 0; i < entries; i++) {
+    positions[i] = g_rand_int_range(rand, 0, entries - i);
+  }
+  begin = now_ns();
+  for (i = 0; i < entries; i++) {
+    mock_remove(mock, positions[i]);
+  }
+  timings[OP_REMOVE].per_call[round] = (now_ns() - begin) / entries;
+  timings[OP_REMOVE].calls = entries;
+  g_free(positions);
+  drain();
+
+  const guint left = count_menuitems(menubar);
+
+  g_object_unref(mock);
+  gtk_widget_destroy(window);
+  drain();
+
+  if (left != 0) {
+    g_printerr("%u menuitems left after removing every entry\n", left);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/*************
+ * First open
+ * ***********/
+
+#define FIRST_OPEN_ENTRIES 4
+#define OPEN_TIMEOUT_NS G_GINT64_CONSTANT(2000000000)
+
+static gint menu_items = 200;
+
+static void fill_menu(GtkMenu *menu, guint items) {
+  guint i;
+
+  for (i = 0; i < items; i++) {
+    gchar *text = g_strdup_printf("Item %u", i);
+    GtkWidget *item = (i % 5 == 4) ? gtk_check_menu_item_new_with_label(text)
+                                   : gtk_menu_item_new_with_label(text);
+
+    gtk_widget_show(item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+    g_free(text);
+  }
+}
+
+/* Time from selecting the entry's menubar item until its menu is mapped,
+   or -1 if it never was */
+static gint64 time_open(GtkWidget *menubar, IndicatorObjectEntry *entry) {
+  GtkWidget *menuitem = g_hash_table_lookup(
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_ENTRY_INDEX), entry);
+
+  const gint64 begin = now_ns();
+  gtk_menu_shell_select_item(GTK_MENU_SHELL(menubar), menuitem);
+  while (!gtk_widget_get_mapped(GTK_WIDGET(entry->menu))) {
+    if (now_ns() - begin > OPEN_TIMEOUT_NS) {
+      return -1;
+    }
+    g_main_context_iteration(NULL, FALSE);
+  }
+  const gint64 elapsed = now_ns() - begin;
+
+  gtk_menu_shell_deactivate(GTK_MENU_SHELL(menubar));
+  drain();
+  return elapsed;
+}
+
+/* Opens freshly built menus once each, with or without letting the applet
+   pre-warm them first */
+static gboolean run_first_open(gboolean prewarm, timing_t *timing,
+                               guint round) {
+  GtkWidget *window = NULL;
+  MockIndicator *mock = NULL;
+  GtkWidget *menubar = menubar_setup(&window, &mock);
+  prewarm_queue_t *queue =
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_PREWARM_QUEUE);
+  guint i;
+
+  queue->enabled = prewarm;
+  for (i = 0; i < FIRST_OPEN_ENTRIES; i++) {
+    mock_add(mock, i);
+    fill_menu(((IndicatorObjectEntry *)g_list_last(mock->entries)->data)->menu,
+              menu_items);
+  }
+  /* As it would have long before anyone clicks */
+  drain();
+
+  gint64 total = 0;
+  GList *link = NULL;
+  for (link = mock->entries; link != NULL; link = link->next) {
+    const gint64 elapsed = time_open(menubar, link->data);
+
+    if (elapsed < 0) {
+      g_printerr("A menu did not open\n");
+      return FALSE;
+    }
+    total += elapsed;
+  }
+  timing->per_call[round] = total / FIRST_OPEN_ENTRIES;
+  timing->calls = FIRST_OPEN_ENTRIES;
+
+  while (mock->entries != NULL) {
+    mock_remove(mock, 0);
+  }
+  g_object_unref(mock);
+  gtk_widget_destroy(window);
+  drain();
+
+  return TRUE;
+}
+
+/*************
+ * main
+ * ***********/
+
+static gchar *entry_counts = NULL;
+static gint rounds = 5;
+static gchar *output = NULL;
+
+static const GOptionEntry options[] = {
+    {"entries", 'e', 0, G_OPTION_ARG_STRING, &entry_counts,
+     "Comma separated entry counts, 10,100,1000 by default", "LIST"},
+    {"rounds", 'r', 0, G_OPTION_ARG_INT, &rounds,
+     "Rounds per entry count, the median is reported", "N"},
+    {"menu-items", 'm', 0, G_OPTION_ARG_INT, &menu_items,
+     "Items per menu when timing the first open", "N"},
+    {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+     "Write the JSON results here rather than to standard output", "FILE"},
+    {NULL}};
+
+static void append_result(GString *json, const gchar *operation,
+                          guint entries, timing_t *timing) {
+  static gboolean first = TRUE;
+
+  qsort(timing->per_call, rounds, sizeof(gint64), compare_gint64);
+
+  g_string_append_printf(json,
+                         "%s    {\"operation\": \"%s\", \"entries\": %u, "
+                         "\"calls\": %u, \"median_ns\": %" G_GINT64_FORMAT
+                         ", \"min_ns\": %" G_GINT64_FORMAT
+                         ", \"max_ns\": %" G_GINT64_FORMAT "}",
+                         first ? "" : ",\n", operation, entries, timing->calls,
+                         timing->per_call[rounds / 2], timing->per_call[0],
+                         timing->per_call[rounds - 1]);
+  first = FALSE;
+}
+
+int main(int argc, char **argv) {
+  GOptionContext *context = g_option_context_new(NULL);
+  GError *error = NULL;
+
+  g_option_context_add_main_entries(context, options, NULL);
+  g_option_context_add_group(context, gtk_get_option_group(TRUE));
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+
+  if (rounds < 1) {
+    rounds = 1;
+  }
+
+  gchar **counts = g_strsplit(entry_counts != NULL ? entry_counts
+                                                   : "10,100,1000",
+                              ",", -1);
+  GRand *rand = g_rand_new_with_seed(0xbe7c);
+  GString *json = g_string_new(NULL);
+  timing_t timings[N_OPS];
+  guint i;
+  gint op;
+
+  for (op = 0; op < N_OPS; op++) {
+    timings[op].per_call = g_new0(gint64, rounds);
+  }
+
+  g_string_append_printf(json,
+                         "{\n  \"benchmark\": \"menubar\",\n"
+                         "  \"version\": \"%s\",\n  \"rounds\": %d,\n"
+                         "  \"menu_items\": %d,\n  \"results\": [\n",
+                         VERSION, rounds, menu_items);
+
+  for (i = 0; counts[i] != NULL; i++) {
+    const guint entries = g_ascii_strtoull(counts[i], NULL, 10);
+    gint round;
+
+    if (entries == 0) {
+      g_printerr("Invalid entry count '%s'\n", counts[i]);
+      return EXIT_FAILURE;
+    }
+
+    for (round = 0; round < rounds; round++) {
+      if (!run_round(entries, rand, timings, round)) {
+        return EXIT_FAILURE;
+      }
+    }
+
+    for (op = 0; op < N_OPS; op++) {
+      append_result(json, operation_names[op], entries, &timings[op]);
+    }
+  }
+
+  /* Reuses the insert and move slots, those are reported already */
+  gint round;
+  for (round = 0; round < rounds; round++) {
+    if (!run_first_open(FALSE, &timings[0], round) ||
+        !run_first_open(TRUE, &timings[1], round)) {
+      return EXIT_FAILURE;
+    }
+  }
+  append_result(json, "first-open-cold", menu_items, &timings[0]);
+  append_result(json, "first-open-warm", menu_items, &timings[1]);
+
+  g_string_append(json, "\n  ]\n}\n");
+
+  if (output != NULL) {
+    if (!g_file_set_contents(output, json->str, json->len, &error)) {
+      g_printerr("Unable to write %s: %s\n", output, error->message);
+      g_error_free(error);
+      return EXIT_FAILURE;
+    }
+  } else {
+    g_print("%s", json->str);
+  }
+
+  for (op = 0; op < N_OPS; op++) {
+    g_free(timings[op].per_call);
+  }
+  g_string_free(json, TRUE);
+  g_rand_free(rand);
+  g_strfreev(counts);
+  return EXIT_SUCCESS;
+}
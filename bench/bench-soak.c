@@ -0,0 +1,191 @@
+/*
+Soak test for the menubar entry handling.
+
+Drives add, remove, move and resize cycles from a synthetic indicator
+through the applet's own handlers and fails when the resident set or the
+malloc heap keeps growing past a bound once warmed up.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Pull in the applet itself so its static handlers can be driven */
+#include "applet-main.c"
+
+#ifdef HAVE_MALLINFO2
+#include <malloc.h>
+#endif
+#include <unistd.h>
+
+#include "mock-indicator.h"
+
+#define LIVE_ENTRIES 8
+#define SAMPLES 20
+
+/*************
+ * Sampling
+ * ***********/
+
+typedef struct {
+  guint64 cycle;
+  gsize rss_kb;
+  gsize heap_kb;
+  guint menuitems;
+} sample_t;
+
+static gsize read_rss_kb(void) {
+  gchar *contents = NULL;
+  gsize rss_kb = 0;
+
+  if (g_file_get_contents("/proc/self/statm", &contents, NULL, NULL)) {
+    gchar **fields = g_strsplit(contents, " ", 3);
+    if (fields[0] != NULL && fields[1] != NULL) {
+      rss_kb = g_ascii_strtoull(fields[1], NULL, 10) * sysconf(_SC_PAGESIZE) /
+               1024;
+    }
+    g_strfreev(fields);
+  }
+
+  g_free(contents);
+  return rss_kb;
+}
+
+static gsize read_heap_kb(void) {
+#ifdef HAVE_MALLINFO2
+  struct mallinfo2 info = mallinfo2();
+  return (info.uordblks + info.hblkhd) / 1024;
+#else
+  return 0;
+#endif
+}
+
+static void take_sample(sample_t *sample, GtkWidget *menubar, guint64 cycle) {
+  /* Let queued idles and timeouts run so they are part of the picture */
+  while (g_main_context_iteration(NULL, FALSE)) {
+  }
+
+  sample->cycle = cycle;
+  sample->rss_kb = read_rss_kb();
+  sample->heap_kb = read_heap_kb();
+
+  GList *children = gtk_container_get_children(GTK_CONTAINER(menubar));
+  sample->menuitems = g_list_length(children);
+  g_list_free(children);
+}
+
+/*************
+ * main
+ * ***********/
+
+static gint64 cycles = 1000000;
+static gint max_growth_kb = 2048;
+
+static const GOptionEntry options[] = {
+    {"cycles", 'c', 0, G_OPTION_ARG_INT64, &cycles,
+     "Number of add/move/resize/remove cycles", "N"},
+    {"max-growth", 'g', 0, G_OPTION_ARG_INT, &max_growth_kb,
+     "Allowed growth after warm up, in KiB", "KIB"},
+    {NULL}};
+
+int main(int argc, char **argv) {
+  GOptionContext *context = g_option_context_new(NULL);
+  GError *error = NULL;
+
+  g_option_context_add_main_entries(context, options, NULL);
+  g_option_context_add_group(context, gtk_get_option_group(TRUE));
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+
+  if (cycles < SAMPLES) {
+    cycles = SAMPLES;
+  }
+
+  GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  GtkWidget *menubar = gtk_menu_bar_new();
+  menubar_attach_state(menubar, MATE_PANEL_APPLET_ORIENT_DOWN, 24);
+  gtk_container_add(GTK_CONTAINER(window), menubar);
+  gtk_widget_show_all(window);
+
+  MockIndicator *mock = g_object_new(mock_indicator_get_type(), NULL);
+  add_indicator(menubar, INDICATOR_OBJECT(mock), "libsoak.so");
+
+  GRand *rand = g_rand_new_with_seed(0x50a4);
+  guint serial = 0;
+  while (serial < LIVE_ENTRIES) {
+    mock_add(mock, serial++);
+  }
+
+  /* The first sample is taken after a warm up so caches are populated */
+  sample_t samples[SAMPLES + 1];
+  guint64 interval = cycles / SAMPLES;
+  guint n_samples = 0;
+  gint64 start = g_get_monotonic_time();
+  guint64 cycle;
+
+  for (cycle = 0; cycle < (guint64)cycles; cycle++) {
+    mock_remove(mock, g_rand_int_range(rand, 0, LIVE_ENTRIES));
+    mock_add(mock, serial++);
+    mock_move(mock, g_rand_int_range(rand, 0, LIVE_ENTRIES),
+              g_rand_int_range(rand, 0, LIVE_ENTRIES));
+    entry_resized(NULL, (cycle & 1) ? 24 : 32, menubar);
+
+    if ((cycle + 1) % interval == 0 && n_samples <= SAMPLES) {
+      sample_t *sample = &samples[n_samples++];
+
+      take_sample(sample, menubar, cycle + 1);
+      g_print("cycle %10" G_GUINT64_FORMAT ": rss %8" G_GSIZE_FORMAT
+              " KiB, heap %8" G_GSIZE_FORMAT " KiB, %u menuitems\n",
+              sample->cycle, sample->rss_kb, sample->heap_kb,
+              sample->menuitems);
+
+      if (sample->menuitems != LIVE_ENTRIES) {
+        g_printerr("Expected %u menuitems, removed entries are leaking\n",
+                   LIVE_ENTRIES);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  gdouble elapsed = (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC;
+  g_print("%" G_GINT64_FORMAT " cycles in %.1f s (%.1f us per cycle)\n", cycles,
+          elapsed, elapsed * G_USEC_PER_SEC / cycles);
+
+  while (mock->entries != NULL) {
+    mock_remove(mock, 0);
+  }
+  g_object_unref(mock);
+  gtk_widget_destroy(window);
+  g_rand_free(rand);
+
+  sample_t *first = &samples[0];
+  sample_t *last = &samples[n_samples - 1];
+  gssize rss_growth = (gssize)last->rss_kb - (gssize)first->rss_kb;
+  gssize heap_growth = (gssize)last->heap_kb - (gssize)first->heap_kb;
+
+  g_print("growth after warm up: rss %" G_GSSIZE_FORMAT
+          " KiB, heap %" G_GSSIZE_FORMAT " KiB (bound %d KiB)\n",
+          rss_growth, heap_growth, max_growth_kb);
+
+  if (rss_growth > max_growth_kb || heap_growth > max_growth_kb) {
+    g_printerr("Memory grew past the bound, something is leaking\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+/*
+An in-memory indicator object for driving the menubar code from the
+benchmarks.  Entries are added, removed and moved by hand and the
+matching indicator signals are emitted, as a loaded module would.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __MOCK_INDICATOR_H__
+#define __MOCK_INDICATOR_H__
+
+#include <gtk/gtk.h>
+
+#if HAVE_UBUNTU_INDICATOR
+#include <libindicator/indicator-object.h>
+#endif
+
+#if HAVE_AYATANA_INDICATOR
+#include <libayatana-indicator/indicator-object.h>
+#endif
+
+typedef struct {
+  IndicatorObject parent;
+  GList *entries;
+} MockIndicator;
+
+typedef struct {
+  IndicatorObjectClass parent_class;
+} MockIndicatorClass;
+
+G_DEFINE_TYPE(MockIndicator, mock_indicator, INDICATOR_OBJECT_TYPE)
+
+#define MOCK_INDICATOR(o) \
+  (G_TYPE_CHECK_INSTANCE_CAST((o), mock_indicator_get_type(), MockIndicator))
+
+static GList *mock_indicator_get_entries(IndicatorObject *io) {
+  return g_list_copy(MOCK_INDICATOR(io)->entries);
+}
+
+static guint mock_indicator_get_location(IndicatorObject *io,
+                                         IndicatorObjectEntry *entry) {
+  return g_list_index(MOCK_INDICATOR(io)->entries, entry);
+}
+
+static void mock_indicator_class_init(MockIndicatorClass *klass) {
+  IndicatorObjectClass *io_class = INDICATOR_OBJECT_CLASS(klass);
+
+  io_class->get_entries = mock_indicator_get_entries;
+  io_class->get_location = mock_indicator_get_location;
+}
+
+static void mock_indicator_init(MockIndicator *self G_GNUC_UNUSED) {}
+
+static IndicatorObjectEntry *mock_entry_new(guint serial) {
+  IndicatorObjectEntry *entry = g_new0(IndicatorObjectEntry, 1);
+  gchar *text = g_strdup_printf("Entry %u", serial);
+
+  entry->label = GTK_LABEL(g_object_ref_sink(gtk_label_new(text)));
+  entry->image = GTK_IMAGE(g_object_ref_sink(
+      gtk_image_new_from_icon_name("image-missing", GTK_ICON_SIZE_MENU)));
+  entry->menu = GTK_MENU(g_object_ref_sink(gtk_menu_new()));
+  entry->accessible_desc = text;
+
+  gtk_widget_show(GTK_WIDGET(entry->label));
+  gtk_widget_show(GTK_WIDGET(entry->image));
+
+  return entry;
+}
+
+static void mock_entry_free(IndicatorObjectEntry *entry) {
+  gtk_widget_destroy(GTK_WIDGET(entry->label));
+  gtk_widget_destroy(GTK_WIDGET(entry->image));
+  gtk_widget_destroy(GTK_WIDGET(entry->menu));
+  g_object_unref(entry->label);
+  g_object_unref(entry->image);
+  g_object_unref(entry->menu);
+  g_free((gchar *)entry->accessible_desc);
+  g_free(entry);
+}
+
+static void mock_add(MockIndicator *mock, guint serial) {
+  IndicatorObjectEntry *entry = mock_entry_new(serial);
+
+  mock->entries = g_list_append(mock->entries, entry);
+  g_signal_emit_by_name(mock, INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED, entry);
+}
+
+static void mock_remove(MockIndicator *mock, guint position) {
+  GList *link = g_list_nth(mock->entries, position);
+  IndicatorObjectEntry *entry = link->data;
+
+  mock->entries = g_list_delete_link(mock->entries, link);
+  g_signal_emit_by_name(mock, INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED, entry);
+  mock_entry_free(entry);
+}
+
+static void mock_move(MockIndicator *mock, guint from, guint to) {
+  GList *link = g_list_nth(mock->entries, from);
+  IndicatorObjectEntry *entry = link->data;
+
+  mock->entries = g_list_delete_link(mock->entries, link);
+  mock->entries = g_list_insert(mock->entries, entry, to);
+  g_signal_emit_by_name(mock, INDICATOR_OBJECT_SIGNAL_ENTRY_MOVED, entry, from,
+                        to);
+}
+
+#endif /* __MOCK_INDICATOR_H__ */
@@ -0,0 +1,33 @@
+#!/bin/sh
+#   Copyright (C) 2022  Libre MATE
+#
+# This file is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING3.  If not see
+# <http://www.gnu.org/licenses/>.
+
+# Runs a benchmark under Xvfb and a private session bus unless the
+# caller already provides them.
+
+if test -z "$DBUS_SESSION_BUS_ADDRESS" && command -v dbus-run-session >/dev/null; then
+	exec dbus-run-session -- "$0" "$@"
+fi
+
+if test -z "$DISPLAY" && test -z "$WAYLAND_DISPLAY"; then
+	if ! command -v xvfb-run >/dev/null; then
+		echo "No display and xvfb-run is not installed" >&2
+		exit 77
+	fi
+	exec xvfb-run -a "$@"
+fi
+
+exec "$@"
@@ -0,0 +1,390 @@
+/*
+A fake indicator module producing a configurable load for benchmarks.
+
+The number of entries, menu size and how often labels, icons and whole
+entries churn are read from the environment or from a key file, so the
+applet can be measured against realistic indicator loads without any
+real indicator services installed.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* dladdr() */
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <dlfcn.h>
+#include <gtk/gtk.h>
+#include <string.h>
+
+#if HAVE_UBUNTU_INDICATOR
+#include <libindicator/indicator-object.h>
+#include <libindicator/indicator.h>
+#endif
+
+#if HAVE_AYATANA_INDICATOR
+#include <libayatana-indicator/indicator-object.h>
+#include <libayatana-indicator/indicator.h>
+#endif
+
+/*************
+ * Configuration
+ * ***********/
+
+/* Each setting is looked up, in order, in SYNTHETIC_INDICATOR_<KEY> (with
+   dashes as underscores), in the group named after the module's file
+   (e.g. [libsynthetic-3]) of the key file in SYNTHETIC_INDICATOR_CONFIG,
+   and in that file's [default] group */
+#define CONFIG_ENV "SYNTHETIC_INDICATOR_CONFIG"
+#define CONFIG_DEFAULT_GROUP "default"
+
+typedef struct {
+  gint entries;         /* entries shown by the indicator */
+  gint menu_items;      /* items in each entry's menu */
+  gint label_churn_ms;  /* label and accessible name updates, 0 is off */
+  gint icon_churn_ms;   /* icon updates, 0 is off */
+  gint entry_churn_ms;  /* entry removed and added again, 0 is off */
+  gint burst;           /* updates fired back to back on each tick */
+  gint label_clock;     /* labels carry g_get_monotonic_time() when set */
+} synthetic_config_t;
+
+static const gchar *icon_names[] = {
+    "audio-volume-high", "audio-volume-muted", "battery-good",
+    "battery-low",       "network-wireless",   "network-offline",
+    "mail-unread",       "mail-read",          "user-available",
+    "user-away"};
+
+static gchar *module_name(void) {
+  Dl_info info;
+
+  if (dladdr((gpointer)module_name, &info) && info.dli_fname != NULL) {
+    gchar *basename = g_path_get_basename(info.dli_fname);
+    if (g_str_has_suffix(basename, "." G_MODULE_SUFFIX)) {
+      basename[strlen(basename) - strlen("." G_MODULE_SUFFIX)] = '\0';
+    }
+    return basename;
+  }
+
+  return g_strdup("synthetic-indicator");
+}
+
+static gint config_get(GKeyFile *keyfile, const gchar *group,
+                       const gchar *key, gint fallback) {
+  gchar *env = g_strdup_printf("SYNTHETIC_INDICATOR_%s", key);
+  gchar *c;
+  for (c = env; *c != '\0'; c++) {
+    *c = (*c == '-') ? '_' : g_ascii_toupper(*c);
+  }
+
+  const gchar *value = g_getenv(env);
+  g_free(env);
+  if (value != NULL) {
+    return (gint)g_ascii_strtoll(value, NULL, 10);
+  }
+
+  if (keyfile != NULL) {
+    const gchar *groups[] = {group, CONFIG_DEFAULT_GROUP};
+    guint i;
+    for (i = 0; i < G_N_ELEMENTS(groups); i++) {
+      if (g_key_file_has_key(keyfile, groups[i], key, NULL)) {
+        return g_key_file_get_integer(keyfile, groups[i], key, NULL);
+      }
+    }
+  }
+
+  return fallback;
+}
+
+static void config_load(synthetic_config_t *config, const gchar *name) {
+  GKeyFile *keyfile = NULL;
+  const gchar *path = g_getenv(CONFIG_ENV);
+
+  if (path != NULL) {
+    GError *error = NULL;
+    keyfile = g_key_file_new();
+    if (!g_key_file_load_from_file(keyfile, path, G_KEY_FILE_NONE, &error)) {
+      g_warning("Unable to read '%s': %s", path, error->message);
+      g_error_free(error);
+      g_key_file_free(keyfile);
+      keyfile = NULL;
+    }
+  }
+
+  config->entries = MAX(config_get(keyfile, name, "entries", 1), 0);
+  config->menu_items = MAX(config_get(keyfile, name, "menu-items", 5), 0);
+  config->label_churn_ms =
+      MAX(config_get(keyfile, name, "label-churn-ms", 0), 0);
+  config->icon_churn_ms = MAX(config_get(keyfile, name, "icon-churn-ms", 0), 0);
+  config->entry_churn_ms =
+      MAX(config_get(keyfile, name, "entry-churn-ms", 0), 0);
+  config->burst = MAX(config_get(keyfile, name, "burst", 1), 1);
+  config->label_clock = config_get(keyfile, name, "label-clock", 0);
+
+  if (keyfile != NULL) {
+    g_key_file_free(keyfile);
+  }
+}
+
+/*************
+ * Indicator
+ * ***********/
+
+typedef struct {
+  IndicatorObject parent;
+  gchar *name;
+  synthetic_config_t config;
+  GList *entries;
+  guint serial;
+  guint next_label;
+  guint next_icon;
+  guint label_timeout;
+  guint icon_timeout;
+  guint entry_timeout;
+} SyntheticIndicator;
+
+typedef struct {
+  IndicatorObjectClass parent_class;
+} SyntheticIndicatorClass;
+
+static GType synthetic_indicator_get_type(void);
+
+#define SYNTHETIC_INDICATOR_TYPE (synthetic_indicator_get_type())
+#define SYNTHETIC_INDICATOR(o)                               \
+  (G_TYPE_CHECK_INSTANCE_CAST((o), SYNTHETIC_INDICATOR_TYPE, \
+                              SyntheticIndicator))
+
+INDICATOR_SET_VERSION
+INDICATOR_SET_TYPE(SYNTHETIC_INDICATOR_TYPE)
+
+static gpointer synthetic_indicator_parent_class = NULL;
+
+static IndicatorObjectEntry *entry_new(SyntheticIndicator *self) {
+  IndicatorObjectEntry *entry = g_new0(IndicatorObjectEntry, 1);
+  guint serial = self->serial++;
+  gchar *text = g_strdup_printf("%s %u", self->name, serial);
+  gint i;
+
+  entry->label = GTK_LABEL(g_object_ref_sink(gtk_label_new(text)));
+  entry->image = GTK_IMAGE(g_object_ref_sink(gtk_image_new_from_icon_name(
+      icon_names[serial % G_N_ELEMENTS(icon_names)], GTK_ICON_SIZE_MENU)));
+  entry->menu = GTK_MENU(g_object_ref_sink(gtk_menu_new()));
+  entry->accessible_desc = text;
+  entry->name_hint = self->name;
+
+  for (i = 0; i < self->config.menu_items; i++) {
+    gchar *item_label = g_strdup_printf("Item %d", i + 1);
+    GtkWidget *item = gtk_menu_item_new_with_label(item_label);
+    gtk_menu_shell_append(GTK_MENU_SHELL(entry->menu), item);
+    gtk_widget_show(item);
+    g_free(item_label);
+  }
+
+  gtk_widget_show(GTK_WIDGET(entry->label));
+  gtk_widget_show(GTK_WIDGET(entry->image));
+
+  return entry;
+}
+
+static void entry_free(IndicatorObjectEntry *entry) {
+  gtk_widget_destroy(GTK_WIDGET(entry->label));
+  gtk_widget_destroy(GTK_WIDGET(entry->image));
+  gtk_widget_destroy(GTK_WIDGET(entry->menu));
+  g_object_unref(entry->label);
+  g_object_unref(entry->image);
+  g_object_unref(entry->menu);
+  g_free((gchar *)entry->accessible_desc);
+  g_free(entry);
+}
+
+static IndicatorObjectEntry *next_entry(SyntheticIndicator *self,
+                                        guint *cursor) {
+  guint n_entries = g_list_length(self->entries);
+
+  if (n_entries == 0) {
+    return NULL;
+  }
+
+  return g_list_nth_data(self->entries, (*cursor)++ % n_entries);
+}
+
+static gboolean label_churn_cb(gpointer data) {
+  SyntheticIndicator *self = SYNTHETIC_INDICATOR(data);
+  gint i;
+
+  for (i = 0; i < self->config.burst; i++) {
+    IndicatorObjectEntry *entry = next_entry(self, &self->next_label);
+    if (entry == NULL) {
+      break;
+    }
+
+    /* The clock lets a benchmark time the update on its way to the
+       applet, the monotonic clock is the same in every process */
+    gchar *text =
+        self->config.label_clock
+            ? g_strdup_printf("%s %" G_GINT64_FORMAT, self->name,
+                              g_get_monotonic_time())
+            : g_strdup_printf("%s %u", self->name, self->serial++);
+    gtk_label_set_text(entry->label, text);
+    g_free((gchar *)entry->accessible_desc);
+    entry->accessible_desc = text;
+    g_signal_emit_by_name(self, INDICATOR_OBJECT_SIGNAL_ACCESSIBLE_DESC_UPDATE,
+                          entry);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean icon_churn_cb(gpointer data) {
+  SyntheticIndicator *self = SYNTHETIC_INDICATOR(data);
+  gint i;
+
+  for (i = 0; i < self->config.burst; i++) {
+    IndicatorObjectEntry *entry = next_entry(self, &self->next_icon);
+    if (entry == NULL) {
+      break;
+    }
+
+    gtk_image_set_from_icon_name(
+        entry->image, icon_names[self->serial++ % G_N_ELEMENTS(icon_names)],
+        GTK_ICON_SIZE_MENU);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean entry_churn_cb(gpointer data) {
+  SyntheticIndicator *self = SYNTHETIC_INDICATOR(data);
+  gint i;
+
+  for (i = 0; i < self->config.burst && self->entries != NULL; i++) {
+    GList *last = g_list_last(self->entries);
+    IndicatorObjectEntry *entry = last->data;
+
+    self->entries = g_list_delete_link(self->entries, last);
+    g_signal_emit_by_name(self, INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED, entry);
+    entry_free(entry);
+
+    entry = entry_new(self);
+    self->entries = g_list_append(self->entries, entry);
+    g_signal_emit_by_name(self, INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED, entry);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static GList *synthetic_indicator_get_entries(IndicatorObject *io) {
+  return g_list_copy(SYNTHETIC_INDICATOR(io)->entries);
+}
+
+static guint synthetic_indicator_get_location(IndicatorObject *io,
+                                              IndicatorObjectEntry *entry) {
+  return g_list_index(SYNTHETIC_INDICATOR(io)->entries, entry);
+}
+
+static void synthetic_indicator_dispose(GObject *object) {
+  SyntheticIndicator *self = SYNTHETIC_INDICATOR(object);
+
+  guint *timeouts[] = {&self->label_timeout, &self->icon_timeout,
+                       &self->entry_timeout};
+  guint i;
+  for (i = 0; i < G_N_ELEMENTS(timeouts); i++) {
+    if (*timeouts[i] != 0) {
+      g_source_remove(*timeouts[i]);
+      *timeouts[i] = 0;
+    }
+  }
+
+  g_list_free_full(self->entries, (GDestroyNotify)entry_free);
+  self->entries = NULL;
+
+  G_OBJECT_CLASS(synthetic_indicator_parent_class)->dispose(object);
+}
+
+static void synthetic_indicator_finalize(GObject *object) {
+  g_free(SYNTHETIC_INDICATOR(object)->name);
+
+  G_OBJECT_CLASS(synthetic_indicator_parent_class)->finalize(object);
+}
+
+static void synthetic_indicator_class_init(gpointer klass,
+                                           gpointer data G_GNUC_UNUSED) {
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  IndicatorObjectClass *io_class = INDICATOR_OBJECT_CLASS(klass);
+
+  synthetic_indicator_parent_class = g_type_class_peek_parent(klass);
+
+  object_class->dispose = synthetic_indicator_dispose;
+  object_class->finalize = synthetic_indicator_finalize;
+
+  io_class->get_entries = synthetic_indicator_get_entries;
+  io_class->get_location = synthetic_indicator_get_location;
+}
+
+static void synthetic_indicator_init(GTypeInstance *instance,
+                                     gpointer klass G_GNUC_UNUSED) {
+  SyntheticIndicator *self = (SyntheticIndicator *)instance;
+  gint i;
+
+  self->name = module_name();
+  config_load(&self->config, self->name);
+
+  for (i = 0; i < self->config.entries; i++) {
+    self->entries = g_list_append(self->entries, entry_new(self));
+  }
+
+  if (self->config.label_churn_ms > 0) {
+    self->label_timeout =
+        g_timeout_add(self->config.label_churn_ms, label_churn_cb, self);
+  }
+  if (self->config.icon_churn_ms > 0) {
+    self->icon_timeout =
+        g_timeout_add(self->config.icon_churn_ms, icon_churn_cb, self);
+  }
+  if (self->config.entry_churn_ms > 0) {
+    self->entry_timeout =
+        g_timeout_add(self->config.entry_churn_ms, entry_churn_cb, self);
+  }
+}
+
+/* Several copies of this module are loaded side by side, so the type name
+   carries the module name to keep them apart */
+static GType synthetic_indicator_get_type(void) {
+  static gsize type_id = 0;
+
+  if (g_once_init_enter(&type_id)) {
+    gchar *name = module_name();
+    GString *type_name = g_string_new("SyntheticIndicator_");
+    const gchar *c;
+
+    for (c = name; *c != '\0'; c++) {
+      g_string_append_c(type_name, g_ascii_isalnum(*c) ? *c : '_');
+    }
+
+    GType type = g_type_register_static_simple(
+        INDICATOR_OBJECT_TYPE, type_name->str, sizeof(SyntheticIndicatorClass),
+        synthetic_indicator_class_init, sizeof(SyntheticIndicator),
+        synthetic_indicator_init, 0);
+
+    g_string_free(type_name, TRUE);
+    g_free(name);
+    g_once_init_leave(&type_id, type);
+  }
+
+  return type_id;
+}
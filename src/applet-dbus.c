@@ -0,0 +1,309 @@
+/*
+Session bus interfaces exported by the applet process.
+
+The Metrics interface is read-only: it hands out the counters, gauges,
+latency percentiles and per-indicator handler times kept in
+applet-metrics.c so desktop health can be scraped like any service.
+The Control interface opens entries and activates menu items, so tests
+and benchmarks can drive the menus without synthesizing input.  Since
+that lets any client on the bus act for the user, it is only exported
+once the applet asks for it.  The
+screensaver is listened to as well, nothing needs drawing while it runs.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "applet-dbus.h"
+
+#include <gio/gio.h>
+
+#include "applet-metrics.h"
+
+/* GetLatencies maps each name to (count, p50, p95, p99, max) and
+   GetIndicators lists (name, entries, handler -> (calls, total, max)), all
+   times in microseconds.  The control methods are described in
+   applet-dbus.h. */
+static const gchar introspection_xml[] =
+    "<node>"
+    "  <interface name='" APPLET_DBUS_METRICS_INTERFACE "'>"
+    "    <method name='GetCounters'>"
+    "      <arg type='a{sx}' name='counters' direction='out'/>"
+    "    </method>"
+    "    <method name='GetLatencies'>"
+    "      <arg type='a{s(txxxx)}' name='latencies' direction='out'/>"
+    "    </method>"
+    "    <method name='GetIndicators'>"
+    "      <arg type='a(sia{s(txx)})' name='indicators' direction='out'/>"
+    "    </method>"
+    "  </interface>"
+    "  <interface name='" APPLET_DBUS_CONTROL_INTERFACE "'>"
+    "    <method name='OpenEntry'>"
+    "      <arg type='s' name='indicator' direction='in'/>"
+    "      <arg type='u' name='position' direction='in'/>"
+    "    </method>"
+    "    <method name='CloseAll'/>"
+    "    <method name='ActivateItem'>"
+    "      <arg type='s' name='indicator' direction='in'/>"
+    "      <arg type='u' name='position' direction='in'/>"
+    "      <arg type='as' name='path' direction='in'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>";
+
+static GDBusNodeInfo *introspection_data = NULL;
+static GDBusConnection *bus = NULL;
+static const AppletDBusControl *control = NULL;
+static guint control_id = 0;
+
+/* Whichever of them runs, both emit ActiveChanged(b) */
+static const gchar *screensaver_interfaces[] = {"org.mate.ScreenSaver",
+                                                "org.gnome.ScreenSaver"};
+
+static AppletDBusScreensaverFunc screensaver_func = NULL;
+static gpointer screensaver_data = NULL;
+
+static GVariant *get_counters(void) {
+  GVariantBuilder builder;
+  guint i;
+
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sx}"));
+
+  for (i = 0; i < APPLET_N_COUNTERS; i++) {
+    g_variant_builder_add(&builder, "{sx}", applet_metrics_counter_name(i),
+                          (gint64)applet_metrics_get_counter(i));
+  }
+  for (i = 0; i < APPLET_N_GAUGES; i++) {
+    g_variant_builder_add(&builder, "{sx}", applet_metrics_gauge_name(i),
+                          applet_metrics_get_gauge(i));
+  }
+
+  return g_variant_new("(a{sx})", &builder);
+}
+
+static GVariant *get_latencies(void) {
+  GVariantBuilder builder;
+  guint i;
+
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a{s(txxxx)}"));
+
+  for (i = 0; i < APPLET_N_LATENCIES; i++) {
+    LatencyHistogram *histogram = applet_metrics_get_latency(i);
+
+    g_variant_builder_add(
+        &builder, "{s(txxxx)}", applet_metrics_latency_name(i),
+        latency_histogram_get_count(histogram),
+        latency_histogram_get_percentile(histogram, 50.0),
+        latency_histogram_get_percentile(histogram, 95.0),
+        latency_histogram_get_percentile(histogram, 99.0),
+        latency_histogram_get_max(histogram));
+  }
+
+  return g_variant_new("(a{s(txxxx)})", &builder);
+}
+
+static void add_indicator(const AppletIndicatorMetrics *metrics,
+                          gpointer user_data) {
+  GVariantBuilder *builder = (GVariantBuilder *)user_data;
+  GVariantBuilder handlers;
+  guint i;
+
+  g_variant_builder_init(&handlers, G_VARIANT_TYPE("a{s(txx)}"));
+  for (i = 0; i < APPLET_N_HANDLERS; i++) {
+    g_variant_builder_add(&handlers, "{s(txx)}", applet_metrics_handler_name(i),
+                          metrics->calls[i], metrics->total_usec[i],
+                          metrics->max_usec[i]);
+  }
+
+  g_variant_builder_add(builder, "(sia{s(txx)})", metrics->name,
+                        metrics->entries, &handlers);
+}
+
+static GVariant *get_indicators(void) {
+  GVariantBuilder builder;
+
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a(sia{s(txx)})"));
+  applet_metrics_foreach_indicator(add_indicator, &builder);
+
+  return g_variant_new("(a(sia{s(txx)}))", &builder);
+}
+
+static void metrics_method_call(GDBusConnection *connection G_GNUC_UNUSED,
+                                const gchar *sender G_GNUC_UNUSED,
+                                const gchar *object_path G_GNUC_UNUSED,
+                                const gchar *interface_name G_GNUC_UNUSED,
+                                const gchar *method_name,
+                                GVariant *parameters G_GNUC_UNUSED,
+                                GDBusMethodInvocation *invocation,
+                                gpointer user_data G_GNUC_UNUSED) {
+  if (g_strcmp0(method_name, "GetCounters") == 0) {
+    g_dbus_method_invocation_return_value(invocation, get_counters());
+  } else if (g_strcmp0(method_name, "GetLatencies") == 0) {
+    g_dbus_method_invocation_return_value(invocation, get_latencies());
+  } else if (g_strcmp0(method_name, "GetIndicators") == 0) {
+    g_dbus_method_invocation_return_value(invocation, get_indicators());
+  } else {
+    g_dbus_method_invocation_return_error(
+        invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+        "Unknown method '%s'", method_name);
+  }
+}
+
+static const GDBusInterfaceVTable metrics_vtable = {metrics_method_call, NULL,
+                                                    NULL};
+
+static void control_method_call(GDBusConnection *connection G_GNUC_UNUSED,
+                                const gchar *sender G_GNUC_UNUSED,
+                                const gchar *object_path G_GNUC_UNUSED,
+                                const gchar *interface_name G_GNUC_UNUSED,
+                                const gchar *method_name, GVariant *parameters,
+                                GDBusMethodInvocation *invocation,
+                                gpointer user_data G_GNUC_UNUSED) {
+  const gchar *indicator = NULL;
+  const gchar **path = NULL;
+  GError *error = NULL;
+  guint position = 0;
+  gboolean done = FALSE;
+
+  if (control == NULL) {
+    g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                          G_DBUS_ERROR_FAILED,
+                                          "The menubar is not up yet");
+    return;
+  }
+
+  if (g_strcmp0(method_name, "OpenEntry") == 0) {
+    g_variant_get(parameters, "(&su)", &indicator, &position);
+    done = control->open_entry(indicator, position, &error);
+  } else if (g_strcmp0(method_name, "CloseAll") == 0) {
+    control->close_all();
+    done = TRUE;
+  } else if (g_strcmp0(method_name, "ActivateItem") == 0) {
+    g_variant_get(parameters, "(&su^a&s)", &indicator, &position, &path);
+    done = control->activate_item(indicator, position, path, &error);
+    g_free(path);
+  } else {
+    g_dbus_method_invocation_return_error(
+        invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+        "Unknown method '%s'", method_name);
+    return;
+  }
+
+  if (done) {
+    g_dbus_method_invocation_return_value(invocation, NULL);
+  } else {
+    g_dbus_method_invocation_return_error_literal(
+        invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, error->message);
+    g_error_free(error);
+  }
+}
+
+static const GDBusInterfaceVTable control_vtable = {control_method_call, NULL,
+                                                    NULL};
+
+static void control_register(void) {
+  GError *error = NULL;
+
+  if (bus == NULL || control == NULL || control_id != 0) {
+    return;
+  }
+
+  control_id = g_dbus_connection_register_object(
+      bus, APPLET_DBUS_OBJECT_PATH,
+      g_dbus_node_info_lookup_interface(introspection_data,
+                                        APPLET_DBUS_CONTROL_INTERFACE),
+      &control_vtable, NULL, NULL, &error);
+
+  if (error != NULL) {
+    g_warning("Unable to export the control interface: %s", error->message);
+    g_error_free(error);
+  }
+}
+
+static void screensaver_active_changed(
+    GDBusConnection *connection G_GNUC_UNUSED,
+    const gchar *sender G_GNUC_UNUSED, const gchar *object_path G_GNUC_UNUSED,
+    const gchar *interface_name G_GNUC_UNUSED,
+    const gchar *signal_name G_GNUC_UNUSED, GVariant *parameters,
+    gpointer user_data G_GNUC_UNUSED) {
+  gboolean active = FALSE;
+
+  if (screensaver_func == NULL ||
+      !g_variant_is_of_type(parameters, G_VARIANT_TYPE("(b)"))) {
+    return;
+  }
+
+  g_variant_get(parameters, "(b)", &active);
+  screensaver_func(active, screensaver_data);
+}
+
+static void bus_acquired_cb(GDBusConnection *connection,
+                            const gchar *name G_GNUC_UNUSED,
+                            gpointer user_data G_GNUC_UNUSED) {
+  GError *error = NULL;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(screensaver_interfaces); i++) {
+    g_dbus_connection_signal_subscribe(
+        connection, NULL, screensaver_interfaces[i], "ActiveChanged", NULL,
+        NULL, G_DBUS_SIGNAL_FLAGS_NONE, screensaver_active_changed, NULL,
+        NULL);
+  }
+
+  g_dbus_connection_register_object(
+      connection, APPLET_DBUS_OBJECT_PATH,
+      g_dbus_node_info_lookup_interface(introspection_data,
+                                        APPLET_DBUS_METRICS_INTERFACE),
+      &metrics_vtable, NULL, NULL, &error);
+
+  if (error != NULL) {
+    g_warning("Unable to export metrics: %s", error->message);
+    g_error_free(error);
+  }
+
+  bus = connection;
+  control_register();
+}
+
+static void name_lost_cb(GDBusConnection *connection G_GNUC_UNUSED,
+                         const gchar *name, gpointer user_data G_GNUC_UNUSED) {
+  g_debug("Not the owner of '%s', the applet is only on the unique name",
+          name);
+}
+
+void applet_dbus_init(const gchar *bus_name) {
+  g_return_if_fail(bus_name != NULL);
+
+  if (introspection_data != NULL) {
+    return;
+  }
+
+  introspection_data = g_dbus_node_info_new_for_xml(introspection_xml, NULL);
+  g_assert(introspection_data != NULL);
+
+  g_bus_own_name(G_BUS_TYPE_SESSION, bus_name,
+                 G_BUS_NAME_OWNER_FLAGS_DO_NOT_QUEUE, bus_acquired_cb, NULL,
+                 name_lost_cb, NULL, NULL);
+}
+
+void applet_dbus_set_control(const AppletDBusControl *new_control) {
+  control = new_control;
+  control_register();
+}
+
+void applet_dbus_watch_screensaver(AppletDBusScreensaverFunc func,
+                                   gpointer user_data) {
+  screensaver_func = func;
+  screensaver_data = user_data;
+}
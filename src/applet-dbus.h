@@ -0,0 +1,59 @@
+/*
+Session bus interfaces exported by the applet process.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __APPLET_DBUS_H__
+#define __APPLET_DBUS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define APPLET_DBUS_OBJECT_PATH "/org/mate/IndicatorApplet"
+#define APPLET_DBUS_METRICS_INTERFACE "org.mate.IndicatorApplet.Metrics"
+#define APPLET_DBUS_CONTROL_INTERFACE "org.mate.IndicatorApplet.Control"
+
+/* Backs the control interface.  Entries are named by the indicator they
+   belong to, as loaded, and their position among its entries; items by
+   the labels leading to them from the entry's menu. */
+typedef struct {
+  gboolean (*open_entry)(const gchar *indicator, guint position,
+                         GError **error);
+  void (*close_all)(void);
+  gboolean (*activate_item)(const gchar *indicator, guint position,
+                            const gchar *const *path, GError **error);
+} AppletDBusControl;
+
+/* Owns bus_name on the session bus and exports the interfaces at
+   APPLET_DBUS_OBJECT_PATH once it is acquired */
+void applet_dbus_init(const gchar *bus_name);
+
+/* Exports the control interface, which is not there until this is called.
+   Any client on the session bus can then open menus and activate items,
+   so this is for tests and benchmarks. */
+void applet_dbus_set_control(const AppletDBusControl *control);
+
+/* Called on the main loop when the MATE or GNOME screensaver is activated
+   or deactivated */
+typedef void (*AppletDBusScreensaverFunc)(gboolean active, gpointer user_data);
+
+void applet_dbus_watch_screensaver(AppletDBusScreensaverFunc func,
+                                   gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __APPLET_DBUS_H__ */
@@ -25,9 +25,12 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 #endif
 
 #include <gdk/gdkkeysyms.h>
+#include <glib-unix.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <gtk/gtk.h>
 #include <mate-panel-applet.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -77,6 +80,12 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #endif
 
+#include "applet-dbus.h"
+#include "applet-metrics.h"
+#include "applet-trace.h"
+#include "applet-watchdog.h"
+#include "indicator-remote.h"
+#include "latency-histogram.h"
 #include "tomboykeybinder.h"
 
 static gchar *indicator_order[] = {
@@ -96,14 +105,110 @@ static gchar *indicator_order[] = {
 #endif
     NULL};
 
-static GtkPackDirection packdirection;
-static MatePanelAppletOrient orient;
-static guint size;
+/* Per-menuitem state, attached once as qdata in entry_added().  The
+   handler IDs are the ones connected on the entry's image and label so
+   that teardown can disconnect them directly. */
+enum {
+  ITEM_HANDLER_SHOW,
+  ITEM_HANDLER_HIDE,
+  ITEM_HANDLER_SENSITIVE,
+  N_ITEM_HANDLERS
+};
+
+typedef struct {
+  IndicatorObject *io;
+  IndicatorObjectEntry *entry;
+  GtkWidget *box;
+  /* What the box shows, the entry's own image and label or mirrors of
+     them, see entry_view_image() */
+  GtkWidget *image;
+  GtkWidget *label;
+  gulong image_handlers[N_ITEM_HANDLERS];
+  gulong label_handlers[N_ITEM_HANDLERS];
+  /* The entry's menu while it is not attached as the submenu, referenced,
+     see submenu_attach() */
+  GtkWidget *detached_menu;
+  guint attached_widgets;
+  guint detach_id;
+  /* Scrolling not yet passed on, see entry_scrolled() */
+  gdouble scroll_dx;
+  gdouble scroll_dy;
+  gint scroll_steps_x;
+  gint scroll_steps_y;
+  guint scroll_tick_id;
+  guint scroll_timeout_id;
+} menuitem_data_t;
+
+static G_DEFINE_QUARK(indicator-applet-menuitem-data, menuitem_data)
+
+static inline menuitem_data_t *menuitem_data_get(GtkWidget *menuitem) {
+  return g_object_get_qdata(G_OBJECT(menuitem), menuitem_data_quark());
+}
+
+/* The entry's menu, whether it is attached yet or not */
+static GtkWidget *menuitem_get_menu(GtkWidget *menuitem) {
+  menuitem_data_t *item_data = menuitem_data_get(menuitem);
 
-#define MENU_DATA_INDICATOR_OBJECT "indicator-object"
-#define MENU_DATA_INDICATOR_ENTRY "indicator-entry"
+  if (item_data != NULL && item_data->detached_menu != NULL) {
+    return item_data->detached_menu;
+  }
+  return gtk_menu_item_get_submenu(GTK_MENU_ITEM(menuitem));
+}
 
 #define IO_DATA_ORDER_NUMBER "indicator-order-number"
+#define IO_DATA_MODULE_PATH "indicator-module-path"
+#define IO_DATA_QUARANTINED "indicator-quarantined"
+
+/* Indexes kept on the menubar: indicator name -> IndicatorObject, which
+   holds a reference, and IndicatorObjectEntry -> menuitem */
+#define MENUBAR_DATA_INDICATOR_INDEX "indicator-index"
+#define MENUBAR_DATA_ENTRY_INDEX "entry-index"
+
+/* Per instance view state.  Every applet instance in the process has a
+   menubar of its own, on a panel with its own size and orient, while the
+   indicators behind them are shared, see shared_indicator_lookup(). */
+#define MENUBAR_DATA_VIEW "view"
+
+typedef struct {
+  GtkPackDirection packdirection;
+  MatePanelAppletOrient orient;
+  guint size;
+  /* Whether anyone can see the menubar, see low_power_update() */
+  GtkWidget *toplevel;
+  gboolean unmapped;
+  gboolean obscured;
+  gboolean suspended;
+  gint saved_width;
+  gint saved_height;
+} menubar_view_t;
+
+static inline menubar_view_t *menubar_view_get(GtkWidget *menubar) {
+  return g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_VIEW);
+}
+
+static GtkPackDirection orient_packdirection(MatePanelAppletOrient orient) {
+  return ((orient == MATE_PANEL_APPLET_ORIENT_UP) ||
+          (orient == MATE_PANEL_APPLET_ORIENT_DOWN))
+             ? GTK_PACK_DIRECTION_LTR
+             : GTK_PACK_DIRECTION_TTB;
+}
+
+static gdouble view_label_angle(const menubar_view_t *view) {
+  if (view->packdirection == GTK_PACK_DIRECTION_TTB) {
+    return (view->orient == MATE_PANEL_APPLET_ORIENT_LEFT) ? 270.0 : 90.0;
+  }
+  return 0.0;
+}
+
+/* Every menubar in the process, oldest last */
+static GList *menubars = NULL;
+
+/* The menubar of the oldest applet instance still around, the one hotkeys
+   and indicators asking for their menu to be shown go to */
+static GtkWidget *primary_menubar(void) {
+  GList *last = g_list_last(menubars);
+  return last != NULL ? last->data : NULL;
+}
 
 static gboolean applet_fill_cb(MatePanelApplet *applet, const gchar *iid,
                                gpointer data);
@@ -115,6 +220,11 @@ static void update_accessible_desc(IndicatorObjectEntry *entry,
  * main
  * ***********/
 
+/* Benchmarks include this file and drive the menubar directly, the
+   standalone host has its own main() at the end of this file */
+#if !defined(INDICATOR_APPLET_NO_FACTORY) && \
+    !defined(INDICATOR_APPLET_STANDALONE)
+
 #ifdef INDICATOR_APPLET
 MATE_PANEL_APPLET_OUT_PROCESS_FACTORY("IndicatorAppletFactory",
                                       PANEL_TYPE_APPLET, "indicator-applet",
@@ -133,6 +243,8 @@ MATE_PANEL_APPLET_OUT_PROCESS_FACTORY("IndicatorAppletAppmenuFactory",
                                       applet_fill_cb, NULL);
 #endif
 
+#endif /* !INDICATOR_APPLET_NO_FACTORY && !INDICATOR_APPLET_STANDALONE */
+
 /*************
  * log files
  * ***********/
@@ -147,6 +259,20 @@ MATE_PANEL_APPLET_OUT_PROCESS_FACTORY("IndicatorAppletAppmenuFactory",
 #endif
 GOutputStream *log_file = NULL;
 
+/*************
+ * metrics
+ * ***********/
+/* Well known name the Metrics interface is exported on, see applet-dbus.h */
+#if defined(INDICATOR_APPLET_STANDALONE)
+#define METRICS_BUS_NAME "org.mate.IndicatorApplet.Standalone"
+#elif defined(INDICATOR_APPLET)
+#define METRICS_BUS_NAME "org.mate.IndicatorApplet"
+#elif defined(INDICATOR_APPLET_COMPLETE)
+#define METRICS_BUS_NAME "org.mate.IndicatorApplet.Complete"
+#elif defined(INDICATOR_APPLET_APPMENU)
+#define METRICS_BUS_NAME "org.mate.IndicatorApplet.Appmenu"
+#endif
+
 /*****************
  * Hotkey support
  * **************/
@@ -163,6 +289,50 @@ gchar *hotkey_keycode = "<Super>S";
 gchar *hotkey_keycode = "<Super>F1";
 #endif
 
+/* Hotkeys opening a given indicator, as "<Super>V=name;<Super>T=name" where
+   name is the module or service file the indicator was loaded from */
+#define INDICATOR_HOTKEYS_ENV "INDICATOR_APPLET_INDICATOR_HOTKEYS"
+
+/* Directory to load indicator modules from instead of INDICATOR_DIR, used
+   to run the applet against the synthetic modules in bench/ */
+#define INDICATOR_DIR_ENV "INDICATOR_APPLET_INDICATOR_DIR"
+
+/* Modules to run in mate-indicator-module-host rather than in the applet,
+   as a comma separated list of file names or "*" for all of them */
+#define ISOLATE_MODULES_ENV "INDICATOR_APPLET_ISOLATE_MODULES"
+
+/* New style services whose menus are built from their menu models by GTK
+   rather than by libindicator, as a comma separated list of service names
+   or "*" for all of them */
+#define MENU_MODEL_SERVICES_ENV "INDICATOR_APPLET_MENU_MODEL_SERVICES"
+
+/* Set to 1 to export the D-Bus Control interface, which lets any client on
+   the session bus open entries and activate their items, for tests and
+   benchmarks.  The read-only Metrics interface is always exported. */
+#define DBUS_CONTROL_ENV "INDICATOR_APPLET_DBUS_CONTROL"
+
+/* Main loop dispatches longer than this many milliseconds are reported as
+   stalls.  Unset or 0 leaves the watchdog off: it samples the main thread
+   from a signal handler and locks around every poll, which is for
+   diagnosing, not for every panel. */
+#define WATCHDOG_MS_ENV "INDICATOR_APPLET_WATCHDOG_MS"
+
+/* Number of stalls after which an indicator is disconnected and hidden,
+   unset or 0 to never do so */
+#define WATCHDOG_QUARANTINE_ENV "INDICATOR_APPLET_WATCHDOG_QUARANTINE"
+
+/* Set to 0 to leave submenus alone until they are first opened, for
+   comparing first open latencies */
+#define PREWARM_MENUS_ENV "INDICATOR_APPLET_PREWARM_MENUS"
+
+/* Set to 0 to keep laying out and drawing the menubar while nobody can see
+   it, for comparing wakeups */
+#define LOW_POWER_ENV "INDICATOR_APPLET_LOW_POWER"
+
+/* Set to 0 to have entry icons decoded on the main thread by their images,
+   for comparing frame times */
+#define ASYNC_ICONS_ENV "INDICATOR_APPLET_ASYNC_ICONS"
+
 /********************
  * Environment Names
  * *******************/
@@ -214,9 +384,9 @@ static void place_in_menu(GtkWidget *widget, gpointer user_data) {
     return;
   }
 
-  IndicatorObject *io = INDICATOR_OBJECT(
-      g_object_get_data(G_OBJECT(widget), MENU_DATA_INDICATOR_OBJECT));
-  g_assert(io != NULL);
+  menuitem_data_t *item_data = menuitem_data_get(widget);
+  g_assert(item_data != NULL);
+  IndicatorObject *io = item_data->io;
 
   gint objposition =
       GPOINTER_TO_INT(g_object_get_data(G_OBJECT(io), IO_DATA_ORDER_NUMBER));
@@ -234,9 +404,7 @@ static void place_in_menu(GtkWidget *widget, gpointer user_data) {
   }
 
   /* The objects are the same, let's start looking at entries. */
-  IndicatorObjectEntry *entry = (IndicatorObjectEntry *)g_object_get_data(
-      G_OBJECT(widget), MENU_DATA_INDICATOR_ENTRY);
-  gint entryposition = indicator_object_get_location(io, entry);
+  gint entryposition = indicator_object_get_location(io, item_data->entry);
 
   if (entryposition > position->entryposition) {
     position->found = TRUE;
@@ -275,27 +443,135 @@ static void sensitive_cb(GObject *obj, GParamSpec *pspec, gpointer user_data) {
 
 static void entry_activated(GtkWidget *widget, gpointer user_data) {
   g_return_if_fail(GTK_IS_WIDGET(widget));
-  gpointer pio = g_object_get_data(G_OBJECT(widget), "indicator");
-  g_return_if_fail(INDICATOR_IS_OBJECT(pio));
-  IndicatorObject *io = INDICATOR_OBJECT(pio);
+  menuitem_data_t *item_data = menuitem_data_get(widget);
+  g_return_if_fail(item_data != NULL);
+  IndicatorObject *io = item_data->io;
+  g_return_if_fail(INDICATOR_IS_OBJECT(io));
+
+  gpointer scope = applet_watchdog_enter(io);
+  indicator_object_entry_activate(io, (IndicatorObjectEntry *)user_data,
+                                  gtk_get_current_event_time());
+  applet_watchdog_leave(scope);
+}
 
-  return indicator_object_entry_activate(io, (IndicatorObjectEntry *)user_data,
-                                         gtk_get_current_event_time());
+/* Scrolling is passed on at most once a frame, or this often when the
+   menubar isn't drawn.  Touchpads send a smooth scroll event for every
+   few pixels and each one costs the indicator a round trip. */
+#define SCROLL_FLUSH_INTERVAL 16 /* ms */
+
+/* Looked up once, the deprecated "scroll" may not exist at all */
+static guint scroll_signal = 0;
+static guint entry_scrolled_signal = 0;
+
+static void scroll_emit(menuitem_data_t *item_data, gint steps,
+                        GdkScrollDirection up, GdkScrollDirection down) {
+  if (steps == 0) {
+    return;
+  }
+
+  const GdkScrollDirection direction = steps > 0 ? down : up;
+  const guint delta = ABS(steps);
+
+  if (scroll_signal != 0) {
+    g_signal_emit(item_data->io, scroll_signal, 0, delta, direction);
+  }
+  g_signal_emit(item_data->io, entry_scrolled_signal, 0, item_data->entry,
+                delta, direction);
+  applet_metrics_count(APPLET_COUNTER_SCROLL_EMISSIONS);
+}
+
+static void scroll_flush(GtkWidget *menuitem) {
+  menuitem_data_t *item_data = menuitem_data_get(menuitem);
+  const gint steps_x = item_data->scroll_steps_x;
+  const gint steps_y = item_data->scroll_steps_y;
+
+  item_data->scroll_steps_x = 0;
+  item_data->scroll_steps_y = 0;
+
+  if (entry_scrolled_signal == 0) {
+    scroll_signal = g_signal_lookup("scroll", INDICATOR_OBJECT_TYPE);
+    entry_scrolled_signal = g_signal_lookup(
+        INDICATOR_OBJECT_SIGNAL_ENTRY_SCROLLED, INDICATOR_OBJECT_TYPE);
+  }
+
+  gpointer scope = applet_watchdog_enter(item_data->io);
+  scroll_emit(item_data, steps_y, GDK_SCROLL_UP, GDK_SCROLL_DOWN);
+  scroll_emit(item_data, steps_x, GDK_SCROLL_LEFT, GDK_SCROLL_RIGHT);
+  applet_watchdog_leave(scope);
+}
+
+static gboolean scroll_tick_cb(GtkWidget *menuitem,
+                               GdkFrameClock *clock G_GNUC_UNUSED,
+                               gpointer data G_GNUC_UNUSED) {
+  menuitem_data_get(menuitem)->scroll_tick_id = 0;
+  scroll_flush(menuitem);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean scroll_timeout_cb(gpointer data) {
+  GtkWidget *menuitem = GTK_WIDGET(data);
+
+  menuitem_data_get(menuitem)->scroll_timeout_id = 0;
+  scroll_flush(menuitem);
+  return G_SOURCE_REMOVE;
+}
+
+/* Adds delta to the fractional steps on one axis and moves whole steps
+   over to the pending count.  Turning around drops what was left over. */
+static void scroll_accumulate(gdouble *fraction, gint *steps, gdouble delta) {
+  if ((*fraction > 0 && delta < 0) || (*fraction < 0 && delta > 0)) {
+    *fraction = 0;
+  }
+
+  *fraction += delta;
+  const gint whole = (gint)*fraction;
+  *steps += whole;
+  *fraction -= whole;
 }
 
 static gboolean entry_scrolled(GtkWidget *menuitem, GdkEventScroll *event,
                                gpointer data) {
-  IndicatorObject *io =
-      g_object_get_data(G_OBJECT(menuitem), MENU_DATA_INDICATOR_OBJECT);
-  IndicatorObjectEntry *entry =
-      g_object_get_data(G_OBJECT(menuitem), MENU_DATA_INDICATOR_ENTRY);
+  menuitem_data_t *item_data = menuitem_data_get(menuitem);
+  g_return_val_if_fail(item_data != NULL, FALSE);
+  g_return_val_if_fail(INDICATOR_IS_OBJECT(item_data->io), FALSE);
+
+  applet_metrics_count(APPLET_COUNTER_SCROLL_EVENTS);
+
+  switch (event->direction) {
+    case GDK_SCROLL_UP:
+      item_data->scroll_steps_y--;
+      break;
+    case GDK_SCROLL_DOWN:
+      item_data->scroll_steps_y++;
+      break;
+    case GDK_SCROLL_LEFT:
+      item_data->scroll_steps_x--;
+      break;
+    case GDK_SCROLL_RIGHT:
+      item_data->scroll_steps_x++;
+      break;
+    case GDK_SCROLL_SMOOTH:
+      scroll_accumulate(&item_data->scroll_dx, &item_data->scroll_steps_x,
+                        event->delta_x);
+      scroll_accumulate(&item_data->scroll_dy, &item_data->scroll_steps_y,
+                        event->delta_y);
+      break;
+    default:
+      break;
+  }
 
-  g_return_val_if_fail(INDICATOR_IS_OBJECT(io), FALSE);
+  if ((item_data->scroll_steps_x == 0 && item_data->scroll_steps_y == 0) ||
+      item_data->scroll_tick_id != 0 || item_data->scroll_timeout_id != 0) {
+    return FALSE;
+  }
 
-  g_signal_emit_by_name(io, "scroll", 1, event->direction);
-  g_signal_emit_by_name(io, "scroll-entry", entry, 1, event->direction);
-  g_signal_emit_by_name(io, INDICATOR_OBJECT_SIGNAL_ENTRY_SCROLLED, entry, 1,
-                        event->direction);
+  if (gtk_widget_get_mapped(menuitem)) {
+    item_data->scroll_tick_id =
+        gtk_widget_add_tick_callback(menuitem, scroll_tick_cb, NULL, NULL);
+  } else {
+    item_data->scroll_timeout_id =
+        g_timeout_add(SCROLL_FLUSH_INTERVAL, scroll_timeout_cb, menuitem);
+  }
 
   return FALSE;
 }
@@ -320,15 +596,17 @@ static gboolean entry_released(GtkWidget *menuitem, GdkEvent *event,
 
   if (((GdkEventButton *)event)->button == 2) /* middle button */
   {
-    IndicatorObject *io =
-        g_object_get_data(G_OBJECT(menuitem), MENU_DATA_INDICATOR_OBJECT);
-    IndicatorObjectEntry *entry =
-        g_object_get_data(G_OBJECT(menuitem), MENU_DATA_INDICATOR_ENTRY);
+    menuitem_data_t *item_data = menuitem_data_get(menuitem);
+    g_return_val_if_fail(item_data != NULL, FALSE);
+    IndicatorObject *io = item_data->io;
+    IndicatorObjectEntry *entry = item_data->entry;
 
     g_return_val_if_fail(INDICATOR_IS_OBJECT(io), FALSE);
 
+    gpointer scope = applet_watchdog_enter(io);
     g_signal_emit_by_name(io, INDICATOR_OBJECT_SIGNAL_SECONDARY_ACTIVATE, entry,
                           ((GdkEventButton *)event)->time);
+    applet_watchdog_leave(scope);
 
     return TRUE;
   }
@@ -336,324 +614,1714 @@ static gboolean entry_released(GtkWidget *menuitem, GdkEvent *event,
   return FALSE;
 }
 
-static void accessible_desc_update_cb(GtkWidget *widget, gpointer userdata) {
-  gpointer data =
-      g_object_get_data(G_OBJECT(widget), MENU_DATA_INDICATOR_ENTRY);
+/*****************
+ * Accessible names
+ * **************/
+/* Used when the menubar isn't mapped and has no frames to wait for */
+#define ACCESSIBLE_FLUSH_INTERVAL 16 /* ms */
 
-  if (data != userdata) {
-    return;
-  }
+#define MENUBAR_DATA_ACCESSIBLE_QUEUE "accessible-queue"
 
-  IndicatorObjectEntry *entry = (IndicatorObjectEntry *)data;
-  update_accessible_desc(entry, widget);
-}
+static guint64 accessible_updates_reported = 0;
 
-static void accessible_desc_update(IndicatorObject *io,
-                                   IndicatorObjectEntry *entry,
-                                   GtkWidget *menubar) {
-  gtk_container_foreach(GTK_CONTAINER(menubar), accessible_desc_update_cb,
-                        entry);
-  return;
-}
+/* Entries whose accessible description changed since the last flush */
+typedef struct _accessible_queue_t accessible_queue_t;
+struct _accessible_queue_t {
+  GtkWidget *menubar;
+  GHashTable *entries;
+  guint tick_id;
+  guint timeout_id;
+};
 
-#define PANEL_PADDING 8
-static gboolean entry_resized(GtkWidget *applet, guint newsize, gpointer data) {
-  IndicatorObject *io = (IndicatorObject *)data;
+static void accessible_queue_free(gpointer data) {
+  accessible_queue_t *queue = (accessible_queue_t *)data;
 
-  size = newsize;
+  /* The tick callback goes away with the widget */
+  if (queue->timeout_id != 0) {
+    g_source_remove(queue->timeout_id);
+  }
+  g_hash_table_unref(queue->entries);
+  g_free(queue);
+}
 
-  /* Work on the entries */
-  GList *entries = indicator_object_get_entries(io);
-  GList *entry = NULL;
+static void accessible_queue_flush(accessible_queue_t *queue) {
+  GHashTable *entry_index =
+      g_object_get_data(G_OBJECT(queue->menubar), MENUBAR_DATA_ENTRY_INDEX);
+  GHashTableIter iter;
+  gpointer entry;
 
-  for (entry = entries; entry != NULL; entry = g_list_next(entry)) {
-    IndicatorObjectEntry *entrydata = (IndicatorObjectEntry *)entry->data;
-    if (entrydata->image != NULL) {
-      /* Resize to fit panel */
-      gtk_image_set_pixel_size(entrydata->image, size - PANEL_PADDING);
+  g_hash_table_iter_init(&iter, queue->entries);
+  while (g_hash_table_iter_next(&iter, &entry, NULL)) {
+    GtkWidget *menuitem = g_hash_table_lookup(entry_index, entry);
+
+    if (menuitem != NULL) {
+      update_accessible_desc((IndicatorObjectEntry *)entry, menuitem);
     }
   }
 
-  return FALSE;
+  g_hash_table_remove_all(queue->entries);
 }
 
-static void entry_added(IndicatorObject *io, IndicatorObjectEntry *entry,
-                        GtkWidget *menubar) {
-  g_debug("Signal: Entry Added");
-  gboolean something_visible = FALSE;
-  gboolean something_sensitive = FALSE;
+static gboolean accessible_queue_tick_cb(GtkWidget *widget G_GNUC_UNUSED,
+                                         GdkFrameClock *clock G_GNUC_UNUSED,
+                                         gpointer data) {
+  accessible_queue_t *queue = (accessible_queue_t *)data;
 
-  GtkWidget *menuitem = gtk_menu_item_new();
-  GtkWidget *box = (packdirection == GTK_PACK_DIRECTION_LTR)
-                       ? gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 3)
-                       : gtk_box_new(GTK_ORIENTATION_VERTICAL, 3);
+  queue->tick_id = 0;
+  accessible_queue_flush(queue);
+  return G_SOURCE_REMOVE;
+}
 
-  /* Allows indicators to receive mouse scroll event */
-  gtk_widget_add_events(GTK_WIDGET(menuitem), GDK_SCROLL_MASK);
-  gtk_widget_add_events(GTK_WIDGET(menuitem), GDK_BUTTON_PRESS_MASK);
-  gtk_widget_add_events(GTK_WIDGET(menuitem), GDK_BUTTON_RELEASE_MASK);
+static gboolean accessible_queue_timeout_cb(gpointer data) {
+  accessible_queue_t *queue = (accessible_queue_t *)data;
 
-  g_object_set_data(G_OBJECT(menuitem), "indicator", io);
-  g_object_set_data(G_OBJECT(menuitem), "box", box);
+  queue->timeout_id = 0;
+  accessible_queue_flush(queue);
+  return G_SOURCE_REMOVE;
+}
 
-  g_signal_connect(G_OBJECT(menuitem), "activate", G_CALLBACK(entry_activated),
-                   entry);
-  g_signal_connect(G_OBJECT(menuitem), "scroll-event",
-                   G_CALLBACK(entry_scrolled), entry);
-  g_signal_connect(G_OBJECT(menuitem), "button-press-event",
-                   G_CALLBACK(entry_pressed), entry);
-  g_signal_connect(G_OBJECT(menuitem), "button-release-event",
-                   G_CALLBACK(entry_released), entry);
+/* Indicators like clocks update their description along with every label
+   change; only the last one within a frame is passed on to ATK. */
+static void accessible_desc_update(IndicatorObject *io,
+                                   IndicatorObjectEntry *entry,
+                                   GtkWidget *menubar) {
+  accessible_queue_t *queue =
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_ACCESSIBLE_QUEUE);
 
-  if (entry->image != NULL) {
-    /* Resize to fit panel */
-    gtk_image_set_pixel_size(entry->image, size - PANEL_PADDING);
-    gtk_box_pack_start(GTK_BOX(box), GTK_WIDGET(entry->image), FALSE, FALSE, 1);
-    if (gtk_widget_get_visible(GTK_WIDGET(entry->image))) {
-      something_visible = TRUE;
-    }
+  if (!g_hash_table_add(queue->entries, entry)) {
+    applet_metrics_count(APPLET_COUNTER_ACCESSIBLE_COALESCED);
+  }
 
-    if (gtk_widget_get_sensitive(GTK_WIDGET(entry->image))) {
-      something_sensitive = TRUE;
-    }
+  /* Kept until the menubar is resumed, see menubar_resume() */
+  if (menubar_view_get(menubar)->suspended) {
+    applet_metrics_count(APPLET_COUNTER_LOW_POWER_UPDATES);
+    return;
+  }
 
-    g_signal_connect(G_OBJECT(entry->image), "show",
-                     G_CALLBACK(something_shown), menuitem);
-    g_signal_connect(G_OBJECT(entry->image), "hide",
-                     G_CALLBACK(something_hidden), menuitem);
+  if (queue->tick_id != 0 || queue->timeout_id != 0) {
+    return;
+  }
 
-    g_signal_connect(G_OBJECT(entry->image), "notify::sensitive",
-                     G_CALLBACK(sensitive_cb), menuitem);
+  if (gtk_widget_get_mapped(menubar)) {
+    queue->tick_id = gtk_widget_add_tick_callback(
+        menubar, accessible_queue_tick_cb, queue, NULL);
+  } else {
+    queue->timeout_id = g_timeout_add(ACCESSIBLE_FLUSH_INTERVAL,
+                                      accessible_queue_timeout_cb, queue);
   }
-  if (entry->label != NULL) {
-    switch (packdirection) {
-      case GTK_PACK_DIRECTION_LTR:
-        gtk_label_set_angle(GTK_LABEL(entry->label), 0.0);
-        break;
-      case GTK_PACK_DIRECTION_TTB:
-        gtk_label_set_angle(
-            GTK_LABEL(entry->label),
-            (orient == MATE_PANEL_APPLET_ORIENT_LEFT) ? 270.0 : 90.0);
-        break;
-      default:
-        break;
-    }
-    gtk_box_pack_start(GTK_BOX(box), GTK_WIDGET(entry->label), FALSE, FALSE, 1);
+  return;
+}
 
-    if (gtk_widget_get_visible(GTK_WIDGET(entry->label))) {
-      something_visible = TRUE;
-    }
+static guint64 accessible_updates_total(void) {
+  return applet_metrics_get_counter(APPLET_COUNTER_ACCESSIBLE_APPLIED) +
+         applet_metrics_get_counter(APPLET_COUNTER_ACCESSIBLE_UNCHANGED) +
+         applet_metrics_get_counter(APPLET_COUNTER_ACCESSIBLE_COALESCED);
+}
 
-    if (gtk_widget_get_sensitive(GTK_WIDGET(entry->label))) {
-      something_sensitive = TRUE;
-    }
+static void accessible_stats_log(void) {
+  g_message("Accessible names: %" G_GUINT64_FORMAT
+            " set, %" G_GUINT64_FORMAT " unchanged, %" G_GUINT64_FORMAT
+            " coalesced",
+            applet_metrics_get_counter(APPLET_COUNTER_ACCESSIBLE_APPLIED),
+            applet_metrics_get_counter(APPLET_COUNTER_ACCESSIBLE_UNCHANGED),
+            applet_metrics_get_counter(APPLET_COUNTER_ACCESSIBLE_COALESCED));
 
-    g_signal_connect(G_OBJECT(entry->label), "show",
-                     G_CALLBACK(something_shown), menuitem);
-    g_signal_connect(G_OBJECT(entry->label), "hide",
-                     G_CALLBACK(something_hidden), menuitem);
+  accessible_updates_reported = accessible_updates_total();
+}
 
-    g_signal_connect(G_OBJECT(entry->label), "notify::sensitive",
-                     G_CALLBACK(sensitive_cb), menuitem);
+/*****************
+ * Submenu pre-warming
+ * **************/
+/* The first open of a submenu realizes it and resolves the style and size
+   of every item in it, which large menus make visibly slow.  Once the
+   menubar is up that work is done ahead of time from a low priority idle,
+   a few milliseconds per slice so it never holds up input or redraws. */
+#define PREWARM_SLICE_USEC 4000
+
+#define MENUBAR_DATA_PREWARM_QUEUE "prewarm-queue"
+
+/* Per submenu state, attached as qdata the first time it is seen */
+typedef struct {
+  gboolean prewarmed;
+  gboolean opened;
+  /* Held by a menubar item until it is attached */
+  gboolean deferred;
+  gint64 selected;
+  gulong map_handler;
+} menu_state_t;
+
+static G_DEFINE_QUARK(indicator-applet-menu-state, menu_state)
+
+static menu_state_t *menu_state_get(GtkWidget *menu) {
+  menu_state_t *state = g_object_get_qdata(G_OBJECT(menu), menu_state_quark());
+
+  if (state == NULL) {
+    state = g_new0(menu_state_t, 1);
+    g_object_set_qdata_full(G_OBJECT(menu), menu_state_quark(), state, g_free);
   }
-  gtk_container_add(GTK_CONTAINER(menuitem), box);
-  gtk_widget_show(box);
+  return state;
+}
 
-  if (entry->menu != NULL) {
-    gtk_menu_item_set_submenu(GTK_MENU_ITEM(menuitem), GTK_WIDGET(entry->menu));
+/* Submenus waiting to be pre-warmed, each holding a reference */
+typedef struct _prewarm_queue_t prewarm_queue_t;
+struct _prewarm_queue_t {
+  GtkWidget *menubar;
+  GQueue menus;
+  guint idle_id;
+  gboolean enabled;
+};
+
+static void prewarm_queue_free(gpointer data) {
+  prewarm_queue_t *queue = (prewarm_queue_t *)data;
+
+  if (queue->idle_id != 0) {
+    g_source_remove(queue->idle_id);
   }
+  g_queue_foreach(&queue->menus, (GFunc)g_object_unref, NULL);
+  g_queue_clear(&queue->menus);
+  g_free(queue);
+}
 
-  incoming_position_t position;
-  position.objposition =
-      GPOINTER_TO_INT(g_object_get_data(G_OBJECT(io), IO_DATA_ORDER_NUMBER));
-  position.entryposition = indicator_object_get_location(io, entry);
-  position.menupos = 0;
-  position.found = FALSE;
+static void prewarm_queue_push(prewarm_queue_t *queue, GtkWidget *menu) {
+  if (!queue->enabled || menu_state_get(menu)->prewarmed) {
+    return;
+  }
 
-  gtk_container_foreach(GTK_CONTAINER(menubar), place_in_menu, &position);
+  g_queue_push_tail(&queue->menus, g_object_ref(menu));
+}
 
-  gtk_menu_shell_insert(GTK_MENU_SHELL(menubar), menuitem, position.menupos);
+static void prewarm_menu(prewarm_queue_t *queue, GtkWidget *menu) {
+  menu_state_t *state = menu_state_get(menu);
 
-  if (something_visible) {
-    if (entry->accessible_desc != NULL) {
-      update_accessible_desc(entry, menuitem);
-    }
-    gtk_widget_show(menuitem);
+  /* Opened or taken off the menubar since it was queued */
+  if (state->prewarmed || state->opened ||
+      (gtk_menu_get_attach_widget(GTK_MENU(menu)) == NULL &&
+       !state->deferred)) {
+    return;
   }
-  gtk_widget_set_sensitive(menuitem, something_sensitive);
 
-  g_object_set_data(G_OBJECT(menuitem), MENU_DATA_INDICATOR_ENTRY, entry);
-  g_object_set_data(G_OBJECT(menuitem), MENU_DATA_INDICATOR_OBJECT, io);
+  gtk_widget_realize(menu);
+  gtk_widget_get_preferred_size(menu, NULL, NULL);
+  state->prewarmed = TRUE;
+  applet_metrics_count(APPLET_COUNTER_MENUS_PREWARMED);
 
-  return;
+  /* Nested submenus follow in later slices */
+  GList *children = gtk_container_get_children(GTK_CONTAINER(menu));
+  GList *child = NULL;
+
+  for (child = children; child != NULL; child = g_list_next(child)) {
+    if (GTK_IS_MENU_ITEM(child->data)) {
+      GtkWidget *submenu = gtk_menu_item_get_submenu(child->data);
+      if (submenu != NULL) {
+        prewarm_queue_push(queue, submenu);
+      }
+    }
+  }
+
+  g_list_free(children);
 }
 
-static void entry_removed_cb(GtkWidget *widget, gpointer userdata) {
-  gpointer data =
-      g_object_get_data(G_OBJECT(widget), MENU_DATA_INDICATOR_ENTRY);
+static gboolean prewarm_idle_cb(gpointer data) {
+  prewarm_queue_t *queue = (prewarm_queue_t *)data;
+  const gint64 deadline = g_get_monotonic_time() + PREWARM_SLICE_USEC;
 
-  if (data != userdata) {
-    return;
+  /* Picked up again once the menubar is mapped */
+  if (!gtk_widget_get_mapped(queue->menubar)) {
+    queue->idle_id = 0;
+    return G_SOURCE_REMOVE;
   }
 
-  IndicatorObjectEntry *entry = (IndicatorObjectEntry *)data;
-  if (entry->label != NULL) {
-    g_signal_handlers_disconnect_by_func(G_OBJECT(entry->label),
-                                         G_CALLBACK(something_shown), widget);
-    g_signal_handlers_disconnect_by_func(G_OBJECT(entry->label),
-                                         G_CALLBACK(something_hidden), widget);
-    g_signal_handlers_disconnect_by_func(G_OBJECT(entry->label),
-                                         G_CALLBACK(sensitive_cb), widget);
+  while (!g_queue_is_empty(&queue->menus) &&
+         g_get_monotonic_time() < deadline) {
+    GtkWidget *menu = g_queue_pop_head(&queue->menus);
+    prewarm_menu(queue, menu);
+    g_object_unref(menu);
   }
-  if (entry->image != NULL) {
-    g_signal_handlers_disconnect_by_func(G_OBJECT(entry->image),
-                                         G_CALLBACK(something_shown), widget);
-    g_signal_handlers_disconnect_by_func(G_OBJECT(entry->image),
-                                         G_CALLBACK(something_hidden), widget);
-    g_signal_handlers_disconnect_by_func(G_OBJECT(entry->image),
-                                         G_CALLBACK(sensitive_cb), widget);
+
+  if (!g_queue_is_empty(&queue->menus)) {
+    return G_SOURCE_CONTINUE;
   }
 
-  gtk_widget_destroy(widget);
-  return;
+  queue->idle_id = 0;
+  return G_SOURCE_REMOVE;
 }
 
-static void entry_removed(IndicatorObject *io G_GNUC_UNUSED,
-                          IndicatorObjectEntry *entry, gpointer user_data) {
-  g_debug("Signal: Entry Removed");
+/* Nothing is done before the menubar is shown, startup comes first */
+static void prewarm_queue_start(prewarm_queue_t *queue) {
+  if (queue->idle_id != 0 || g_queue_is_empty(&queue->menus) ||
+      !gtk_widget_get_mapped(queue->menubar)) {
+    return;
+  }
 
-  gtk_container_foreach(GTK_CONTAINER(user_data), entry_removed_cb, entry);
+  queue->idle_id =
+      g_idle_add_full(G_PRIORITY_LOW, prewarm_idle_cb, queue, NULL);
+}
 
-  return;
+static void prewarm_menubar_mapped(GtkWidget *menubar G_GNUC_UNUSED,
+                                   gpointer data) {
+  prewarm_queue_start((prewarm_queue_t *)data);
 }
 
-static void entry_moved_find_cb(GtkWidget *widget, gpointer userdata) {
-  gpointer *array = (gpointer *)userdata;
-  if (array[1] != NULL) {
-    return;
+/* First open latency, from the entry being selected to its menu mapped */
+static void first_open_selected(GtkWidget *menuitem) {
+  GtkWidget *submenu = menuitem_get_menu(menuitem);
+
+  if (submenu != NULL) {
+    menu_state_t *state = menu_state_get(submenu);
+    if (!state->opened) {
+      state->selected = g_get_monotonic_time();
+    }
   }
+}
+
+static void first_open_mapped(GtkWidget *menu, gpointer data G_GNUC_UNUSED) {
+  menu_state_t *state = menu_state_get(menu);
 
-  gpointer data =
-      g_object_get_data(G_OBJECT(widget), MENU_DATA_INDICATOR_ENTRY);
+  state->opened = TRUE;
+  g_signal_handler_disconnect(menu, state->map_handler);
+  state->map_handler = 0;
 
-  if (data != array[0]) {
+  /* Opened by the indicator itself rather than from the menubar */
+  if (state->selected == 0) {
     return;
   }
 
-  array[1] = widget;
-  return;
+  latency_histogram_record(
+      applet_metrics_get_latency(state->prewarmed
+                                     ? APPLET_LATENCY_FIRST_OPEN_WARM
+                                     : APPLET_LATENCY_FIRST_OPEN_COLD),
+      g_get_monotonic_time() - state->selected);
 }
 
-/* Gets called when an entry for an object was moved. */
-static void entry_moved(IndicatorObject *io, IndicatorObjectEntry *entry,
-                        gint old G_GNUC_UNUSED, gint new G_GNUC_UNUSED,
-                        gpointer user_data) {
-  GtkWidget *menubar = GTK_WIDGET(user_data);
-
-  gpointer array[2];
-  array[0] = entry;
-  array[1] = NULL;
+static void first_open_watch(GtkWidget *menu) {
+  menu_state_t *state = menu_state_get(menu);
 
-  gtk_container_foreach(GTK_CONTAINER(menubar), entry_moved_find_cb, array);
-  if (array[1] == NULL) {
-    g_warning("Moving an entry that isn't in our menus.");
+  if (state->opened || state->map_handler != 0) {
     return;
   }
 
-  GtkWidget *mi = GTK_WIDGET(array[1]);
-  g_object_ref(G_OBJECT(mi));
-  gtk_container_remove(GTK_CONTAINER(menubar), mi);
+  state->map_handler = g_signal_connect_after(
+      menu, "map", G_CALLBACK(first_open_mapped), NULL);
+}
 
-  incoming_position_t position;
-  position.objposition =
-      GPOINTER_TO_INT(g_object_get_data(G_OBJECT(io), IO_DATA_ORDER_NUMBER));
-  position.entryposition = indicator_object_get_location(io, entry);
-  position.menupos = 0;
-  position.found = FALSE;
+static guint64 first_open_reported = 0;
 
-  gtk_container_foreach(GTK_CONTAINER(menubar), place_in_menu, &position);
+static guint64 first_open_total(void) {
+  return latency_histogram_get_count(
+             applet_metrics_get_latency(APPLET_LATENCY_FIRST_OPEN_COLD)) +
+         latency_histogram_get_count(
+             applet_metrics_get_latency(APPLET_LATENCY_FIRST_OPEN_WARM));
+}
 
-  gtk_menu_shell_insert(GTK_MENU_SHELL(menubar), mi, position.menupos);
-  g_object_unref(G_OBJECT(mi));
+static void first_open_log(void) {
+  gchar *cold = latency_histogram_to_string(
+      applet_metrics_get_latency(APPLET_LATENCY_FIRST_OPEN_COLD));
+  gchar *warm = latency_histogram_to_string(
+      applet_metrics_get_latency(APPLET_LATENCY_FIRST_OPEN_WARM));
 
-  return;
-}
+  g_message("First menu open: cold %s, pre-warmed %s (%" G_GUINT64_FORMAT
+            " menus pre-warmed)",
+            cold, warm,
+            applet_metrics_get_counter(APPLET_COUNTER_MENUS_PREWARMED));
+  g_free(cold);
+  g_free(warm);
 
-static void menu_show(IndicatorObject *io, IndicatorObjectEntry *entry,
-                      guint32 timestamp, gpointer user_data) {
-  GtkWidget *menubar = GTK_WIDGET(user_data);
+  first_open_reported = first_open_total();
+}
 
-  if (entry == NULL) {
-    /* Close any open menus instead of opening one */
-    GList *entries = indicator_object_get_entries(io);
-    GList *iterator = NULL;
-    for (iterator = entries; iterator != NULL;
-         iterator = g_list_next(iterator)) {
-      IndicatorObjectEntry *entrydata = (IndicatorObjectEntry *)iterator->data;
-      gtk_menu_popdown(entrydata->menu);
+/*****************
+ * Lazy submenus
+ * **************/
+/* Entry menus are only attached to their menubar item when first opened.
+   Attaching reaches every widget in the menu (action muxers, accel paths,
+   screen and direction) and the appmenus of large applications have
+   thousands of them.  Large menus are detached again once unused for a
+   while. */
+#define SUBMENU_DETACH_TIMEOUT 300 /* seconds */
+#define SUBMENU_DETACH_MIN_WIDGETS 200
+
+static void count_widgets_cb(GtkWidget *widget, gpointer data) {
+  guint *count = (guint *)data;
+
+  (*count)++;
+  if (GTK_IS_CONTAINER(widget)) {
+    gtk_container_forall(GTK_CONTAINER(widget), count_widgets_cb, data);
+  }
+  if (GTK_IS_MENU_ITEM(widget)) {
+    GtkWidget *submenu = gtk_menu_item_get_submenu(GTK_MENU_ITEM(widget));
+    if (submenu != NULL) {
+      count_widgets_cb(submenu, data);
     }
-    g_list_free(entries);
+  }
+}
 
-    /* And tell the menubar to exit activation mode too */
-    gtk_menu_shell_cancel(GTK_MENU_SHELL(menubar));
+static void submenu_detach(GtkWidget *menuitem) {
+  menuitem_data_t *item_data = menuitem_data_get(menuitem);
+  GtkWidget *menu = gtk_menu_item_get_submenu(GTK_MENU_ITEM(menuitem));
+
+  if (menu == NULL) {
     return;
   }
 
-  // TODO: do something sensible here
+  item_data->detached_menu = g_object_ref(menu);
+  menu_state_get(menu)->deferred = TRUE;
+  gtk_menu_item_set_submenu(GTK_MENU_ITEM(menuitem), NULL);
+
+  applet_metrics_gauge_add(APPLET_GAUGE_SUBMENU_WIDGETS,
+                           -(gint64)item_data->attached_widgets);
+  item_data->attached_widgets = 0;
+  applet_metrics_count(APPLET_COUNTER_SUBMENUS_DETACHED);
 }
 
-static void update_accessible_desc(IndicatorObjectEntry *entry,
-                                   GtkWidget *menuitem) {
-  /* FIXME: We need to deal with the use case where the contents of the
-     label overrides what is found in the atk object's name, or at least
-     orca speaks the label instead of the atk object name.
-   */
-  AtkObject *menuitem_obj = gtk_widget_get_accessible(menuitem);
-  if (menuitem_obj == NULL) {
-    /* Should there be an error printed here? */
+static void submenu_attach(GtkWidget *menuitem) {
+  menuitem_data_t *item_data = menuitem_data_get(menuitem);
+  GtkWidget *menu = item_data->detached_menu;
+
+  if (menu == NULL) {
     return;
   }
 
-  if (entry->accessible_desc != NULL) {
-    atk_object_set_name(menuitem_obj, entry->accessible_desc);
-  } else {
-    atk_object_set_name(menuitem_obj, "");
+  /* Other applet instances show the same entry, the menu goes with
+     whichever of their items was opened last */
+  GtkWidget *attached_to = gtk_menu_get_attach_widget(GTK_MENU(menu));
+  if (attached_to != NULL && attached_to != menuitem &&
+      menuitem_data_get(attached_to) != NULL) {
+    submenu_detach(attached_to);
   }
-  return;
+
+  item_data->detached_menu = NULL;
+  menu_state_get(menu)->deferred = FALSE;
+
+  const gint64 begin = g_get_monotonic_time();
+  gtk_menu_item_set_submenu(GTK_MENU_ITEM(menuitem), menu);
+  latency_histogram_record(
+      applet_metrics_get_latency(APPLET_LATENCY_SUBMENU_ATTACH),
+      g_get_monotonic_time() - begin);
+  g_object_unref(menu);
+
+  item_data->attached_widgets = 0;
+  count_widgets_cb(menu, &item_data->attached_widgets);
+  applet_metrics_gauge_add(APPLET_GAUGE_SUBMENU_WIDGETS,
+                           item_data->attached_widgets);
+  applet_metrics_count(APPLET_COUNTER_SUBMENUS_ATTACHED);
 }
 
-static void load_indicator(MatePanelApplet *applet, GtkWidget *menubar,
-                           IndicatorObject *io, const gchar *name) {
-  /* Set the environment it's in */
-  indicator_object_set_environment(io, (const GStrv)indicator_env);
+static gboolean submenu_unused_cb(gpointer data) {
+  GtkWidget *menuitem = GTK_WIDGET(data);
+  menuitem_data_t *item_data = menuitem_data_get(menuitem);
+  GtkWidget *menu = gtk_menu_item_get_submenu(GTK_MENU_ITEM(menuitem));
+  guint widgets = 0;
 
-  /* Attach the 'name' to the object */
-#if HAVE_AYATANA_INDICATOR_NG || HAVE_UBUNTU_INDICATOR_NG
-  int pos = 5000 - indicator_object_get_position(io);
-  if (pos > 5000) {
-    pos = name2order(name);
+  item_data->detach_id = 0;
+  if (menu == NULL || gtk_widget_get_visible(menu)) {
+    return G_SOURCE_REMOVE;
   }
-#else
-  int pos = name2order(name);
-#endif
 
-  g_object_set_data(G_OBJECT(io), IO_DATA_ORDER_NUMBER, GINT_TO_POINTER(pos));
+  /* The menu may have grown or shrunk since it was attached */
+  count_widgets_cb(menu, &widgets);
+  applet_metrics_gauge_add(APPLET_GAUGE_SUBMENU_WIDGETS,
+                           (gint64)widgets - item_data->attached_widgets);
+  item_data->attached_widgets = widgets;
 
-  /* Connect to its signals */
-  g_signal_connect(G_OBJECT(io), INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED,
-                   G_CALLBACK(entry_added), menubar);
-  g_signal_connect(G_OBJECT(io), INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED,
-                   G_CALLBACK(entry_removed), menubar);
+  /* Small menus cost less to keep than to attach again */
+  if (widgets >= SUBMENU_DETACH_MIN_WIDGETS) {
+    submenu_detach(menuitem);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Runs as GtkMenuItem's "select" class handler, so the entry's menu is
+   attached before GTK looks for a submenu to pop up, whether the item was
+   selected by the pointer, the keyboard or gtk_menu_shell_select_item().
+   Other menu items are passed straight on. */
+static void submenu_selected(GtkMenuItem *item) {
+  GtkWidget *menuitem = GTK_WIDGET(item);
+  menuitem_data_t *item_data = menuitem_data_get(menuitem);
+
+  if (item_data != NULL) {
+    first_open_selected(menuitem);
+
+    if (item_data->detach_id != 0) {
+      g_source_remove(item_data->detach_id);
+      item_data->detach_id = 0;
+    }
+    submenu_attach(menuitem);
+  }
+
+  g_signal_chain_from_overridden_handler(item);
+}
+
+static void submenu_init(void) {
+  static gboolean overridden = FALSE;
+
+  if (overridden) {
+    return;
+  }
+  overridden = TRUE;
+
+  /* The signal only exists once the class does, which is kept for good */
+  g_type_class_ref(GTK_TYPE_MENU_ITEM);
+  g_signal_override_class_handler("select", GTK_TYPE_MENU_ITEM,
+                                  G_CALLBACK(submenu_selected));
+}
+
+static void submenu_deselected(GtkWidget *menuitem,
+                               gpointer data G_GNUC_UNUSED) {
+  menuitem_data_t *item_data = menuitem_data_get(menuitem);
+
+  if (item_data->detach_id != 0 ||
+      gtk_menu_item_get_submenu(GTK_MENU_ITEM(menuitem)) == NULL) {
+    return;
+  }
+
+  item_data->detach_id = g_timeout_add_seconds(SUBMENU_DETACH_TIMEOUT,
+                                               submenu_unused_cb, menuitem);
+}
+
+static guint64 submenu_attach_reported = 0;
+
+static void submenu_stats_log(void) {
+  LatencyHistogram *attach =
+      applet_metrics_get_latency(APPLET_LATENCY_SUBMENU_ATTACH);
+  gchar *summary = latency_histogram_to_string(attach);
+
+  g_message("Submenus: %" G_GINT64_FORMAT
+            " widgets attached, %" G_GUINT64_FORMAT
+            " detached after disuse, attach %s",
+            applet_metrics_get_gauge(APPLET_GAUGE_SUBMENU_WIDGETS),
+            applet_metrics_get_counter(APPLET_COUNTER_SUBMENUS_DETACHED),
+            summary);
+  g_free(summary);
+
+  submenu_attach_reported = latency_histogram_get_count(attach);
+}
+
+static void menuitem_data_free(gpointer data) {
+  menuitem_data_t *item_data = (menuitem_data_t *)data;
+
+  if (item_data->detach_id != 0) {
+    g_source_remove(item_data->detach_id);
+  }
+  /* The tick callback goes away with the widget */
+  if (item_data->scroll_timeout_id != 0) {
+    g_source_remove(item_data->scroll_timeout_id);
+  }
+  if (item_data->detached_menu != NULL) {
+    menu_state_get(item_data->detached_menu)->deferred = FALSE;
+    g_object_unref(item_data->detached_menu);
+  }
+  applet_metrics_gauge_add(APPLET_GAUGE_SUBMENU_WIDGETS,
+                           -(gint64)item_data->attached_widgets);
+  g_free(item_data);
+}
+
+/*****************
+ * Low power
+ * **************/
+/* Nobody sees a menubar while its panel is hidden, its window is fully
+   covered or the screensaver runs.  The menubar is then hidden in place:
+   indicators keep updating their entries, but the changes stop at the
+   hidden menubar instead of laying it out and drawing it, and its own
+   queued work waits.  Showing it again lays out and draws the latest
+   state once. */
+static gboolean low_power_enabled = TRUE;
+static gboolean screensaver_active = FALSE;
+
+/* The process is in low power while every menubar is suspended */
+static guint menubars_suspended = 0;
+static gint64 low_power_accounting_begin = 0;
+static gint64 low_power_since = 0;
+static guint64 low_power_since_wakeups = 0;
+static guint64 low_power_reported = 0;
+
+static void low_power_account(void) {
+  const gboolean all =
+      menubars != NULL && menubars_suspended == g_list_length(menubars);
+
+  if (all && low_power_since == 0) {
+    low_power_since = g_get_monotonic_time();
+    low_power_since_wakeups =
+        applet_metrics_get_counter(APPLET_COUNTER_WAKEUPS);
+    applet_metrics_count(APPLET_COUNTER_LOW_POWER_ENTERED);
+  } else if (!all && low_power_since != 0) {
+    applet_metrics_count_add(
+        APPLET_COUNTER_LOW_POWER_MS,
+        (g_get_monotonic_time() - low_power_since) / G_TIME_SPAN_MILLISECOND);
+    applet_metrics_count_add(
+        APPLET_COUNTER_LOW_POWER_WAKEUPS,
+        applet_metrics_get_counter(APPLET_COUNTER_WAKEUPS) -
+            low_power_since_wakeups);
+    low_power_since = 0;
+  }
+}
+
+static void menubar_suspend(GtkWidget *menubar) {
+  menubar_view_t *view = menubar_view_get(menubar);
+  GtkWidget *parent = gtk_widget_get_parent(menubar);
+  GtkAllocation allocation;
+
+  /* A menu left open would have nothing to go back to */
+  gtk_menu_shell_cancel(GTK_MENU_SHELL(menubar));
+
+  /* Keeps its place so the panel does not lay out again */
+  gtk_widget_get_allocation(menubar, &allocation);
+  gtk_widget_get_size_request(parent, &view->saved_width,
+                              &view->saved_height);
+  gtk_widget_set_size_request(parent, allocation.width, allocation.height);
+  gtk_widget_hide(menubar);
+
+  view->suspended = TRUE;
+  menubars_suspended++;
+}
+
+static void menubar_resume(GtkWidget *menubar) {
+  menubar_view_t *view = menubar_view_get(menubar);
+  GtkWidget *parent = gtk_widget_get_parent(menubar);
+
+  view->suspended = FALSE;
+  menubars_suspended--;
+
+  if (parent != NULL) {
+    gtk_widget_set_size_request(parent, view->saved_width,
+                                view->saved_height);
+  }
+  gtk_widget_show(menubar);
+
+  /* What changed meanwhile goes out in one batch */
+  accessible_queue_t *queue =
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_ACCESSIBLE_QUEUE);
+  accessible_queue_flush(queue);
+}
+
+static void low_power_update(GtkWidget *menubar) {
+  menubar_view_t *view = menubar_view_get(menubar);
+  const gboolean unseen =
+      low_power_enabled &&
+      (screensaver_active || view->unmapped || view->obscured);
+
+  if (unseen && !view->suspended && gtk_widget_get_parent(menubar) != NULL &&
+      gtk_widget_get_visible(menubar)) {
+    menubar_suspend(menubar);
+  } else if (!unseen && view->suspended) {
+    menubar_resume(menubar);
+  } else {
+    return;
+  }
+
+  g_debug("Menubar %s (unmapped %d, obscured %d, screensaver %d)",
+          view->suspended ? "suspended" : "resumed", view->unmapped,
+          view->obscured, screensaver_active);
+  low_power_account();
+}
+
+static gboolean low_power_map_event(GtkWidget *toplevel G_GNUC_UNUSED,
+                                    GdkEvent *event, gpointer data) {
+  GtkWidget *menubar = GTK_WIDGET(data);
+  menubar_view_t *view = menubar_view_get(menubar);
+
+  view->unmapped = event->type == GDK_UNMAP;
+  view->obscured = FALSE;
+  low_power_update(menubar);
+  return FALSE;
+}
+
+static gboolean low_power_visibility_event(GtkWidget *toplevel G_GNUC_UNUSED,
+                                           GdkEventVisibility *event,
+                                           gpointer data) {
+  GtkWidget *menubar = GTK_WIDGET(data);
+
+  menubar_view_get(menubar)->obscured =
+      event->state == GDK_VISIBILITY_FULLY_OBSCURED;
+  low_power_update(menubar);
+  return FALSE;
+}
+
+static void low_power_unwatch(GtkWidget *menubar) {
+  menubar_view_t *view = menubar_view_get(menubar);
+
+  if (view->toplevel == NULL) {
+    return;
+  }
+
+  g_signal_handlers_disconnect_by_data(view->toplevel, menubar);
+  g_object_remove_weak_pointer(G_OBJECT(view->toplevel),
+                               (gpointer *)&view->toplevel);
+  view->toplevel = NULL;
+}
+
+/* The panel hides and shows the applet's window, not the menubar */
+static void low_power_hierarchy_changed(GtkWidget *menubar,
+                                        GtkWidget *previous G_GNUC_UNUSED,
+                                        gpointer data G_GNUC_UNUSED) {
+  menubar_view_t *view = menubar_view_get(menubar);
+  GtkWidget *toplevel = gtk_widget_get_toplevel(menubar);
+
+  if (toplevel == view->toplevel) {
+    return;
+  }
+
+  low_power_unwatch(menubar);
+  if (!gtk_widget_is_toplevel(toplevel)) {
+    return;
+  }
+
+  view->toplevel = toplevel;
+  g_object_add_weak_pointer(G_OBJECT(toplevel), (gpointer *)&view->toplevel);
+  gtk_widget_add_events(toplevel,
+                        GDK_STRUCTURE_MASK | GDK_VISIBILITY_NOTIFY_MASK);
+  g_signal_connect(toplevel, "map-event", G_CALLBACK(low_power_map_event),
+                   menubar);
+  g_signal_connect(toplevel, "unmap-event", G_CALLBACK(low_power_map_event),
+                   menubar);
+  g_signal_connect(toplevel, "visibility-notify-event",
+                   G_CALLBACK(low_power_visibility_event), menubar);
+}
+
+static void low_power_screensaver_cb(gboolean active,
+                                     gpointer data G_GNUC_UNUSED) {
+  GList *link = NULL;
+
+  screensaver_active = active;
+  for (link = menubars; link != NULL; link = g_list_next(link)) {
+    low_power_update(GTK_WIDGET(link->data));
+  }
+}
+
+static void low_power_forget(GtkWidget *menubar) {
+  menubar_view_t *view = menubar_view_get(menubar);
+
+  low_power_unwatch(menubar);
+  if (view->suspended) {
+    view->suspended = FALSE;
+    menubars_suspended--;
+  }
+  low_power_account();
+}
+
+static void low_power_init(void) {
+  low_power_enabled = g_strcmp0(g_getenv(LOW_POWER_ENV), "0") != 0;
+  low_power_accounting_begin = g_get_monotonic_time();
+  if (low_power_enabled) {
+    applet_dbus_watch_screensaver(low_power_screensaver_cb, NULL);
+  }
+}
+
+static gdouble per_second(guint64 count, gint64 msec) {
+  return msec > 0 ? count * 1000.0 / msec : 0.0;
+}
+
+static void low_power_log(void) {
+  const gint64 now = g_get_monotonic_time();
+  const guint64 wakeups = applet_metrics_get_counter(APPLET_COUNTER_WAKEUPS);
+  guint64 low_wakeups =
+      applet_metrics_get_counter(APPLET_COUNTER_LOW_POWER_WAKEUPS);
+  gint64 low_ms = applet_metrics_get_counter(APPLET_COUNTER_LOW_POWER_MS);
+
+  /* Count the current stretch too */
+  if (low_power_since != 0) {
+    low_wakeups += wakeups - low_power_since_wakeups;
+    low_ms += (now - low_power_since) / G_TIME_SPAN_MILLISECOND;
+  }
+  const gint64 active_ms =
+      (now - low_power_accounting_begin) / G_TIME_SPAN_MILLISECOND - low_ms;
+
+  /* Wakeups are only counted by the watchdog's poll function */
+  if (wakeups == 0) {
+    g_message("Low power: %" G_GUINT64_FORMAT " times for %" G_GINT64_FORMAT
+              " s, %" G_GUINT64_FORMAT " updates held back (set "
+              WATCHDOG_MS_ENV " to count wakeups)",
+              applet_metrics_get_counter(APPLET_COUNTER_LOW_POWER_ENTERED),
+              low_ms / 1000,
+              applet_metrics_get_counter(APPLET_COUNTER_LOW_POWER_UPDATES));
+  } else {
+    g_message("Wakeups: %.1f/s active, %.1f/s in low power (%"
+              G_GUINT64_FORMAT " times for %" G_GINT64_FORMAT " s, %"
+              G_GUINT64_FORMAT " updates held back)",
+              per_second(wakeups - low_wakeups, active_ms),
+              per_second(low_wakeups, low_ms),
+              applet_metrics_get_counter(APPLET_COUNTER_LOW_POWER_ENTERED),
+              low_ms / 1000,
+              applet_metrics_get_counter(APPLET_COUNTER_LOW_POWER_UPDATES));
+  }
+
+  low_power_reported =
+      applet_metrics_get_counter(APPLET_COUNTER_LOW_POWER_ENTERED);
+}
+
+/*****************
+ * Icon lookups
+ * **************/
+/* GTK resolves an entry's icon name against the theme and then
+   INDICATOR_ICONS_DIR.  The directory has no theme index, so unless
+   gtk-update-icon-cache has been run on it every applet process lists and
+   stat()s it; with a current icon-theme.cache GTK maps the file read-only
+   instead and the pages are shared between processes.  "make install"
+   builds the cache, see data/Makefile.am, and the indicators' packages
+   keep it current, see README. */
+#define ICON_CACHE_FILE "icon-theme.cache"
+
+static guint64 icon_lookup_reported = 0;
+
+static void icon_cache_check(void) {
+  gchar *cache = g_build_filename(INDICATOR_ICONS_DIR, ICON_CACHE_FILE, NULL);
+  GStatBuf dir_stat;
+  GStatBuf cache_stat;
+
+  if (g_stat(INDICATOR_ICONS_DIR, &dir_stat) != 0) {
+    g_free(cache);
+    return;
+  }
+
+  /* GTK ignores a cache older than its directory */
+  if (g_stat(cache, &cache_stat) != 0) {
+    g_debug("No icon cache in %s, run gtk-update-icon-cache -f -t %s",
+            INDICATOR_ICONS_DIR, INDICATOR_ICONS_DIR);
+  } else if (cache_stat.st_mtime < dir_stat.st_mtime) {
+    g_debug("Icon cache in %s is stale, run gtk-update-icon-cache -f -t %s",
+            INDICATOR_ICONS_DIR, INDICATOR_ICONS_DIR);
+  }
+  g_free(cache);
+}
+
+/* The icon an image shows by name, if it does */
+static gboolean icon_source(GtkImage *image, const gchar **name,
+                            GIcon **gicon) {
+  *name = NULL;
+  *gicon = NULL;
+
+  switch (gtk_image_get_storage_type(image)) {
+    case GTK_IMAGE_ICON_NAME:
+      gtk_image_get_icon_name(image, name, NULL);
+      break;
+    case GTK_IMAGE_GICON:
+      gtk_image_get_gicon(image, gicon, NULL);
+      break;
+    default:
+      break;
+  }
+  return *name != NULL || *gicon != NULL;
+}
+
+/* Looks the image's icon up for a decode, at the size shown.  Images shown
+   as they are do their own lookup when drawn and are not timed. */
+static GtkIconInfo *icon_lookup(GtkImage *image, gint size, gint scale) {
+  const gchar *name = NULL;
+  GIcon *gicon = NULL;
+
+  if (!icon_source(image, &name, &gicon)) {
+    return NULL;
+  }
+
+  GtkIconTheme *theme = gtk_icon_theme_get_default();
+  GtkIconInfo *info = NULL;
+  const gint64 begin = g_get_monotonic_time();
+  if (name != NULL) {
+    info = gtk_icon_theme_lookup_icon_for_scale(
+        theme, name, MAX(size, 1), scale, GTK_ICON_LOOKUP_FORCE_SIZE);
+  } else {
+    info = gtk_icon_theme_lookup_by_gicon_for_scale(
+        theme, gicon, MAX(size, 1), scale, GTK_ICON_LOOKUP_FORCE_SIZE);
+  }
+  latency_histogram_record(
+      applet_metrics_get_latency(APPLET_LATENCY_ICON_LOOKUP),
+      g_get_monotonic_time() - begin);
+
+  if (info == NULL) {
+    applet_metrics_count(APPLET_COUNTER_ICON_LOOKUPS_MISSED);
+    g_debug("No icon found for %s",
+            name != NULL ? name : G_OBJECT_TYPE_NAME(gicon));
+  }
+  return info;
+}
+
+/* Entries whose image is shown through a mirror, which is always the case
+   with async_icons, get their icons decoded off the main thread.  GTK
+   loads an icon from a GTask on GLib's worker pool; the mirror keeps
+   showing the previous icon until the new one is ready and then only takes
+   the finished surface.  A GtkImage showing the name itself would decode
+   it on the main thread in the next size request. */
+#define MIRROR_DATA_ICON_DECODE "icon-decode"
+
+static gboolean async_icons = TRUE;
+
+typedef struct {
+  /* The icon shown or being decoded, and at what size */
+  gchar *name;
+  GIcon *gicon;
+  gint size;
+  gint scale;
+  gboolean symbolic;
+  /* For symbolic icons, the foreground, success, warning and error colours
+     they were recoloured with */
+  GdkRGBA colors[4];
+  /* Set while the decode is pending */
+  GCancellable *cancellable;
+} icon_decode_t;
+
+typedef struct {
+  GtkImage *mirror;
+  GCancellable *cancellable;
+  gint scale;
+  gint64 begin;
+} icon_decode_request_t;
+
+static void icon_decode_clear(icon_decode_t *decode) {
+  if (decode->cancellable != NULL) {
+    g_cancellable_cancel(decode->cancellable);
+    g_clear_object(&decode->cancellable);
+  }
+  g_clear_pointer(&decode->name, g_free);
+  g_clear_object(&decode->gicon);
+}
+
+static void icon_decode_free(gpointer data) {
+  icon_decode_clear((icon_decode_t *)data);
+  g_free(data);
+}
+
+/* Drops a pending decode so that it cannot replace what the mirror was
+   told to show since */
+static void icon_decode_forget(GtkWidget *mirror) {
+  icon_decode_t *decode =
+      g_object_get_data(G_OBJECT(mirror), MIRROR_DATA_ICON_DECODE);
+
+  if (decode != NULL) {
+    icon_decode_clear(decode);
+  }
+}
+
+static void icon_decoded_cb(GObject *source, GAsyncResult *result,
+                            gpointer data) {
+  icon_decode_request_t *request = (icon_decode_request_t *)data;
+  GtkIconInfo *info = GTK_ICON_INFO(source);
+  GError *error = NULL;
+  GdkPixbuf *pixbuf = NULL;
+
+  if (gtk_icon_info_is_symbolic(info)) {
+    pixbuf = gtk_icon_info_load_symbolic_for_context_finish(info, result,
+                                                            NULL, &error);
+  } else {
+    pixbuf = gtk_icon_info_load_icon_finish(info, result, &error);
+  }
+
+  icon_decode_t *decode =
+      g_object_get_data(G_OBJECT(request->mirror), MIRROR_DATA_ICON_DECODE);
+  if (decode == NULL || decode->cancellable != request->cancellable) {
+    /* Superseded, or cancelled */
+    g_clear_error(&error);
+  } else if (pixbuf == NULL) {
+    g_warning("Unable to load icon: %s", error->message);
+    g_error_free(error);
+
+    /* Leave it to the mirror, and look again on the next change */
+    if (decode->name != NULL) {
+      gtk_image_set_from_icon_name(request->mirror, decode->name,
+                                   GTK_ICON_SIZE_BUTTON);
+    } else {
+      gtk_image_set_from_gicon(request->mirror, decode->gicon,
+                               GTK_ICON_SIZE_BUTTON);
+    }
+    icon_decode_clear(decode);
+  } else {
+    cairo_surface_t *surface = gdk_cairo_surface_create_from_pixbuf(
+        pixbuf, request->scale,
+        gtk_widget_get_window(GTK_WIDGET(request->mirror)));
+    gtk_image_set_from_surface(request->mirror, surface);
+    cairo_surface_destroy(surface);
+    g_clear_object(&decode->cancellable);
+
+    latency_histogram_record(
+        applet_metrics_get_latency(APPLET_LATENCY_ICON_DECODE),
+        g_get_monotonic_time() - request->begin);
+  }
+
+  g_clear_object(&pixbuf);
+  g_object_unref(request->cancellable);
+  g_object_unref(request->mirror);
+  g_free(request);
+}
+
+/* The colours symbolic icons are recoloured with, as GTK looks them up */
+static void icon_symbolic_colors(GtkWidget *widget, GdkRGBA *colors) {
+  static const gchar *names[] = {"success_color", "warning_color",
+                                 "error_color"};
+  GtkStyleContext *context = gtk_widget_get_style_context(widget);
+  guint i;
+
+  gtk_style_context_get_color(context, gtk_style_context_get_state(context),
+                              &colors[0]);
+  for (i = 0; i < G_N_ELEMENTS(names); i++) {
+    if (!gtk_style_context_lookup_color(context, names[i], &colors[i + 1])) {
+      colors[i + 1] = colors[0];
+    }
+  }
+}
+
+static gboolean icon_symbolic_colors_equal(const GdkRGBA *a,
+                                           const GdkRGBA *b) {
+  guint i;
+
+  for (i = 0; i < 4; i++) {
+    if (!gdk_rgba_equal(&a[i], &b[i])) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/* Starts decoding the image's icon for the mirror at the mirror's size,
+   unless that is what it already shows.  FALSE when the icon has to be
+   left to the mirror itself. */
+static gboolean icon_decode(GtkImage *image, GtkImage *mirror,
+                            gboolean restyled) {
+  icon_decode_t *decode =
+      g_object_get_data(G_OBJECT(mirror), MIRROR_DATA_ICON_DECODE);
+  const gint size = gtk_image_get_pixel_size(mirror);
+  const gint scale = gtk_widget_get_scale_factor(GTK_WIDGET(mirror));
+  const gchar *name = NULL;
+  GIcon *gicon = NULL;
+  GdkRGBA colors[4];
+
+  if (!icon_source(image, &name, &gicon)) {
+    return FALSE;
+  }
+
+  /* Most style changes leave the colours alone */
+  if (restyled) {
+    icon_symbolic_colors(GTK_WIDGET(mirror), colors);
+  }
+
+  if (decode == NULL) {
+    decode = g_new0(icon_decode_t, 1);
+    g_object_set_data_full(G_OBJECT(mirror), MIRROR_DATA_ICON_DECODE, decode,
+                           icon_decode_free);
+  } else if (g_strcmp0(decode->name, name) == 0 &&
+             (decode->gicon == gicon ||
+              (decode->gicon != NULL && gicon != NULL &&
+               g_icon_equal(decode->gicon, gicon))) &&
+             decode->size == size && decode->scale == scale &&
+             !(restyled && decode->symbolic &&
+               !icon_symbolic_colors_equal(decode->colors, colors))) {
+    return TRUE;
+  }
+  icon_decode_clear(decode);
+
+  GtkIconInfo *info = icon_lookup(image, size, scale);
+  if (info == NULL) {
+    return FALSE;
+  }
+
+  decode->name = g_strdup(name);
+  decode->gicon = gicon != NULL ? g_object_ref(gicon) : NULL;
+  decode->size = size;
+  decode->scale = scale;
+  decode->symbolic = gtk_icon_info_is_symbolic(info);
+  if (decode->symbolic) {
+    icon_symbolic_colors(GTK_WIDGET(mirror), decode->colors);
+  }
+  decode->cancellable = g_cancellable_new();
+
+  icon_decode_request_t *request = g_new0(icon_decode_request_t, 1);
+  request->mirror = g_object_ref(mirror);
+  request->cancellable = g_object_ref(decode->cancellable);
+  request->scale = scale;
+  request->begin = g_get_monotonic_time();
+
+  /* Symbolic icons are recoloured for the mirror's style, see
+     mirror_image_restyle() */
+  if (decode->symbolic) {
+    gtk_icon_info_load_symbolic_for_context_async(
+        info, gtk_widget_get_style_context(GTK_WIDGET(mirror)),
+        decode->cancellable, icon_decoded_cb, request);
+  } else {
+    gtk_icon_info_load_icon_async(info, decode->cancellable, icon_decoded_cb,
+                                  request);
+  }
+  g_object_unref(info);
+  return TRUE;
+}
+
+static void icon_lookup_log(void) {
+  LatencyHistogram *lookup =
+      applet_metrics_get_latency(APPLET_LATENCY_ICON_LOOKUP);
+  gchar *summary = latency_histogram_to_string(lookup);
+
+  gchar *decode_summary = latency_histogram_to_string(
+      applet_metrics_get_latency(APPLET_LATENCY_ICON_DECODE));
+
+  g_message("Icon lookups: %s, %" G_GUINT64_FORMAT " missed, decode %s",
+            summary,
+            applet_metrics_get_counter(APPLET_COUNTER_ICON_LOOKUPS_MISSED),
+            decode_summary);
+  g_free(decode_summary);
+  g_free(summary);
+
+  icon_lookup_reported = latency_histogram_get_count(lookup);
+}
+
+/*****************
+ * Shared indicators
+ * **************/
+/* Indicators are loaded once per process, by the first applet instance,
+   and every later instance shows the same objects.  An entry's image and
+   label can only be packed once: the first menubar to show an entry gets
+   them and the others show mirrors that follow them. */
+static GHashTable *shared_indicators = NULL;
+
+/* IndicatorObjectEntry -> shared_entry_t, for entries some menubar has
+   shown.  In-process modules hand over floating images and labels that
+   used to be owned by the box they were packed in, and that box may go
+   before the other menubars or the module are done with them, so the
+   registry holds them from the first view until the entry is removed. */
+typedef struct {
+  guint views;
+  GtkWidget *image;
+  GtkWidget *label;
+} shared_entry_t;
+
+static GHashTable *shared_entries = NULL;
+
+static void shared_entry_free(gpointer data) {
+  shared_entry_t *shared = (shared_entry_t *)data;
+
+  /* Destroyed as their menuitem would have */
+  if (shared->image != NULL) {
+    gtk_widget_destroy(shared->image);
+    g_object_unref(shared->image);
+  }
+  if (shared->label != NULL) {
+    gtk_widget_destroy(shared->label);
+    g_object_unref(shared->label);
+  }
+  g_free(shared);
+}
+
+static void shared_entry_view_add(IndicatorObjectEntry *entry) {
+  if (shared_entries == NULL) {
+    shared_entries =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                              shared_entry_free);
+  }
+
+  shared_entry_t *shared = g_hash_table_lookup(shared_entries, entry);
+  if (shared == NULL) {
+    shared = g_new0(shared_entry_t, 1);
+    if (entry->image != NULL) {
+      shared->image = g_object_ref_sink(GTK_WIDGET(entry->image));
+    }
+    if (entry->label != NULL) {
+      shared->label = g_object_ref_sink(GTK_WIDGET(entry->label));
+    }
+    g_hash_table_insert(shared_entries, entry, shared);
+  }
+  shared->views++;
+}
+
+static void shared_entry_view_remove(IndicatorObjectEntry *entry) {
+  shared_entry_t *shared = shared_entries == NULL
+                               ? NULL
+                               : g_hash_table_lookup(shared_entries, entry);
+
+  g_return_if_fail(shared != NULL && shared->views > 0);
+  shared->views--;
+}
+
+/* Connected after every menubar's own handler, which let go of their
+   views in entry_removed() */
+static void shared_entry_removed(IndicatorObject *io G_GNUC_UNUSED,
+                                 IndicatorObjectEntry *entry,
+                                 gpointer data G_GNUC_UNUSED) {
+  if (shared_entries != NULL) {
+    g_hash_table_remove(shared_entries, entry);
+  }
+}
+
+static IndicatorObject *shared_indicator_lookup(const gchar *name) {
+  if (shared_indicators == NULL) {
+    return NULL;
+  }
+  return g_hash_table_lookup(shared_indicators, name);
+}
+
+static void shared_indicator_insert(const gchar *name, IndicatorObject *io) {
+  if (shared_indicators == NULL) {
+    shared_indicators = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                              g_object_unref);
+  }
+  g_hash_table_insert(shared_indicators, g_strdup(name), io);
+  g_signal_connect_after(G_OBJECT(io), INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED,
+                         G_CALLBACK(shared_entry_removed), NULL);
+}
+
+/* What mirrors follow, the label angle and the image pixel size are the
+   view's own */
+static const gchar *mirror_label_properties[] = {
+    "label",     "use-markup",      "use-underline", "attributes",
+    "ellipsize", "width-chars",     "max-width-chars", "visible",
+    "sensitive", NULL};
+
+static const gchar *mirror_image_properties[] = {
+    "storage-type", "pixbuf", "icon-name", "icon-size", "gicon", "surface",
+    "pixbuf-animation", NULL};
+
+static void mirror_image_sync(GtkImage *image, GParamSpec *pspec,
+                              gpointer data) {
+  GtkImage *mirror = GTK_IMAGE(data);
+
+  if (pspec != NULL && !g_strv_contains(mirror_image_properties, pspec->name)) {
+    return;
+  }
+
+  if (async_icons && icon_decode(image, mirror, FALSE)) {
+    return;
+  }
+  icon_decode_forget(GTK_WIDGET(mirror));
+
+  switch (gtk_image_get_storage_type(image)) {
+    case GTK_IMAGE_PIXBUF:
+      gtk_image_set_from_pixbuf(mirror, gtk_image_get_pixbuf(image));
+      break;
+    case GTK_IMAGE_ICON_NAME: {
+      const gchar *icon_name = NULL;
+      GtkIconSize icon_size;
+      gtk_image_get_icon_name(image, &icon_name, &icon_size);
+      gtk_image_set_from_icon_name(mirror, icon_name, icon_size);
+      break;
+    }
+    case GTK_IMAGE_GICON: {
+      GIcon *gicon = NULL;
+      GtkIconSize icon_size;
+      gtk_image_get_gicon(image, &gicon, &icon_size);
+      gtk_image_set_from_gicon(mirror, gicon, icon_size);
+      break;
+    }
+    case GTK_IMAGE_ANIMATION:
+      gtk_image_set_from_animation(mirror, gtk_image_get_animation(image));
+      break;
+    case GTK_IMAGE_SURFACE: {
+      cairo_surface_t *surface = NULL;
+      g_object_get(image, "surface", &surface, NULL);
+      gtk_image_set_from_surface(mirror, surface);
+      cairo_surface_destroy(surface);
+      break;
+    }
+    default:
+      gtk_image_clear(mirror);
+      break;
+  }
+}
+
+/* A decoded icon does not follow the mirror's size nor, when symbolic,
+   its colours by itself */
+static void mirror_image_resize(GtkImage *image,
+                                GParamSpec *pspec G_GNUC_UNUSED,
+                                GtkImage *mirror) {
+  mirror_image_sync(image, NULL, mirror);
+}
+
+static void mirror_image_restyle(GtkImage *image, GtkImage *mirror) {
+  icon_decode(image, mirror, TRUE);
+}
+
+/* The entry's image, or a mirror of it when another menubar shows it or
+   its icons are decoded asynchronously.  size is the pixel size to show
+   it at. */
+static GtkWidget *entry_view_image(GtkImage *image, gint size) {
+  if (gtk_widget_get_parent(GTK_WIDGET(image)) == NULL && !async_icons) {
+    return GTK_WIDGET(image);
+  }
+
+  GtkWidget *mirror = gtk_image_new();
+  gtk_image_set_pixel_size(GTK_IMAGE(mirror), size);
+  g_object_bind_property(image, "visible", mirror, "visible",
+                         G_BINDING_SYNC_CREATE);
+  g_object_bind_property(image, "sensitive", mirror, "sensitive",
+                         G_BINDING_SYNC_CREATE);
+  g_signal_connect_object(image, "notify", G_CALLBACK(mirror_image_sync),
+                          mirror, 0);
+  if (async_icons) {
+    g_signal_connect_object(mirror, "notify::pixel-size",
+                            G_CALLBACK(mirror_image_resize), image,
+                            G_CONNECT_SWAPPED);
+    g_signal_connect_object(mirror, "notify::scale-factor",
+                            G_CALLBACK(mirror_image_resize), image,
+                            G_CONNECT_SWAPPED);
+    g_signal_connect_object(mirror, "style-updated",
+                            G_CALLBACK(mirror_image_restyle), image,
+                            G_CONNECT_SWAPPED);
+    g_signal_connect(mirror, "destroy", G_CALLBACK(icon_decode_forget), NULL);
+  }
+  mirror_image_sync(image, NULL, mirror);
+  return mirror;
+}
+
+static GtkWidget *entry_view_label(GtkLabel *label) {
+  if (gtk_widget_get_parent(GTK_WIDGET(label)) == NULL) {
+    return GTK_WIDGET(label);
+  }
+
+  GtkWidget *mirror = gtk_label_new(NULL);
+  guint i;
+
+  for (i = 0; mirror_label_properties[i] != NULL; i++) {
+    g_object_bind_property(label, mirror_label_properties[i], mirror,
+                           mirror_label_properties[i], G_BINDING_SYNC_CREATE);
+  }
+  return mirror;
+}
+
+#define PANEL_PADDING 8
+
+static gboolean entry_resized(GtkWidget *applet G_GNUC_UNUSED, guint newsize,
+                              gpointer data) {
+  GtkWidget *menubar = GTK_WIDGET(data);
+  GHashTableIter iter;
+  gpointer menuitem;
+
+  menubar_view_get(menubar)->size = newsize;
+
+  /* Work on the entries */
+  g_hash_table_iter_init(
+      &iter, g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_ENTRY_INDEX));
+  while (g_hash_table_iter_next(&iter, NULL, &menuitem)) {
+    menuitem_data_t *item_data = menuitem_data_get(menuitem);
+    if (item_data->image != NULL) {
+      /* Resize to fit panel */
+      gtk_image_set_pixel_size(GTK_IMAGE(item_data->image),
+                               newsize - PANEL_PADDING);
+    }
+  }
+
+  return FALSE;
+}
+
+static void entry_added(IndicatorObject *io, IndicatorObjectEntry *entry,
+                        GtkWidget *menubar) {
+  g_debug("Signal: Entry Added");
+  gboolean something_visible = FALSE;
+  gboolean something_sensitive = FALSE;
+  menubar_view_t *view = menubar_view_get(menubar);
+
+  GtkWidget *menuitem = gtk_menu_item_new();
+  GtkWidget *box = (view->packdirection == GTK_PACK_DIRECTION_LTR)
+                       ? gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 3)
+                       : gtk_box_new(GTK_ORIENTATION_VERTICAL, 3);
+
+  /* Allows indicators to receive mouse scroll event */
+  gtk_widget_add_events(GTK_WIDGET(menuitem),
+                        GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK);
+  gtk_widget_add_events(GTK_WIDGET(menuitem), GDK_BUTTON_PRESS_MASK);
+  gtk_widget_add_events(GTK_WIDGET(menuitem), GDK_BUTTON_RELEASE_MASK);
+
+  shared_entry_view_add(entry);
+
+  menuitem_data_t *item_data = g_new0(menuitem_data_t, 1);
+  item_data->io = io;
+  item_data->entry = entry;
+  item_data->box = box;
+  g_object_set_qdata_full(G_OBJECT(menuitem), menuitem_data_quark(), item_data,
+                          menuitem_data_free);
+
+  g_signal_connect(G_OBJECT(menuitem), "activate", G_CALLBACK(entry_activated),
+                   entry);
+  g_signal_connect(G_OBJECT(menuitem), "scroll-event",
+                   G_CALLBACK(entry_scrolled), entry);
+  g_signal_connect(G_OBJECT(menuitem), "button-press-event",
+                   G_CALLBACK(entry_pressed), entry);
+  g_signal_connect(G_OBJECT(menuitem), "button-release-event",
+                   G_CALLBACK(entry_released), entry);
+  g_signal_connect(G_OBJECT(menuitem), "deselect",
+                   G_CALLBACK(submenu_deselected), NULL);
+
+  if (entry->image != NULL) {
+    item_data->image =
+        entry_view_image(entry->image, view->size - PANEL_PADDING);
+    /* Resize to fit panel */
+    gtk_image_set_pixel_size(GTK_IMAGE(item_data->image),
+                             view->size - PANEL_PADDING);
+    gtk_box_pack_start(GTK_BOX(box), item_data->image, FALSE, FALSE, 1);
+    if (gtk_widget_get_visible(GTK_WIDGET(entry->image))) {
+      something_visible = TRUE;
+    }
+
+    if (gtk_widget_get_sensitive(GTK_WIDGET(entry->image))) {
+      something_sensitive = TRUE;
+    }
+
+    item_data->image_handlers[ITEM_HANDLER_SHOW] =
+        g_signal_connect(G_OBJECT(entry->image), "show",
+                         G_CALLBACK(something_shown), menuitem);
+    item_data->image_handlers[ITEM_HANDLER_HIDE] =
+        g_signal_connect(G_OBJECT(entry->image), "hide",
+                         G_CALLBACK(something_hidden), menuitem);
+
+    item_data->image_handlers[ITEM_HANDLER_SENSITIVE] =
+        g_signal_connect(G_OBJECT(entry->image), "notify::sensitive",
+                         G_CALLBACK(sensitive_cb), menuitem);
+  }
+  if (entry->label != NULL) {
+    item_data->label = entry_view_label(entry->label);
+    gtk_label_set_angle(GTK_LABEL(item_data->label), view_label_angle(view));
+    gtk_box_pack_start(GTK_BOX(box), item_data->label, FALSE, FALSE, 1);
+
+    if (gtk_widget_get_visible(GTK_WIDGET(entry->label))) {
+      something_visible = TRUE;
+    }
+
+    if (gtk_widget_get_sensitive(GTK_WIDGET(entry->label))) {
+      something_sensitive = TRUE;
+    }
+
+    item_data->label_handlers[ITEM_HANDLER_SHOW] =
+        g_signal_connect(G_OBJECT(entry->label), "show",
+                         G_CALLBACK(something_shown), menuitem);
+    item_data->label_handlers[ITEM_HANDLER_HIDE] =
+        g_signal_connect(G_OBJECT(entry->label), "hide",
+                         G_CALLBACK(something_hidden), menuitem);
+
+    item_data->label_handlers[ITEM_HANDLER_SENSITIVE] =
+        g_signal_connect(G_OBJECT(entry->label), "notify::sensitive",
+                         G_CALLBACK(sensitive_cb), menuitem);
+  }
+  gtk_container_add(GTK_CONTAINER(menuitem), box);
+  gtk_widget_show(box);
+
+  prewarm_queue_t *prewarm_queue =
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_PREWARM_QUEUE);
+  if (entry->menu != NULL) {
+    /* Attached once it is opened, see submenu_selected() */
+    item_data->detached_menu = g_object_ref(GTK_WIDGET(entry->menu));
+    menu_state_get(item_data->detached_menu)->deferred = TRUE;
+    first_open_watch(GTK_WIDGET(entry->menu));
+    prewarm_queue_push(prewarm_queue, GTK_WIDGET(entry->menu));
+  }
+
+  incoming_position_t position;
+  position.objposition =
+      GPOINTER_TO_INT(g_object_get_data(G_OBJECT(io), IO_DATA_ORDER_NUMBER));
+  position.entryposition = indicator_object_get_location(io, entry);
+  position.menupos = 0;
+  position.found = FALSE;
+
+  gtk_container_foreach(GTK_CONTAINER(menubar), place_in_menu, &position);
+
+  gtk_menu_shell_insert(GTK_MENU_SHELL(menubar), menuitem, position.menupos);
+
+  if (something_visible) {
+    if (entry->accessible_desc != NULL) {
+      update_accessible_desc(entry, menuitem);
+    }
+    gtk_widget_show(menuitem);
+  }
+  gtk_widget_set_sensitive(menuitem, something_sensitive);
+
+  g_hash_table_insert(
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_ENTRY_INDEX), entry,
+      menuitem);
+
+  prewarm_queue_start(prewarm_queue);
+
+  applet_metrics_count(APPLET_COUNTER_ENTRIES_ADDED);
+  applet_metrics_indicator_entry(io, entry, 1);
+  if (view->suspended) {
+    applet_metrics_count(APPLET_COUNTER_LOW_POWER_UPDATES);
+  }
+
+  return;
+}
+
+static void disconnect_item_handlers(gpointer instance, gulong *handlers) {
+  for (guint i = 0; i < N_ITEM_HANDLERS; i++) {
+    if (handlers[i] != 0) {
+      g_signal_handler_disconnect(instance, handlers[i]);
+      handlers[i] = 0;
+    }
+  }
+}
+
+/* Stops following the entry's own image and label for one menubar and
+   unpacks them if it showed them, the registry keeps them for the others
+   until the entry is removed, see shared_entry_removed() */
+static void entry_view_release(IndicatorObjectEntry *entry,
+                               menuitem_data_t *item_data) {
+  if (entry->image != NULL) {
+    disconnect_item_handlers(entry->image, item_data->image_handlers);
+    if (item_data->image == GTK_WIDGET(entry->image)) {
+      gtk_container_remove(GTK_CONTAINER(item_data->box), item_data->image);
+      item_data->image = NULL;
+    }
+  }
+  if (entry->label != NULL) {
+    disconnect_item_handlers(entry->label, item_data->label_handlers);
+    if (item_data->label == GTK_WIDGET(entry->label)) {
+      gtk_container_remove(GTK_CONTAINER(item_data->box), item_data->label);
+      item_data->label = NULL;
+    }
+  }
+  shared_entry_view_remove(entry);
+}
+
+static void entry_removed(IndicatorObject *io, IndicatorObjectEntry *entry,
+                          gpointer user_data) {
+  g_debug("Signal: Entry Removed");
+  applet_metrics_count(APPLET_COUNTER_ENTRIES_REMOVED);
+
+  GHashTable *entry_index =
+      g_object_get_data(G_OBJECT(user_data), MENUBAR_DATA_ENTRY_INDEX);
+  GtkWidget *menuitem = g_hash_table_lookup(entry_index, entry);
+  g_hash_table_remove(entry_index, entry);
+  accessible_queue_t *queue =
+      g_object_get_data(G_OBJECT(user_data), MENUBAR_DATA_ACCESSIBLE_QUEUE);
+  g_hash_table_remove(queue->entries, entry);
+
+  if (menuitem == NULL) {
+    return;
+  }
+
+  applet_metrics_indicator_entry(io, entry, -1);
+  entry_view_release(entry, menuitem_data_get(menuitem));
+
+  gtk_widget_destroy(menuitem);
+  return;
+}
+
+/* Gets called when an entry for an object was moved. */
+static void entry_moved(IndicatorObject *io, IndicatorObjectEntry *entry,
+                        gint old G_GNUC_UNUSED, gint new G_GNUC_UNUSED,
+                        gpointer user_data) {
+  GtkWidget *menubar = GTK_WIDGET(user_data);
+  applet_metrics_count(APPLET_COUNTER_ENTRIES_MOVED);
+  if (menubar_view_get(menubar)->suspended) {
+    applet_metrics_count(APPLET_COUNTER_LOW_POWER_UPDATES);
+  }
+
+  GtkWidget *mi = g_hash_table_lookup(
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_ENTRY_INDEX), entry);
+  if (mi == NULL) {
+    g_warning("Moving an entry that isn't in our menus.");
+    return;
+  }
+
+  g_object_ref(G_OBJECT(mi));
+  gtk_container_remove(GTK_CONTAINER(menubar), mi);
+
+  incoming_position_t position;
+  position.objposition =
+      GPOINTER_TO_INT(g_object_get_data(G_OBJECT(io), IO_DATA_ORDER_NUMBER));
+  position.entryposition = indicator_object_get_location(io, entry);
+  position.menupos = 0;
+  position.found = FALSE;
+
+  gtk_container_foreach(GTK_CONTAINER(menubar), place_in_menu, &position);
+
+  gtk_menu_shell_insert(GTK_MENU_SHELL(menubar), mi, position.menupos);
+  g_object_unref(G_OBJECT(mi));
+
+  return;
+}
+
+/* Opens the submenu of a menubar item as a click would, closing any other
+   menu that was open */
+static void menubar_open_item(GtkWidget *menubar, GtkWidget *menuitem) {
+  menubar_view_t *view = menubar_view_get(menubar);
+
+  /* Asked for, so it can be seen after all */
+  if (view->suspended && view->obscured) {
+    view->obscured = FALSE;
+    low_power_update(menubar);
+  }
+
+  if (view->suspended || !gtk_widget_get_visible(menuitem) ||
+      !gtk_widget_is_sensitive(menuitem)) {
+    return;
+  }
+
+  gtk_menu_shell_select_item(GTK_MENU_SHELL(menubar), menuitem);
+}
+
+static void menu_show(IndicatorObject *io, IndicatorObjectEntry *entry,
+                      guint32 timestamp, gpointer user_data) {
+  GtkWidget *menubar = GTK_WIDGET(user_data);
+
+  if (entry == NULL) {
+    /* Close any open menus instead of opening one */
+    GList *entries = indicator_object_get_entries(io);
+    GList *iterator = NULL;
+    for (iterator = entries; iterator != NULL;
+         iterator = g_list_next(iterator)) {
+      IndicatorObjectEntry *entrydata = (IndicatorObjectEntry *)iterator->data;
+      gtk_menu_popdown(entrydata->menu);
+    }
+    g_list_free(entries);
+
+    /* And tell the menubar to exit activation mode too */
+    gtk_menu_shell_cancel(GTK_MENU_SHELL(menubar));
+    return;
+  }
+
+  /* Every applet instance gets the request, one of them opens the menu */
+  if (menubar != primary_menubar()) {
+    return;
+  }
+
+  GtkWidget *menuitem = g_hash_table_lookup(
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_ENTRY_INDEX), entry);
+  if (menuitem == NULL) {
+    g_warning("Asked to show the menu of an entry that isn't in our menus.");
+    return;
+  }
+
+  menubar_open_item(menubar, menuitem);
+}
+
+static void update_accessible_desc(IndicatorObjectEntry *entry,
+                                   GtkWidget *menuitem) {
+  /* FIXME: We need to deal with the use case where the contents of the
+     label overrides what is found in the atk object's name, or at least
+     orca speaks the label instead of the atk object name.
+   */
+  AtkObject *menuitem_obj = gtk_widget_get_accessible(menuitem);
+  if (menuitem_obj == NULL) {
+    /* Should there be an error printed here? */
+    return;
+  }
+
+  const gchar *name =
+      (entry->accessible_desc != NULL) ? entry->accessible_desc : "";
+
+  /* Every change goes out on the accessibility bus, skip the no-ops */
+  if (g_strcmp0(atk_object_get_name(menuitem_obj), name) == 0) {
+    applet_metrics_count(APPLET_COUNTER_ACCESSIBLE_UNCHANGED);
+    return;
+  }
+
+  atk_object_set_name(menuitem_obj, name);
+  applet_metrics_count(APPLET_COUNTER_ACCESSIBLE_APPLIED);
+  return;
+}
+
+/* The indicator signals go through these so the time spent in each
+   handler is kept per indicator, see applet-metrics.h, and stalls in them
+   are blamed on it */
+static void entry_added_timed(IndicatorObject *io, IndicatorObjectEntry *entry,
+                              GtkWidget *menubar) {
+  gpointer scope = applet_watchdog_enter(io);
+  const gint64 begin = g_get_monotonic_time();
+  entry_added(io, entry, menubar);
+  applet_metrics_handler_time(io, APPLET_HANDLER_ENTRY_ADDED,
+                              g_get_monotonic_time() - begin);
+  applet_watchdog_leave(scope);
+}
+
+static void entry_removed_timed(IndicatorObject *io,
+                                IndicatorObjectEntry *entry,
+                                gpointer user_data) {
+  gpointer scope = applet_watchdog_enter(io);
+  const gint64 begin = g_get_monotonic_time();
+  entry_removed(io, entry, user_data);
+  applet_metrics_handler_time(io, APPLET_HANDLER_ENTRY_REMOVED,
+                              g_get_monotonic_time() - begin);
+  applet_watchdog_leave(scope);
+}
+
+static void entry_moved_timed(IndicatorObject *io, IndicatorObjectEntry *entry,
+                              gint old, gint new, gpointer user_data) {
+  gpointer scope = applet_watchdog_enter(io);
+  const gint64 begin = g_get_monotonic_time();
+  entry_moved(io, entry, old, new, user_data);
+  applet_metrics_handler_time(io, APPLET_HANDLER_ENTRY_MOVED,
+                              g_get_monotonic_time() - begin);
+  applet_watchdog_leave(scope);
+}
+
+static void menu_show_timed(IndicatorObject *io, IndicatorObjectEntry *entry,
+                            guint32 timestamp, gpointer user_data) {
+  gpointer scope = applet_watchdog_enter(io);
+  const gint64 begin = g_get_monotonic_time();
+  menu_show(io, entry, timestamp, user_data);
+  applet_metrics_handler_time(io, APPLET_HANDLER_MENU_SHOW,
+                              g_get_monotonic_time() - begin);
+  applet_watchdog_leave(scope);
+}
+
+static void accessible_desc_update_timed(IndicatorObject *io,
+                                         IndicatorObjectEntry *entry,
+                                         GtkWidget *menubar) {
+  gpointer scope = applet_watchdog_enter(io);
+  const gint64 begin = g_get_monotonic_time();
+  accessible_desc_update(io, entry, menubar);
+  applet_metrics_handler_time(io, APPLET_HANDLER_ACCESSIBLE_DESC_UPDATE,
+                              g_get_monotonic_time() - begin);
+  applet_watchdog_leave(scope);
+}
+
+/* Stops listening to an indicator that keeps stalling the main loop and
+   takes its entries off every menubar, menubars built later skip it */
+static void quarantine_indicator(gpointer indicator,
+                                 gpointer user_data G_GNUC_UNUSED) {
+  IndicatorObject *io = INDICATOR_OBJECT(indicator);
+  GList *entries = indicator_object_get_entries(io);
+  GList *link = NULL;
+
+  g_object_set_data(G_OBJECT(io), IO_DATA_QUARANTINED, GINT_TO_POINTER(TRUE));
+
+  for (link = menubars; link != NULL; link = g_list_next(link)) {
+    GtkWidget *menubar = GTK_WIDGET(link->data);
+    GList *entry = NULL;
+
+    if (g_signal_handlers_disconnect_by_data(io, menubar) == 0) {
+      continue;
+    }
+
+    for (entry = entries; entry != NULL; entry = g_list_next(entry)) {
+      entry_removed(io, (IndicatorObjectEntry *)entry->data, menubar);
+    }
+  }
+
+  g_list_free(entries);
+}
+
+static void add_indicator(GtkWidget *menubar, IndicatorObject *io,
+                          const gchar *name) {
+  if (g_object_get_data(G_OBJECT(io), IO_DATA_QUARANTINED) != NULL) {
+    return;
+  }
+
+  /* Set the environment it's in */
+  indicator_object_set_environment(io, (const GStrv)indicator_env);
+
+  /* Attach the 'name' to the object */
+#if HAVE_AYATANA_INDICATOR_NG || HAVE_UBUNTU_INDICATOR_NG
+  int pos = 5000 - indicator_object_get_position(io);
+  if (pos > 5000) {
+    pos = name2order(name);
+  }
+#else
+  int pos = name2order(name);
+#endif
+
+  g_object_set_data(G_OBJECT(io), IO_DATA_ORDER_NUMBER, GINT_TO_POINTER(pos));
+
+  g_hash_table_insert(
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_INDICATOR_INDEX),
+      g_strdup(name), g_object_ref(io));
+  applet_metrics_add_indicator(io, name);
+  applet_watchdog_add_indicator(
+      io, name, g_object_get_data(G_OBJECT(io), IO_DATA_MODULE_PATH),
+      quarantine_indicator, NULL);
+
+  /* Connect to its signals */
+  g_signal_connect(G_OBJECT(io), INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED,
+                   G_CALLBACK(entry_added_timed), menubar);
+  g_signal_connect(G_OBJECT(io), INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED,
+                   G_CALLBACK(entry_removed_timed), menubar);
   g_signal_connect(G_OBJECT(io), INDICATOR_OBJECT_SIGNAL_ENTRY_MOVED,
-                   G_CALLBACK(entry_moved), menubar);
+                   G_CALLBACK(entry_moved_timed), menubar);
   g_signal_connect(G_OBJECT(io), INDICATOR_OBJECT_SIGNAL_MENU_SHOW,
-                   G_CALLBACK(menu_show), menubar);
+                   G_CALLBACK(menu_show_timed), menubar);
   g_signal_connect(G_OBJECT(io), INDICATOR_OBJECT_SIGNAL_ACCESSIBLE_DESC_UPDATE,
-                   G_CALLBACK(accessible_desc_update), menubar);
-
-  /* Track panel resize */
-  g_signal_connect_object(G_OBJECT(applet), "change-size",
-                          G_CALLBACK(entry_resized), G_OBJECT(io), 0);
+                   G_CALLBACK(accessible_desc_update_timed), menubar);
 
   /* Work on the entries */
   GList *entries = indicator_object_get_entries(io);
@@ -667,8 +2335,47 @@ static void load_indicator(MatePanelApplet *applet, GtkWidget *menubar,
   g_list_free(entries);
 }
 
-static gboolean load_module(const gchar *name, MatePanelApplet *applet,
-                            GtkWidget *menubar) {
+static void load_indicator(GtkWidget *menubar, IndicatorObject *io,
+                           const gchar *name) {
+  APPLET_TRACE_BEGIN(trace_begin);
+
+  add_indicator(menubar, io, name);
+
+  APPLET_TRACE_END(trace_begin, "load_indicator", "%s", name);
+}
+
+static const gchar *indicator_dir(void) {
+  const gchar *dir = g_getenv(INDICATOR_DIR_ENV);
+  return (dir != NULL && *dir != '\0') ? dir : INDICATOR_DIR;
+}
+
+/* Whether the comma separated list in the variable, parsed into *list on
+   first use, names name or is "*" */
+static gboolean env_list_contains(const gchar *variable, gchar ***list,
+                                  const gchar *name) {
+  gchar **item;
+
+  if (*list == NULL) {
+    const gchar *value = g_getenv(variable);
+    *list = (value != NULL && *value != '\0') ? g_strsplit(value, ",", -1)
+                                              : g_new0(gchar *, 1);
+  }
+
+  for (item = *list; *item != NULL; item++) {
+    if (g_strcmp0(*item, "*") == 0 || g_strcmp0(*item, name) == 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static gboolean module_isolated(const gchar *name) {
+  static gchar **isolated = NULL;
+  return env_list_contains(ISOLATE_MODULES_ENV, &isolated, name);
+}
+
+static gboolean load_module(const gchar *name, GtkWidget *menubar) {
   g_debug("Looking at Module: %s", name);
   g_return_val_if_fail(name != NULL, FALSE);
 
@@ -676,22 +2383,61 @@ static gboolean load_module(const gchar *name, MatePanelApplet *applet,
     return FALSE;
   }
 
+  /* Loaded for another applet instance already */
+  IndicatorObject *io = shared_indicator_lookup(name);
+  if (io != NULL) {
+    load_indicator(menubar, io, name);
+    return TRUE;
+  }
+
   g_debug("Loading Module: %s", name);
+  APPLET_TRACE_BEGIN(trace_begin);
 
   /* Build the object for the module */
-  gchar *fullpath = g_build_filename(INDICATOR_DIR, name, NULL);
-  IndicatorObject *io = indicator_object_new_from_file(fullpath);
-  g_free(fullpath);
+  gchar *fullpath = g_build_filename(indicator_dir(), name, NULL);
+
+  if (module_isolated(name)) {
+    GError *error = NULL;
+
+    io = indicator_remote_new(fullpath, &error);
+    if (io == NULL) {
+      g_warning("Unable to start a host for module %s: %s", name,
+                error->message);
+      g_error_free(error);
+    }
+    g_free(fullpath);
+  } else {
+    APPLET_TRACE_BEGIN(trace_new_begin);
+    io = indicator_object_new_from_file(fullpath);
+    APPLET_TRACE_END(trace_new_begin, "indicator_object_new_from_file", "%s",
+                     fullpath);
+
+    if (io != NULL) {
+      /* Lets the watchdog find the module in stack samples */
+      g_object_set_data_full(G_OBJECT(io), IO_DATA_MODULE_PATH, fullpath,
+                             g_free);
+    } else {
+      g_free(fullpath);
+    }
+  }
+
+  if (io == NULL) {
+    g_warning("Unable to load module: %s", name);
+    return FALSE;
+  }
 
-  load_indicator(applet, menubar, io, name);
+  shared_indicator_insert(name, io);
+  load_indicator(menubar, io, name);
 
+  APPLET_TRACE_END(trace_begin, "load_module", "%s", name);
   return TRUE;
 }
 
-static void load_modules(MatePanelApplet *applet, GtkWidget *menubar,
-                         gint *indicators_loaded) {
-  if (g_file_test(INDICATOR_DIR, (G_FILE_TEST_EXISTS | G_FILE_TEST_IS_DIR))) {
-    GDir *dir = g_dir_open(INDICATOR_DIR, 0, NULL);
+static void load_modules(GtkWidget *menubar, gint *indicators_loaded) {
+  const gchar *modules_dir = indicator_dir();
+
+  if (g_file_test(modules_dir, (G_FILE_TEST_EXISTS | G_FILE_TEST_IS_DIR))) {
+    GDir *dir = g_dir_open(modules_dir, 0, NULL);
 
     const gchar *name;
     gint count = 0;
@@ -713,7 +2459,7 @@ static void load_modules(MatePanelApplet *applet, GtkWidget *menubar,
         continue;
       }
 #endif
-      if (load_module(name, applet, menubar)) {
+      if (load_module(name, menubar)) {
         count++;
       }
     }
@@ -726,12 +2472,91 @@ static void load_modules(MatePanelApplet *applet, GtkWidget *menubar,
 
 #if HAVE_AYATANA_INDICATOR_NG || HAVE_UBUNTU_INDICATOR_NG
 
-static void load_indicators_from_indicator_files(MatePanelApplet *applet,
-                                                 GtkWidget *menubar,
+/* New style services are all asked to start before any object for them
+   is built.  Each IndicatorNg would otherwise have its own service
+   activated only once it gets to watching the name, and the bus would
+   start them one after another.  The requests go out back to back on the
+   shared session bus connection and nothing waits for the replies: the
+   menubar is shown right away and an entry shows up as its service
+   does. */
+#define SERVICE_START_TIMEOUT_MS 10000
+
+typedef struct {
+  gchar *name;
+  gint64 begin;
+} service_start_t;
+
+static guint services_starting = 0;
+static guint services_started = 0;
+static gint64 services_start_begin = 0;
+/* The start times added up, what starting them in turn would come to */
+static gint64 services_start_serial = 0;
+
+static void service_started_cb(GObject *source, GAsyncResult *result,
+                               gpointer user_data) {
+  service_start_t *start = (service_start_t *)user_data;
+  GError *error = NULL;
+  GVariant *reply =
+      g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error);
+  const gint64 now = g_get_monotonic_time();
+
+  /* Services started by the session manager are not activatable */
+  if (reply == NULL) {
+    g_debug("Unable to start %s: %s", start->name, error->message);
+    g_error_free(error);
+  } else {
+    services_started++;
+    g_variant_unref(reply);
+  }
+
+  services_start_serial += now - start->begin;
+  if (--services_starting == 0) {
+    g_message("Services: %u started or running in %.1f ms, %.1f ms one "
+              "after another",
+              services_started, (now - services_start_begin) / 1000.0,
+              services_start_serial / 1000.0);
+  }
+
+  g_free(start->name);
+  g_free(start);
+}
+
+static void services_start(GPtrArray *names) {
+  GError *error = NULL;
+  GDBusConnection *bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+  guint i;
+
+  if (bus == NULL) {
+    g_warning("Unable to get the session bus: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  services_start_begin = g_get_monotonic_time();
+  for (i = 0; i < names->len; i++) {
+    service_start_t *start = g_new0(service_start_t, 1);
+    start->name = g_strdup(g_ptr_array_index(names, i));
+    start->begin = g_get_monotonic_time();
+
+    services_starting++;
+    g_dbus_connection_call(
+        bus, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+        "org.freedesktop.DBus", "StartServiceByName",
+        g_variant_new("(su)", start->name, 0), G_VARIANT_TYPE("(u)"),
+        G_DBUS_CALL_FLAGS_NONE, SERVICE_START_TIMEOUT_MS, NULL,
+        service_started_cb, start);
+  }
+
+  g_object_unref(bus);
+}
+
+static void load_indicators_from_indicator_files(GtkWidget *menubar,
                                                  gint *indicators_loaded) {
+  static gchar **menu_model_services = NULL;
   GDir *dir;
   const gchar *name;
   GError *error = NULL;
+  guint i;
 
   dir = g_dir_open(INDICATOR_SERVICE_DIR, 0, &error);
 
@@ -743,15 +2568,12 @@ static void load_indicators_from_indicator_files(MatePanelApplet *applet,
     return;
   }
 
-  gint count = 0;
+  /* Service files are named after their services' bus names */
+  GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+  GPtrArray *unstarted = g_ptr_array_new();
   while ((name = g_dir_read_name(dir))) {
-    gchar *filename;
-    IndicatorNg *indicator;
-
-    filename = g_build_filename(INDICATOR_SERVICE_DIR, name, NULL);
-    indicator = indicator_ng_new_for_profile(filename, "desktop", &error);
-    g_free(filename);
-
+    /* Filter on the name before constructing anything, a skipped
+       indicator would otherwise be leaked */
 #ifdef INDICATOR_APPLET_APPMENU
     if (g_strcmp0(name, INDICATOR_SERVICE_APPMENU_NG)) {
       continue;
@@ -770,35 +2592,325 @@ static void load_indicators_from_indicator_files(MatePanelApplet *applet,
     }
 #endif
 
-    if (indicator) {
-      load_indicator(applet, menubar, INDICATOR_OBJECT(indicator), name);
-      count++;
-    } else {
-      g_warning("unable to load '%s': %s", name, error->message);
-      g_clear_error(&error);
+    g_ptr_array_add(names, g_strdup(name));
+    /* Started for another applet instance already */
+    if (shared_indicator_lookup(name) == NULL) {
+      g_ptr_array_add(unstarted, g_ptr_array_index(names, names->len - 1));
+    }
+  }
+  g_dir_close(dir);
+
+  if (unstarted->len > 0) {
+    APPLET_TRACE_BEGIN(trace_start_begin);
+    services_start(unstarted);
+    APPLET_TRACE_END(trace_start_begin, "services_start", "%u services",
+                     unstarted->len);
+  }
+  g_ptr_array_unref(unstarted);
+
+  gint count = 0;
+  for (i = 0; i < names->len; i++) {
+    gchar *filename;
+    IndicatorObject *io;
+
+    name = g_ptr_array_index(names, i);
+    io = shared_indicator_lookup(name);
+    if (io != NULL) {
+      load_indicator(menubar, io, name);
+      count++;
+      continue;
+    }
+
+    filename = g_build_filename(INDICATOR_SERVICE_DIR, name, NULL);
+    APPLET_TRACE_BEGIN(trace_begin);
+    if (env_list_contains(MENU_MODEL_SERVICES_ENV, &menu_model_services,
+                          name)) {
+      io = indicator_remote_new_for_service(filename, "desktop", &error);
+      APPLET_TRACE_END(trace_begin, "indicator_remote_new_for_service", "%s",
+                       name);
+    } else {
+      io = (IndicatorObject *)indicator_ng_new_for_profile(filename,
+                                                           "desktop", &error);
+      APPLET_TRACE_END(trace_begin, "indicator_ng_new_for_profile", "%s",
+                       name);
+    }
+    g_free(filename);
+
+    if (io) {
+      shared_indicator_insert(name, io);
+      load_indicator(menubar, io, name);
+      count++;
+    } else {
+      g_warning("unable to load '%s': %s", name, error->message);
+      g_clear_error(&error);
+    }
+  }
+
+  *indicators_loaded += count;
+
+  g_ptr_array_unref(names);
+}
+#endif /* HAVE_AYATANA_INDICATOR_NG || HAVE_UBUNTU_INDICATOR_NG */
+
+/*****************
+ * Hotkey latency
+ * **************/
+#define HOTKEY_MAX_PLAUSIBLE_AGE_MS 10000
+/* A menu not shown by then is taken as a hotkey that failed to open it */
+#define HOTKEY_PENDING_TIMEOUT_MS 1000
+
+static LatencyHistogram *hotkey_latency = NULL;
+static guint64 hotkey_latency_reported = 0;
+
+/* The submenu a hotkey is waiting to see mapped */
+static GtkWidget *hotkey_pending_menu = NULL;
+static gulong hotkey_pending_handler = 0;
+static gint64 hotkey_pending_start = 0;
+static guint hotkey_pending_timeout_id = 0;
+
+/* The X server stamps key events with its own millisecond clock, which on a
+   local Xorg is CLOCK_MONOTONIC just like ours.  When the stamp is plausible
+   it is used, so the time the event sat in queues before the keybinder saw
+   it counts too; otherwise we start from when the keybinder received it. */
+static gint64 hotkey_event_start(guint32 event_time, gint64 received) {
+  gint64 now = g_get_monotonic_time();
+
+  if (received == 0) {
+    received = now;
+  }
+
+  if (event_time != GDK_CURRENT_TIME) {
+    guint32 age_ms = (guint32)(now / 1000) - event_time;
+    gint64 stamped = now - (gint64)age_ms * 1000;
+
+    if (age_ms < HOTKEY_MAX_PLAUSIBLE_AGE_MS && stamped <= received) {
+      return stamped;
+    }
+  }
+
+  return received;
+}
+
+static void hotkey_pending_clear(void) {
+  if (hotkey_pending_timeout_id != 0) {
+    g_source_remove(hotkey_pending_timeout_id);
+    hotkey_pending_timeout_id = 0;
+  }
+
+  if (hotkey_pending_menu == NULL) {
+    return;
+  }
+
+  g_signal_handler_disconnect(hotkey_pending_menu, hotkey_pending_handler);
+  g_object_remove_weak_pointer(G_OBJECT(hotkey_pending_menu),
+                               (gpointer *)&hotkey_pending_menu);
+  hotkey_pending_menu = NULL;
+  hotkey_pending_handler = 0;
+}
+
+/* Otherwise a later open by mouse would be recorded against the hotkey */
+static gboolean hotkey_pending_timeout_cb(gpointer data G_GNUC_UNUSED) {
+  hotkey_pending_timeout_id = 0;
+  g_debug("Hotkey did not open its menu");
+  hotkey_pending_clear();
+  return G_SOURCE_REMOVE;
+}
+
+static void hotkey_menu_mapped(GtkWidget *menu G_GNUC_UNUSED,
+                               gpointer data G_GNUC_UNUSED) {
+  gint64 latency = g_get_monotonic_time() - hotkey_pending_start;
+
+  hotkey_pending_clear();
+
+  latency_histogram_record(hotkey_latency, latency);
+  g_debug("Hotkey opened its menu after %" G_GINT64_FORMAT " us", latency);
+}
+
+static void hotkey_dispatched(gint64 latency) {
+  latency_histogram_record(
+      applet_metrics_get_latency(APPLET_LATENCY_HOTKEY_DISPATCH), latency);
+}
+
+static void hotkey_latency_log(void) {
+  LatencyHistogram *dispatch =
+      applet_metrics_get_latency(APPLET_LATENCY_HOTKEY_DISPATCH);
+  gchar *summary = latency_histogram_to_string(hotkey_latency);
+
+  g_message("Hotkey to menu latency: %s", summary);
+  g_free(summary);
+
+  if (latency_histogram_get_count(dispatch) > 0) {
+    summary = latency_histogram_to_string(dispatch);
+    g_message("Hotkey thread dispatch: %s", summary);
+    g_free(summary);
+  }
+
+  hotkey_latency_reported = latency_histogram_get_count(hotkey_latency);
+}
+
+/* Opens the submenu of a menubar item on behalf of a hotkey */
+static void hotkey_open_item(GtkWidget *menubar, GtkWidget *item) {
+  gint64 start =
+      hotkey_event_start(tomboy_keybinder_get_current_event_time(),
+                         tomboy_keybinder_get_current_event_received());
+  GtkWidget *submenu = menuitem_get_menu(item);
+
+  /* Time it until the menu shows up, unless it's up already */
+  if (submenu != NULL && !gtk_widget_get_mapped(submenu) &&
+      submenu != hotkey_pending_menu) {
+    hotkey_pending_clear();
+    hotkey_pending_menu = submenu;
+    hotkey_pending_start = start;
+    hotkey_pending_handler = g_signal_connect_after(
+        submenu, "map", G_CALLBACK(hotkey_menu_mapped), NULL);
+    g_object_add_weak_pointer(G_OBJECT(submenu),
+                              (gpointer *)&hotkey_pending_menu);
+    hotkey_pending_timeout_id = g_timeout_add(
+        HOTKEY_PENDING_TIMEOUT_MS, hotkey_pending_timeout_cb, NULL);
+  }
+
+  menubar_open_item(menubar, item);
+}
+
+static void hotkey_filter(char *keystring G_GNUC_UNUSED,
+                          gpointer data G_GNUC_UNUSED) {
+  GtkWidget *menubar = primary_menubar();
+  g_return_if_fail(GTK_IS_MENU_SHELL(menubar));
+
+  /* Oh, wow, it's us! */
+  GList *children = gtk_container_get_children(GTK_CONTAINER(menubar));
+  if (children == NULL) {
+    g_debug("Menubar has no children");
+    return;
+  }
+
+  GtkWidget *item = GTK_WIDGET(g_list_last(children)->data);
+  g_list_free(children);
+
+  hotkey_open_item(menubar, item);
+  return;
+}
+
+static void indicator_hotkey_filter(char *keystring, gpointer data) {
+  const gchar *name = (const gchar *)data;
+  GtkWidget *menubar = primary_menubar();
+  g_return_if_fail(menubar != NULL);
+
+  IndicatorObject *io = g_hash_table_lookup(
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_INDICATOR_INDEX),
+      name);
+  if (io == NULL) {
+    g_debug("Hotkey '%s': '%s' is not loaded", keystring, name);
+    return;
+  }
+
+  GHashTable *entry_index =
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_ENTRY_INDEX);
+
+  /* The indicator's leftmost visible item is the one to open */
+  GtkWidget *target = NULL;
+  guint target_location = G_MAXUINT;
+  GList *entries = indicator_object_get_entries(io);
+  GList *entry = NULL;
+
+  for (entry = entries; entry != NULL; entry = g_list_next(entry)) {
+    GtkWidget *item = g_hash_table_lookup(entry_index, entry->data);
+    guint location = indicator_object_get_location(io, entry->data);
+
+    if (item != NULL && gtk_widget_get_visible(item) &&
+        location < target_location) {
+      target = item;
+      target_location = location;
+    }
+  }
+  g_list_free(entries);
+
+  if (target == NULL) {
+    g_debug("Hotkey '%s': nothing of '%s' is shown", keystring, name);
+    return;
+  }
+
+  hotkey_open_item(menubar, target);
+}
+
+/* The indicator hotkeys bound, as {keystring, indicator name} vectors */
+static GPtrArray *indicator_hotkeys = NULL;
+static gboolean hotkeys_bound = FALSE;
+
+/* Binds every configured indicator hotkey, whether the indicator is loaded
+   yet or not: indicator_hotkey_filter() looks it up on the press, so one
+   that shows up later, such as a service that starts late, still gets its
+   key.  They open the primary menubar whichever instance bound them. */
+static void bind_indicator_hotkeys(void) {
+  const gchar *config = g_getenv(INDICATOR_HOTKEYS_ENV);
+
+  if (config == NULL) {
+    return;
+  }
+
+  gchar **bindings = g_strsplit(config, ";", -1);
+  gchar **binding = NULL;
+
+  indicator_hotkeys = g_ptr_array_new_with_free_func(
+      (GDestroyNotify)g_strfreev);
+  for (binding = bindings; *binding != NULL; binding++) {
+    gchar **parts = g_strsplit(*binding, "=", 2);
+
+    if (g_strv_length(parts) == 2) {
+      g_strstrip(parts[0]);
+      g_strstrip(parts[1]);
+
+      g_debug("Binding '%s' to open '%s'", parts[0], parts[1]);
+      if (tomboy_keybinder_bind(parts[0], indicator_hotkey_filter,
+                                parts[1])) {
+        g_ptr_array_add(indicator_hotkeys, parts);
+        parts = NULL;
+      }
+    } else if (**binding != '\0') {
+      g_warning("Ignoring malformed indicator hotkey '%s'", *binding);
     }
+
+    g_strfreev(parts);
   }
 
-  *indicators_loaded += count;
+  g_strfreev(bindings);
+}
 
-  g_dir_close(dir);
+static void unbind_indicator_hotkeys(void) {
+  guint i;
+
+  if (indicator_hotkeys == NULL) {
+    return;
+  }
+
+  for (i = 0; i < indicator_hotkeys->len; i++) {
+    gchar **parts = g_ptr_array_index(indicator_hotkeys, i);
+    tomboy_keybinder_unbind(parts[0], indicator_hotkey_filter);
+  }
+  g_clear_pointer(&indicator_hotkeys, g_ptr_array_unref);
 }
-#endif /* HAVE_AYATANA_INDICATOR_NG || HAVE_UBUNTU_INDICATOR_NG */
 
-static void hotkey_filter(char *keystring G_GNUC_UNUSED, gpointer data) {
-  g_return_if_fail(GTK_IS_MENU_SHELL(data));
+/* Once for all instances, see primary_menubar() */
+static void hotkeys_bind(void) {
+  if (hotkeys_bound) {
+    return;
+  }
+
+  tomboy_keybinder_bind(hotkey_keycode, hotkey_filter, NULL);
+  bind_indicator_hotkeys();
+  hotkeys_bound = TRUE;
+}
 
-  /* Oh, wow, it's us! */
-  GList *children = gtk_container_get_children(GTK_CONTAINER(data));
-  if (children == NULL) {
-    g_debug("Menubar has no children");
+/* Once the last instance is gone */
+static void hotkeys_unbind(void) {
+  if (!hotkeys_bound) {
     return;
   }
 
-  gtk_menu_shell_select_item(GTK_MENU_SHELL(data),
-                             GTK_WIDGET(g_list_last(children)->data));
-  g_list_free(children);
-  return;
+  tomboy_keybinder_unbind(hotkey_keycode, hotkey_filter);
+  unbind_indicator_hotkeys();
+  tomboy_keybinder_shutdown();
+  hotkeys_bound = FALSE;
 }
 
 static gboolean menubar_press(GtkWidget *widget, GdkEventButton *event,
@@ -821,6 +2933,45 @@ static gboolean menubar_on_draw(GtkWidget *widget, cairo_t *cr,
   return FALSE;
 }
 
+/* Start of the draw in progress, draws of the menubar never nest */
+static gint64 draw_begin = 0;
+
+static gboolean metrics_draw_begin_cb(GtkWidget *widget G_GNUC_UNUSED,
+                                      cairo_t *cr G_GNUC_UNUSED,
+                                      gpointer data G_GNUC_UNUSED) {
+  draw_begin = g_get_monotonic_time();
+  return FALSE;
+}
+
+static gboolean metrics_draw_end_cb(GtkWidget *widget G_GNUC_UNUSED,
+                                    cairo_t *cr G_GNUC_UNUSED,
+                                    gpointer data G_GNUC_UNUSED) {
+  applet_metrics_count(APPLET_COUNTER_DRAWS);
+  latency_histogram_record(applet_metrics_get_latency(APPLET_LATENCY_DRAW),
+                           g_get_monotonic_time() - draw_begin);
+  return FALSE;
+}
+
+static void metrics_size_allocate_cb(GtkWidget *widget G_GNUC_UNUSED,
+                                     GdkRectangle *allocation G_GNUC_UNUSED,
+                                     gpointer data G_GNUC_UNUSED) {
+  applet_metrics_count(APPLET_COUNTER_RELAYOUTS);
+}
+
+/* When the current applet_fill_cb() started, for the first draw mark */
+static gint64 startup_begin = 0;
+
+#ifdef HAVE_SYSPROF
+static gboolean trace_first_draw_cb(GtkWidget *widget,
+                                    cairo_t *cr G_GNUC_UNUSED,
+                                    gpointer data G_GNUC_UNUSED) {
+  g_signal_handlers_disconnect_by_func(widget, trace_first_draw_cb, NULL);
+  APPLET_TRACE_END(startup_begin, "first draw", "%s",
+                   g_get_application_name());
+  return FALSE;
+}
+#endif
+
 static void about_cb(GtkAction *action G_GNUC_UNUSED,
                      gpointer data G_GNUC_UNUSED) {
   static const gchar *authors[] = {"Ted Gould <ted@canonical.com>", NULL};
@@ -868,34 +3019,26 @@ static gboolean swap_orient_cb(GtkWidget *item, gpointer data) {
   GtkWidget *to = (GtkWidget *)g_object_get_data(G_OBJECT(from), "to");
   g_object_ref(G_OBJECT(item));
   gtk_container_remove(GTK_CONTAINER(from), item);
-  if (GTK_IS_LABEL(item)) {
-    switch (packdirection) {
-      case GTK_PACK_DIRECTION_LTR:
-        gtk_label_set_angle(GTK_LABEL(item), 0.0);
-        break;
-      case GTK_PACK_DIRECTION_TTB:
-        gtk_label_set_angle(
-            GTK_LABEL(item),
-            (orient == MATE_PANEL_APPLET_ORIENT_LEFT) ? 270.0 : 90.0);
-        break;
-      default:
-        break;
-    }
-  }
   gtk_box_pack_start(GTK_BOX(to), item, FALSE, FALSE, 0);
+  g_object_unref(G_OBJECT(item));
   return TRUE;
 }
 
 static gboolean reorient_box_cb(GtkWidget *menuitem, gpointer data) {
-  GtkWidget *from = g_object_get_data(G_OBJECT(menuitem), "box");
-  GtkWidget *to = (packdirection == GTK_PACK_DIRECTION_LTR)
+  const menubar_view_t *view = (const menubar_view_t *)data;
+  menuitem_data_t *item_data = menuitem_data_get(menuitem);
+  GtkWidget *from = item_data->box;
+  GtkWidget *to = (view->packdirection == GTK_PACK_DIRECTION_LTR)
                       ? gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0)
                       : gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
   g_object_set_data(G_OBJECT(from), "to", to);
   gtk_container_foreach(GTK_CONTAINER(from), (GtkCallback)swap_orient_cb, from);
+  if (item_data->label != NULL) {
+    gtk_label_set_angle(GTK_LABEL(item_data->label), view_label_angle(view));
+  }
   gtk_container_remove(GTK_CONTAINER(menuitem), from);
   gtk_container_add(GTK_CONTAINER(menuitem), to);
-  g_object_set_data(G_OBJECT(menuitem), "box", to);
+  item_data->box = to;
   gtk_widget_show_all(menuitem);
   return TRUE;
 }
@@ -904,23 +3047,16 @@ static gboolean matepanelapplet_reorient_cb(GtkWidget *applet,
                                             MatePanelAppletOrient neworient,
                                             gpointer data) {
   GtkWidget *menubar = (GtkWidget *)data;
-  if ((((neworient == MATE_PANEL_APPLET_ORIENT_UP) ||
-        (neworient == MATE_PANEL_APPLET_ORIENT_DOWN)) &&
-       ((orient == MATE_PANEL_APPLET_ORIENT_LEFT) ||
-        (orient == MATE_PANEL_APPLET_ORIENT_RIGHT))) ||
-      (((neworient == MATE_PANEL_APPLET_ORIENT_LEFT) ||
-        (neworient == MATE_PANEL_APPLET_ORIENT_RIGHT)) &&
-       ((orient == MATE_PANEL_APPLET_ORIENT_UP) ||
-        (orient == MATE_PANEL_APPLET_ORIENT_DOWN)))) {
-    packdirection = (packdirection == GTK_PACK_DIRECTION_LTR)
-                        ? GTK_PACK_DIRECTION_TTB
-                        : GTK_PACK_DIRECTION_LTR;
-    gtk_menu_bar_set_pack_direction(GTK_MENU_BAR(menubar), packdirection);
-    orient = neworient;
+  menubar_view_t *view = menubar_view_get(menubar);
+  GtkPackDirection newpackdirection = orient_packdirection(neworient);
+
+  view->orient = neworient;
+  if (newpackdirection != view->packdirection) {
+    view->packdirection = newpackdirection;
+    gtk_menu_bar_set_pack_direction(GTK_MENU_BAR(menubar), newpackdirection);
     gtk_container_foreach(GTK_CONTAINER(menubar), (GtkCallback)reorient_box_cb,
-                          NULL);
+                          view);
   }
-  orient = neworient;
   return FALSE;
 }
 
@@ -929,9 +3065,57 @@ static gboolean matepanelapplet_reorient_cb(GtkWidget *applet,
 #endif
 #define N_(x) x
 
+/*************
+ * statistics
+ * ***********/
+#define STATS_REPORT_INTERVAL 300 /* seconds */
+
+static gboolean stats_report_cb(gpointer data G_GNUC_UNUSED) {
+  if (latency_histogram_get_count(hotkey_latency) != hotkey_latency_reported) {
+    hotkey_latency_log();
+  }
+
+  if (accessible_updates_total() != accessible_updates_reported) {
+    accessible_stats_log();
+  }
+
+  if (first_open_total() != first_open_reported) {
+    first_open_log();
+  }
+
+  if (latency_histogram_get_count(applet_metrics_get_latency(
+          APPLET_LATENCY_SUBMENU_ATTACH)) != submenu_attach_reported) {
+    submenu_stats_log();
+  }
+
+  if (applet_metrics_get_counter(APPLET_COUNTER_LOW_POWER_ENTERED) !=
+      low_power_reported) {
+    low_power_log();
+  }
+
+  if (latency_histogram_get_count(applet_metrics_get_latency(
+          APPLET_LATENCY_ICON_LOOKUP)) != icon_lookup_reported) {
+    icon_lookup_log();
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* SIGUSR1 writes the current numbers to the log on demand */
+static gboolean stats_query_cb(gpointer data G_GNUC_UNUSED) {
+  hotkey_latency_log();
+  accessible_stats_log();
+  first_open_log();
+  submenu_stats_log();
+  low_power_log();
+  icon_lookup_log();
+  return G_SOURCE_CONTINUE;
+}
+
 static void log_to_file_cb(GObject *source_obj G_GNUC_UNUSED,
                            GAsyncResult *result G_GNUC_UNUSED,
                            gpointer user_data) {
+  applet_metrics_gauge_add(APPLET_GAUGE_LOG_QUEUE_DEPTH, -1);
   g_free(user_data);
   return;
 }
@@ -970,6 +3154,9 @@ static void log_to_file(const gchar *domain G_GNUC_UNUSED,
     log_file = g_io_stream_get_output_stream(G_IO_STREAM(io));
   }
 
+  applet_metrics_count(APPLET_COUNTER_LOG_MESSAGES);
+  applet_metrics_gauge_add(APPLET_GAUGE_LOG_QUEUE_DEPTH, 1);
+
   gchar *outputstring = g_strdup_printf("%s\n", message);
   g_output_stream_write_async(log_file, outputstring, /* data */
                               strlen(outputstring),   /* length */
@@ -981,49 +3168,363 @@ static void log_to_file(const gchar *domain G_GNUC_UNUSED,
   return;
 }
 
+/*************
+ * Remote control
+ * ***********/
+
+/* The indicators outlive a menubar whose applet instance is removed from
+   its panel.  Runs before the menubar's items are destroyed, which would
+   take the entries' own image, label and menu along with them. */
+static void menubar_destroyed(GtkWidget *menubar,
+                              gpointer data G_GNUC_UNUSED) {
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+
+  menubars = g_list_remove(menubars, menubar);
+  applet_metrics_gauge_add(APPLET_GAUGE_MENUBARS, -1);
+  if (menubars == NULL) {
+    hotkeys_unbind();
+  }
+  low_power_forget(menubar);
+
+  g_hash_table_iter_init(
+      &iter,
+      g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_INDICATOR_INDEX));
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    g_signal_handlers_disconnect_by_data(value, menubar);
+  }
+
+  g_hash_table_iter_init(
+      &iter, g_object_get_data(G_OBJECT(menubar), MENUBAR_DATA_ENTRY_INDEX));
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    IndicatorObjectEntry *entry = (IndicatorObjectEntry *)key;
+    menuitem_data_t *item_data = menuitem_data_get(value);
+
+    entry_view_release(entry, item_data);
+    applet_metrics_indicator_entry(item_data->io, entry, -1);
+    submenu_detach(value);
+  }
+}
+
+/* Looks the entry up through the indexes, never walking the menubar */
+static GtkWidget *control_find_entry(const gchar *indicator, guint position,
+                                     GtkWidget **menubar, GError **error) {
+  GList *link = NULL;
+
+  for (link = menubars; link != NULL; link = g_list_next(link)) {
+    IndicatorObject *io = g_hash_table_lookup(
+        g_object_get_data(G_OBJECT(link->data), MENUBAR_DATA_INDICATOR_INDEX),
+        indicator);
+    if (io == NULL) {
+      continue;
+    }
+
+    GList *entries = indicator_object_get_entries(io);
+    IndicatorObjectEntry *entry = g_list_nth_data(entries, position);
+    g_list_free(entries);
+
+    GtkWidget *menuitem =
+        entry == NULL ? NULL
+                      : g_hash_table_lookup(
+                            g_object_get_data(G_OBJECT(link->data),
+                                              MENUBAR_DATA_ENTRY_INDEX),
+                            entry);
+    if (menuitem == NULL) {
+      g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                  "Indicator '%s' shows no entry %u", indicator, position);
+      return NULL;
+    }
+
+    *menubar = link->data;
+    return menuitem;
+  }
+
+  g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No indicator '%s'",
+              indicator);
+  return NULL;
+}
+
+/* Compares labels the way they read, without mnemonic underscores */
+static gboolean label_matches(const gchar *label, const gchar *wanted) {
+  if (label == NULL) {
+    return FALSE;
+  }
+
+  while (*label != '\0') {
+    if (*label == '_') {
+      label++;
+      continue;
+    }
+    if (*label != *wanted) {
+      return FALSE;
+    }
+    label++;
+    wanted++;
+  }
+
+  return *wanted == '\0';
+}
+
+static GtkWidget *find_menu_item(GtkWidget *menu, const gchar *label) {
+  GList *children = gtk_container_get_children(GTK_CONTAINER(menu));
+  GList *child = NULL;
+  GtkWidget *found = NULL;
+
+  for (child = children; child != NULL && found == NULL;
+       child = g_list_next(child)) {
+    if (GTK_IS_MENU_ITEM(child->data) &&
+        label_matches(gtk_menu_item_get_label(child->data), label)) {
+      found = child->data;
+    }
+  }
+
+  g_list_free(children);
+  return found;
+}
+
+static gboolean control_open_entry(const gchar *indicator, guint position,
+                                   GError **error) {
+  GtkWidget *menubar = NULL;
+  GtkWidget *menuitem =
+      control_find_entry(indicator, position, &menubar, error);
+
+  if (menuitem == NULL) {
+    return FALSE;
+  }
+
+  menubar_open_item(menubar, menuitem);
+  return TRUE;
+}
+
+static void control_close_all(void) {
+  GList *link = NULL;
+
+  for (link = menubars; link != NULL; link = g_list_next(link)) {
+    gtk_menu_shell_cancel(GTK_MENU_SHELL(link->data));
+  }
+}
+
+static gboolean control_activate_item(const gchar *indicator, guint position,
+                                      const gchar *const *path,
+                                      GError **error) {
+  GtkWidget *menubar = NULL;
+  GtkWidget *item = control_find_entry(indicator, position, &menubar, error);
+  guint i;
+
+  if (item == NULL) {
+    return FALSE;
+  }
+
+  if (path == NULL || path[0] == NULL) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                        "No item given");
+    return FALSE;
+  }
+
+  for (i = 0; path[i] != NULL; i++) {
+    GtkWidget *submenu = i == 0
+                             ? menuitem_get_menu(item)
+                             : gtk_menu_item_get_submenu(GTK_MENU_ITEM(item));
+
+    item = submenu != NULL ? find_menu_item(submenu, path[i]) : NULL;
+    if (item == NULL) {
+      g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No item '%s'",
+                  path[i]);
+      return FALSE;
+    }
+  }
+
+  if (!gtk_widget_is_sensitive(item)) {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                "Item '%s' is insensitive", path[i - 1]);
+    return FALSE;
+  }
+
+  gtk_menu_item_activate(GTK_MENU_ITEM(item));
+  gtk_menu_shell_cancel(GTK_MENU_SHELL(menubar));
+  return TRUE;
+}
+
+static const AppletDBusControl menubar_control = {
+    control_open_entry, control_close_all, control_activate_item};
+
+/* Attaches the view, the indexes and the queues every menubar carries,
+   see entry_added() and entry_removed() */
+static void menubar_attach_state(GtkWidget *menubar,
+                                 MatePanelAppletOrient orient, guint size) {
+  menubar_view_t *view = g_new0(menubar_view_t, 1);
+  view->orient = orient;
+  view->packdirection = orient_packdirection(orient);
+  view->size = size;
+  g_object_set_data_full(G_OBJECT(menubar), MENUBAR_DATA_VIEW, view, g_free);
+  gtk_menu_bar_set_pack_direction(GTK_MENU_BAR(menubar), view->packdirection);
+
+  g_object_set_data_full(
+      G_OBJECT(menubar), MENUBAR_DATA_INDICATOR_INDEX,
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref),
+      (GDestroyNotify)g_hash_table_unref);
+  g_object_set_data_full(G_OBJECT(menubar), MENUBAR_DATA_ENTRY_INDEX,
+                         g_hash_table_new(g_direct_hash, g_direct_equal),
+                         (GDestroyNotify)g_hash_table_unref);
+
+  accessible_queue_t *accessible_queue = g_new0(accessible_queue_t, 1);
+  accessible_queue->menubar = menubar;
+  accessible_queue->entries = g_hash_table_new(g_direct_hash, g_direct_equal);
+  g_object_set_data_full(G_OBJECT(menubar), MENUBAR_DATA_ACCESSIBLE_QUEUE,
+                         accessible_queue, accessible_queue_free);
+
+  prewarm_queue_t *prewarm_queue = g_new0(prewarm_queue_t, 1);
+  prewarm_queue->menubar = menubar;
+  g_queue_init(&prewarm_queue->menus);
+  prewarm_queue->enabled = g_strcmp0(g_getenv(PREWARM_MENUS_ENV), "0") != 0;
+  g_object_set_data_full(G_OBJECT(menubar), MENUBAR_DATA_PREWARM_QUEUE,
+                         prewarm_queue, prewarm_queue_free);
+  g_signal_connect_after(menubar, "map", G_CALLBACK(prewarm_menubar_mapped),
+                         prewarm_queue);
+
+  menubars = g_list_prepend(menubars, menubar);
+  applet_metrics_gauge_add(APPLET_GAUGE_MENUBARS, 1);
+  g_signal_connect(menubar, "destroy", G_CALLBACK(menubar_destroyed), NULL);
+  g_signal_connect(menubar, "hierarchy-changed",
+                   G_CALLBACK(low_power_hierarchy_changed), NULL);
+  submenu_init();
+}
+
+/* Process wide setup shared by the panel applet and the standalone host */
+static void applet_init_once(void) {
+  static gboolean first_time = FALSE;
+
+  if (first_time) {
+    return;
+  }
+  first_time = TRUE;
+
+#ifdef INDICATOR_APPLET
+  g_set_application_name(_("Indicator Applet"));
+#endif
+#ifdef INDICATOR_APPLET_COMPLETE
+  g_set_application_name(_("Indicator Applet Complete"));
+#endif
+#ifdef INDICATOR_APPLET_APPMENU
+  g_set_application_name(_("Indicator Applet Application Menu"));
+#endif
+
+  hotkey_latency = applet_metrics_get_latency(APPLET_LATENCY_HOTKEY);
+  applet_dbus_init(METRICS_BUS_NAME);
+  if (g_strcmp0(g_getenv(DBUS_CONTROL_ENV), "1") == 0) {
+    applet_dbus_set_control(&menubar_control);
+  }
+  g_timeout_add_seconds(STATS_REPORT_INTERVAL, stats_report_cb, NULL);
+  g_unix_signal_add(SIGUSR1, stats_query_cb, NULL);
+
+  guint64 watchdog_ms = 0;
+  if (g_getenv(WATCHDOG_MS_ENV) != NULL) {
+    watchdog_ms = g_ascii_strtoull(g_getenv(WATCHDOG_MS_ENV), NULL, 10);
+  }
+  if (watchdog_ms > 0) {
+    const gchar *quarantine = g_getenv(WATCHDOG_QUARANTINE_ENV);
+    applet_watchdog_start(
+        watchdog_ms,
+        quarantine != NULL ? g_ascii_strtoull(quarantine, NULL, 10) : 0);
+  }
+  low_power_init();
+
+  /* Keep hotkeys responsive while the main loop is busy */
+  gboolean hotkey_thread = g_getenv("INDICATOR_APPLET_HOTKEY_THREAD") != NULL;
+  APPLET_TRACE_BEGIN(trace_begin);
+  if (hotkey_thread) {
+    tomboy_keybinder_init_threaded();
+    tomboy_keybinder_set_dispatch_handler(hotkey_dispatched);
+  } else {
+    tomboy_keybinder_init();
+  }
+  APPLET_TRACE_END(trace_begin, "tomboy_keybinder_init", "%s",
+                   hotkey_thread ? "threaded" : "main loop");
+
+  /* Init some theme/icon stuff */
+  gtk_icon_theme_append_search_path(gtk_icon_theme_get_default(),
+                                    INDICATOR_ICONS_DIR);
+  icon_cache_check();
+  async_icons = g_strcmp0(g_getenv(ASYNC_ICONS_ENV), "0") != 0;
+  /* g_debug("Icons directory: %s", INDICATOR_ICONS_DIR); */
+}
+
+/* Builds a menubar for the given size and orient and shows every indicator
+   in it, loading those no other applet instance has loaded yet.  applet is
+   NULL when there is no panel to follow. */
+static GtkWidget *menubar_new(MatePanelApplet *applet,
+                              MatePanelAppletOrient orient, guint size,
+                              gint *indicators_loaded) {
+  GtkWidget *menubar = gtk_menu_bar_new();
+
+  gtk_widget_set_can_focus(menubar, TRUE);
+  gtk_widget_set_name(GTK_WIDGET(menubar), "fast-user-switch-menubar");
+  g_signal_connect(menubar, "button-press-event", G_CALLBACK(menubar_press),
+                   NULL);
+  g_signal_connect_after(menubar, "draw", G_CALLBACK(menubar_on_draw), menubar);
+#ifdef HAVE_SYSPROF
+  g_signal_connect(menubar, "draw", G_CALLBACK(trace_first_draw_cb), NULL);
+#endif
+  g_signal_connect(menubar, "draw", G_CALLBACK(metrics_draw_begin_cb), NULL);
+  g_signal_connect_after(menubar, "draw", G_CALLBACK(metrics_draw_end_cb),
+                         NULL);
+  g_signal_connect(menubar, "size-allocate",
+                   G_CALLBACK(metrics_size_allocate_cb), NULL);
+  gtk_container_set_border_width(GTK_CONTAINER(menubar), 0);
+  menubar_attach_state(menubar, orient, size);
+
+  /* Track panel resize, the standalone host resizes by hand */
+  if (applet != NULL) {
+    g_signal_connect_object(G_OBJECT(applet), "change-size",
+                            G_CALLBACK(entry_resized), G_OBJECT(menubar), 0);
+  }
+
+  hotkeys_bind();
+
+  APPLET_TRACE_BEGIN(trace_begin);
+  load_modules(menubar, indicators_loaded);
+  APPLET_TRACE_END(trace_begin, "load_modules", "%d indicators",
+                   *indicators_loaded);
+#if HAVE_AYATANA_INDICATOR_NG || HAVE_UBUNTU_INDICATOR_NG
+  APPLET_TRACE_BEGIN(trace_ng_begin);
+  load_indicators_from_indicator_files(menubar, indicators_loaded);
+  APPLET_TRACE_END(trace_ng_begin, "load_indicators_from_indicator_files",
+                   "%d indicators", *indicators_loaded);
+#endif
+
+  return menubar;
+}
+
 static gboolean applet_fill_cb(MatePanelApplet *applet,
                                const gchar *iid G_GNUC_UNUSED,
                                gpointer data G_GNUC_UNUSED) {
+  startup_begin = APPLET_TRACE_NOW();
+
 #if HAVE_AYATANA_INDICATOR_NG || HAVE_UBUNTU_INDICATOR_NG
+  APPLET_TRACE_BEGIN(trace_begin);
   ido_init();
+  APPLET_TRACE_END(trace_begin, "ido_init", "%s", iid);
 #endif
 
   static const GtkActionEntry menu_actions[] = {
       {"About", "help-about", N_("_About"), NULL, NULL, G_CALLBACK(about_cb)}};
   static const gchar *menu_xml = "<menuitem name=\"About\" action=\"About\"/>";
 
-  static gboolean first_time = FALSE;
+  static gboolean log_handler_set = FALSE;
   GtkWidget *menubar;
   gint indicators_loaded = 0;
   GtkActionGroup *action_group;
 
-  if (!first_time) {
-    first_time = TRUE;
-#ifdef INDICATOR_APPLET
-    g_set_application_name(_("Indicator Applet"));
-#endif
-#ifdef INDICATOR_APPLET_COMPLETE
-    g_set_application_name(_("Indicator Applet Complete"));
-#endif
-#ifdef INDICATOR_APPLET_APPMENU
-    g_set_application_name(_("Indicator Applet Application Menu"));
-#endif
-
+  if (!log_handler_set) {
+    log_handler_set = TRUE;
     g_log_set_default_handler(log_to_file, NULL);
-
-    tomboy_keybinder_init();
   }
+  applet_init_once();
 
   /* Set panel options */
   gtk_container_set_border_width(GTK_CONTAINER(applet), 0);
   mate_panel_applet_set_flags(applet, MATE_PANEL_APPLET_EXPAND_MINOR);
-  menubar = gtk_menu_bar_new();
-  action_group = gtk_action_group_new("Indicator Applet Actions");
-  gtk_action_group_set_translation_domain(action_group, GETTEXT_PACKAGE);
-  gtk_action_group_add_actions(action_group, menu_actions,
-                               G_N_ELEMENTS(menu_actions), menubar);
-  mate_panel_applet_setup_menu(applet, menu_xml, action_group);
-  g_object_unref(action_group);
 #ifdef INDICATOR_APPLET
   atk_object_set_name(gtk_widget_get_accessible(GTK_WIDGET(applet)),
                       "indicator-applet");
@@ -1036,45 +3537,33 @@ static gboolean applet_fill_cb(MatePanelApplet *applet,
   atk_object_set_name(gtk_widget_get_accessible(GTK_WIDGET(applet)),
                       "indicator-applet-appmenu");
 #endif
-
-  /* Init some theme/icon stuff */
-  gtk_icon_theme_append_search_path(gtk_icon_theme_get_default(),
-                                    INDICATOR_ICONS_DIR);
-  /* g_debug("Icons directory: %s", INDICATOR_ICONS_DIR); */
   gtk_widget_set_name(GTK_WIDGET(applet), "fast-user-switch-applet");
 
   /* Build menubar */
-  size = (mate_panel_applet_get_size(applet));
-  orient = (mate_panel_applet_get_orient(applet));
-  packdirection = ((orient == MATE_PANEL_APPLET_ORIENT_UP) ||
-                   (orient == MATE_PANEL_APPLET_ORIENT_DOWN))
-                      ? GTK_PACK_DIRECTION_LTR
-                      : GTK_PACK_DIRECTION_TTB;
-  gtk_menu_bar_set_pack_direction(GTK_MENU_BAR(menubar), packdirection);
-  gtk_widget_set_can_focus(menubar, TRUE);
-  gtk_widget_set_name(GTK_WIDGET(menubar), "fast-user-switch-menubar");
-  g_signal_connect(menubar, "button-press-event", G_CALLBACK(menubar_press),
-                   NULL);
-  g_signal_connect_after(menubar, "draw", G_CALLBACK(menubar_on_draw), menubar);
-  g_signal_connect(applet, "change-orient",
-                   G_CALLBACK(matepanelapplet_reorient_cb), menubar);
-  gtk_container_set_border_width(GTK_CONTAINER(menubar), 0);
+  menubar = menubar_new(applet, mate_panel_applet_get_orient(applet),
+                        mate_panel_applet_get_size(applet), &indicators_loaded);
 
-  /* Add in filter func */
-  tomboy_keybinder_bind(hotkey_keycode, hotkey_filter, menubar);
-
-  load_modules(applet, menubar, &indicators_loaded);
-#if HAVE_AYATANA_INDICATOR_NG || HAVE_UBUNTU_INDICATOR_NG
-  load_indicators_from_indicator_files(applet, menubar, &indicators_loaded);
-#endif
+  action_group = gtk_action_group_new("Indicator Applet Actions");
+  gtk_action_group_set_translation_domain(action_group, GETTEXT_PACKAGE);
+  gtk_action_group_add_actions(action_group, menu_actions,
+                               G_N_ELEMENTS(menu_actions), NULL);
+  mate_panel_applet_setup_menu(applet, menu_xml, action_group);
+  g_object_unref(action_group);
 
   if (indicators_loaded == 0) {
+    /* Never shown, so it must not take hotkeys or control requests */
+    g_object_ref_sink(menubar);
+    gtk_widget_destroy(menubar);
+    g_object_unref(menubar);
+
     /* A label to allow for click through */
     GtkWidget *item = gtk_label_new(_("No Indicators"));
     mate_panel_applet_set_background_widget(applet, item);
     gtk_container_add(GTK_CONTAINER(applet), item);
     gtk_widget_show(item);
   } else {
+    g_signal_connect(applet, "change-orient",
+                     G_CALLBACK(matepanelapplet_reorient_cb), menubar);
     gtk_container_add(GTK_CONTAINER(applet), menubar);
     mate_panel_applet_set_background_widget(applet, menubar);
     gtk_widget_show(menubar);
@@ -1084,3 +3573,149 @@ static gboolean applet_fill_cb(MatePanelApplet *applet,
 
   return TRUE;
 }
+
+/*************
+ * Standalone host
+ * ***********/
+
+#ifdef INDICATOR_APPLET_STANDALONE
+
+/* Runs the menubar in a plain window so the applet can be profiled and
+   benchmarked without mate-panel.  Panel size and orient changes are
+   simulated from a list given on the command line. */
+
+static gint standalone_size = 24;
+static gchar *standalone_orient = NULL;
+static gchar *standalone_changes = NULL;
+static gint standalone_interval = 1000;
+static gint standalone_quit_after = 0;
+
+static const GOptionEntry standalone_options[] = {
+    {"size", 's', 0, G_OPTION_ARG_INT, &standalone_size,
+     "Panel size in pixels (default 24)", "PIXELS"},
+    {"orient", 'o', 0, G_OPTION_ARG_STRING, &standalone_orient,
+     "Panel orient: up, down, left or right (default down)", "ORIENT"},
+    {"changes", 'c', 0, G_OPTION_ARG_STRING, &standalone_changes,
+     "Comma separated sizes and orients to switch to, e.g. 48,left,24,down",
+     "LIST"},
+    {"interval", 'i', 0, G_OPTION_ARG_INT, &standalone_interval,
+     "Milliseconds between changes (default 1000)", "MS"},
+    {"quit-after", 'q', 0, G_OPTION_ARG_INT, &standalone_quit_after,
+     "Quit after this many seconds, 0 runs until the window is closed",
+     "SECONDS"},
+    {NULL}};
+
+typedef struct {
+  GtkWidget *menubar;
+  gchar **steps;
+  guint next;
+} standalone_changes_t;
+
+static gboolean parse_orient(const gchar *name,
+                             MatePanelAppletOrient *result) {
+  static const struct {
+    const gchar *name;
+    MatePanelAppletOrient orient;
+  } orients[] = {{"up", MATE_PANEL_APPLET_ORIENT_UP},
+                 {"down", MATE_PANEL_APPLET_ORIENT_DOWN},
+                 {"left", MATE_PANEL_APPLET_ORIENT_LEFT},
+                 {"right", MATE_PANEL_APPLET_ORIENT_RIGHT}};
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(orients); i++) {
+    if (g_ascii_strcasecmp(name, orients[i].name) == 0) {
+      *result = orients[i].orient;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static gboolean standalone_change_cb(gpointer data) {
+  standalone_changes_t *changes = (standalone_changes_t *)data;
+  const gchar *step = changes->steps[changes->next++];
+  MatePanelAppletOrient neworient;
+
+  if (changes->steps[changes->next] == NULL) {
+    changes->next = 0;
+  }
+
+  if (parse_orient(step, &neworient)) {
+    g_message("Standalone: orient %s", step);
+    matepanelapplet_reorient_cb(NULL, neworient, changes->menubar);
+  } else {
+    guint64 newsize = g_ascii_strtoull(step, NULL, 10);
+    if (newsize == 0) {
+      g_warning("Standalone: ignoring change '%s'", step);
+    } else {
+      g_message("Standalone: size %u", (guint)newsize);
+      /* What the panel's "change-size" signal does */
+      entry_resized(NULL, (guint)newsize, changes->menubar);
+    }
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean standalone_quit_cb(gpointer data G_GNUC_UNUSED) {
+  gtk_main_quit();
+  return G_SOURCE_REMOVE;
+}
+
+int main(int argc, char **argv) {
+  GOptionContext *context = g_option_context_new(NULL);
+  GError *error = NULL;
+
+  g_option_context_add_main_entries(context, standalone_options,
+                                    GETTEXT_PACKAGE);
+  g_option_context_add_group(context, gtk_get_option_group(TRUE));
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+
+  MatePanelAppletOrient orient = MATE_PANEL_APPLET_ORIENT_DOWN;
+  if (standalone_orient != NULL && !parse_orient(standalone_orient, &orient)) {
+    g_printerr("Unknown orient '%s'\n", standalone_orient);
+    return EXIT_FAILURE;
+  }
+  guint size = (standalone_size > 0) ? (guint)standalone_size : 24;
+  startup_begin = APPLET_TRACE_NOW();
+
+#if HAVE_AYATANA_INDICATOR_NG || HAVE_UBUNTU_INDICATOR_NG
+  APPLET_TRACE_BEGIN(trace_begin);
+  ido_init();
+  APPLET_TRACE_END(trace_begin, "ido_init", "%s", "standalone");
+#endif
+  applet_init_once();
+
+  gint indicators_loaded = 0;
+  GtkWidget *menubar = menubar_new(NULL, orient, size, &indicators_loaded);
+  g_message("Standalone: %d indicators loaded", indicators_loaded);
+
+  GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_title(GTK_WINDOW(window), g_get_application_name());
+  g_signal_connect(window, "destroy", G_CALLBACK(gtk_main_quit), NULL);
+  gtk_container_add(GTK_CONTAINER(window), menubar);
+  gtk_widget_show_all(window);
+
+  standalone_changes_t changes = {menubar, NULL, 0};
+  if (standalone_changes != NULL && *standalone_changes != '\0') {
+    changes.steps = g_strsplit(standalone_changes, ",", -1);
+    g_timeout_add(MAX(standalone_interval, 1), standalone_change_cb, &changes);
+  }
+  if (standalone_quit_after > 0) {
+    g_timeout_add_seconds(standalone_quit_after, standalone_quit_cb, NULL);
+  }
+
+  gtk_main();
+
+  g_strfreev(changes.steps);
+  return EXIT_SUCCESS;
+}
+
+#endif /* INDICATOR_APPLET_STANDALONE */
@@ -0,0 +1,201 @@
+/*
+Live counters, gauges and latencies of the applet process.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "applet-metrics.h"
+
+/* Everything here is only touched from the main thread */
+
+static const gchar *counter_names[APPLET_N_COUNTERS] = {
+    "entries-added",        "entries-removed",      "entries-moved",
+    "relayouts",            "draws",                "accessible-applied",
+    "accessible-unchanged", "accessible-coalesced", "log-messages",
+    "stalls",               "menus-prewarmed",      "submenus-attached",
+    "submenus-detached",    "scroll-events",        "scroll-emissions",
+    "wakeups",              "low-power-entered",    "low-power-wakeups",
+    "low-power-ms",         "low-power-updates",    "icon-lookups-missed"};
+
+static const gchar *gauge_names[APPLET_N_GAUGES] = {
+    "indicators", "entries", "log-queue-depth", "submenu-widgets",
+    "menubars"};
+
+static const gchar *latency_names[APPLET_N_LATENCIES] = {
+    "draw",            "hotkey",         "hotkey-dispatch",
+    "first-open-cold", "first-open-warm", "submenu-attach",
+    "icon-lookup",     "icon-decode"};
+
+static const gchar *handler_names[APPLET_N_HANDLERS] = {
+    "entry-added", "entry-removed", "entry-moved", "menu-show",
+    "accessible-desc-update"};
+
+static guint64 counters[APPLET_N_COUNTERS];
+static gint64 gauges[APPLET_N_GAUGES];
+static LatencyHistogram *latencies[APPLET_N_LATENCIES];
+
+/* Indicator object -> AppletIndicatorMetrics, and the same metrics in the
+   order the indicators were loaded */
+static GHashTable *indicators = NULL;
+static GPtrArray *indicators_ordered = NULL;
+
+/* Indicator entry -> number of menubars showing it */
+static GHashTable *entry_views = NULL;
+
+void applet_metrics_count(AppletCounter counter) {
+  g_return_if_fail(counter < APPLET_N_COUNTERS);
+  counters[counter]++;
+}
+
+void applet_metrics_count_add(AppletCounter counter, guint64 n) {
+  g_return_if_fail(counter < APPLET_N_COUNTERS);
+  counters[counter] += n;
+}
+
+guint64 applet_metrics_get_counter(AppletCounter counter) {
+  g_return_val_if_fail(counter < APPLET_N_COUNTERS, 0);
+  return counters[counter];
+}
+
+const gchar *applet_metrics_counter_name(AppletCounter counter) {
+  g_return_val_if_fail(counter < APPLET_N_COUNTERS, NULL);
+  return counter_names[counter];
+}
+
+void applet_metrics_gauge_add(AppletGauge gauge, gint64 delta) {
+  g_return_if_fail(gauge < APPLET_N_GAUGES);
+  gauges[gauge] += delta;
+}
+
+gint64 applet_metrics_get_gauge(AppletGauge gauge) {
+  g_return_val_if_fail(gauge < APPLET_N_GAUGES, 0);
+  return gauges[gauge];
+}
+
+const gchar *applet_metrics_gauge_name(AppletGauge gauge) {
+  g_return_val_if_fail(gauge < APPLET_N_GAUGES, NULL);
+  return gauge_names[gauge];
+}
+
+LatencyHistogram *applet_metrics_get_latency(AppletLatency latency) {
+  g_return_val_if_fail(latency < APPLET_N_LATENCIES, NULL);
+
+  if (latencies[latency] == NULL) {
+    latencies[latency] = latency_histogram_new();
+  }
+  return latencies[latency];
+}
+
+const gchar *applet_metrics_latency_name(AppletLatency latency) {
+  g_return_val_if_fail(latency < APPLET_N_LATENCIES, NULL);
+  return latency_names[latency];
+}
+
+const gchar *applet_metrics_handler_name(AppletHandler handler) {
+  g_return_val_if_fail(handler < APPLET_N_HANDLERS, NULL);
+  return handler_names[handler];
+}
+
+static void indicator_metrics_free(gpointer data) {
+  AppletIndicatorMetrics *metrics = (AppletIndicatorMetrics *)data;
+
+  g_free((gchar *)metrics->name);
+  g_free(metrics);
+}
+
+void applet_metrics_add_indicator(gconstpointer indicator, const gchar *name) {
+  g_return_if_fail(indicator != NULL);
+
+  if (indicators == NULL) {
+    indicators = g_hash_table_new(g_direct_hash, g_direct_equal);
+    indicators_ordered = g_ptr_array_new_with_free_func(indicator_metrics_free);
+  }
+
+  if (g_hash_table_contains(indicators, indicator)) {
+    return;
+  }
+
+  AppletIndicatorMetrics *metrics = g_new0(AppletIndicatorMetrics, 1);
+  metrics->name = g_strdup(name);
+  g_hash_table_insert(indicators, (gpointer)indicator, metrics);
+  g_ptr_array_add(indicators_ordered, metrics);
+
+  gauges[APPLET_GAUGE_INDICATORS]++;
+}
+
+static AppletIndicatorMetrics *lookup_indicator(gconstpointer indicator) {
+  if (indicators == NULL) {
+    return NULL;
+  }
+  return g_hash_table_lookup(indicators, indicator);
+}
+
+void applet_metrics_indicator_entry(gconstpointer indicator,
+                                    gconstpointer entry, gint delta) {
+  g_return_if_fail(entry != NULL);
+
+  if (entry_views == NULL) {
+    entry_views = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
+
+  gint views =
+      GPOINTER_TO_INT(g_hash_table_lookup(entry_views, entry)) + delta;
+  if (views > 0) {
+    g_hash_table_insert(entry_views, (gpointer)entry, GINT_TO_POINTER(views));
+    if (views != 1 || delta < 0) {
+      return;
+    }
+  } else {
+    g_hash_table_remove(entry_views, entry);
+    if (views < 0) {
+      return;
+    }
+  }
+
+  AppletIndicatorMetrics *metrics = lookup_indicator(indicator);
+  if (metrics != NULL) {
+    metrics->entries += delta;
+  }
+  gauges[APPLET_GAUGE_ENTRIES] += delta;
+}
+
+void applet_metrics_handler_time(gconstpointer indicator, AppletHandler handler,
+                                 gint64 usec) {
+  g_return_if_fail(handler < APPLET_N_HANDLERS);
+
+  AppletIndicatorMetrics *metrics = lookup_indicator(indicator);
+  if (metrics == NULL) {
+    return;
+  }
+
+  metrics->calls[handler]++;
+  metrics->total_usec[handler] += usec;
+  if (usec > metrics->max_usec[handler]) {
+    metrics->max_usec[handler] = usec;
+  }
+}
+
+void applet_metrics_foreach_indicator(AppletIndicatorMetricsFunc func,
+                                      gpointer user_data) {
+  guint i;
+
+  if (indicators_ordered == NULL) {
+    return;
+  }
+
+  for (i = 0; i < indicators_ordered->len; i++) {
+    func(g_ptr_array_index(indicators_ordered, i), user_data);
+  }
+}
@@ -0,0 +1,149 @@
+/*
+Live counters, gauges and latencies of the applet process.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __APPLET_METRICS_H__
+#define __APPLET_METRICS_H__
+
+#include <glib.h>
+
+#include "latency-histogram.h"
+
+G_BEGIN_DECLS
+
+/* Only ever increase */
+typedef enum {
+  APPLET_COUNTER_ENTRIES_ADDED,
+  APPLET_COUNTER_ENTRIES_REMOVED,
+  APPLET_COUNTER_ENTRIES_MOVED,
+  APPLET_COUNTER_RELAYOUTS,
+  APPLET_COUNTER_DRAWS,
+  APPLET_COUNTER_ACCESSIBLE_APPLIED,
+  APPLET_COUNTER_ACCESSIBLE_UNCHANGED,
+  APPLET_COUNTER_ACCESSIBLE_COALESCED,
+  APPLET_COUNTER_LOG_MESSAGES,
+  APPLET_COUNTER_STALLS,
+  APPLET_COUNTER_MENUS_PREWARMED,
+  APPLET_COUNTER_SUBMENUS_ATTACHED,
+  APPLET_COUNTER_SUBMENUS_DETACHED,
+  APPLET_COUNTER_SCROLL_EVENTS,
+  APPLET_COUNTER_SCROLL_EMISSIONS,
+  /* Returns from poll() on the main loop, counted while the watchdog runs */
+  APPLET_COUNTER_WAKEUPS,
+  /* Times every menubar was suspended at once, and the wakeups and
+     milliseconds spent like that up to the last resume */
+  APPLET_COUNTER_LOW_POWER_ENTERED,
+  APPLET_COUNTER_LOW_POWER_WAKEUPS,
+  APPLET_COUNTER_LOW_POWER_MS,
+  /* Entry updates that reached a suspended menubar */
+  APPLET_COUNTER_LOW_POWER_UPDATES,
+  /* Entry icons found in no theme nor in INDICATOR_ICONS_DIR, of those
+     looked up by icon_lookup() */
+  APPLET_COUNTER_ICON_LOOKUPS_MISSED,
+  APPLET_N_COUNTERS
+} AppletCounter;
+
+/* Current values */
+typedef enum {
+  APPLET_GAUGE_INDICATORS,
+  /* Each entry once, however many menubars show it */
+  APPLET_GAUGE_ENTRIES,
+  APPLET_GAUGE_LOG_QUEUE_DEPTH,
+  /* Widgets in the submenus attached to the menubar */
+  APPLET_GAUGE_SUBMENU_WIDGETS,
+  /* One per applet instance, all showing the same indicators */
+  APPLET_GAUGE_MENUBARS,
+  APPLET_N_GAUGES
+} AppletGauge;
+
+typedef enum {
+  APPLET_LATENCY_DRAW,
+  APPLET_LATENCY_HOTKEY,
+  /* From the hotkey thread receiving a press to the main loop dispatching
+     it, only with INDICATOR_APPLET_HOTKEY_THREAD */
+  APPLET_LATENCY_HOTKEY_DISPATCH,
+  /* From selecting an entry to its menu being mapped, the first time only,
+     for menus opened before and after they were pre-warmed */
+  APPLET_LATENCY_FIRST_OPEN_COLD,
+  APPLET_LATENCY_FIRST_OPEN_WARM,
+  /* Attaching a submenu, which propagates to every widget in it */
+  APPLET_LATENCY_SUBMENU_ATTACH,
+  /* Resolving an entry's icon name at the panel size, see icon_lookup() */
+  APPLET_LATENCY_ICON_LOOKUP,
+  /* From an icon change to its decoded surface being shown, see
+     icon_decode() */
+  APPLET_LATENCY_ICON_DECODE,
+  APPLET_N_LATENCIES
+} AppletLatency;
+
+/* The indicator signal handlers connected in load_indicator() */
+typedef enum {
+  APPLET_HANDLER_ENTRY_ADDED,
+  APPLET_HANDLER_ENTRY_REMOVED,
+  APPLET_HANDLER_ENTRY_MOVED,
+  APPLET_HANDLER_MENU_SHOW,
+  APPLET_HANDLER_ACCESSIBLE_DESC_UPDATE,
+  APPLET_N_HANDLERS
+} AppletHandler;
+
+typedef struct {
+  const gchar *name;
+  gint entries;
+  guint64 calls[APPLET_N_HANDLERS];
+  gint64 total_usec[APPLET_N_HANDLERS];
+  gint64 max_usec[APPLET_N_HANDLERS];
+} AppletIndicatorMetrics;
+
+typedef void (*AppletIndicatorMetricsFunc)(
+    const AppletIndicatorMetrics *metrics, gpointer user_data);
+
+void applet_metrics_count(AppletCounter counter);
+
+void applet_metrics_count_add(AppletCounter counter, guint64 n);
+
+guint64 applet_metrics_get_counter(AppletCounter counter);
+
+const gchar *applet_metrics_counter_name(AppletCounter counter);
+
+void applet_metrics_gauge_add(AppletGauge gauge, gint64 delta);
+
+gint64 applet_metrics_get_gauge(AppletGauge gauge);
+
+const gchar *applet_metrics_gauge_name(AppletGauge gauge);
+
+LatencyHistogram *applet_metrics_get_latency(AppletLatency latency);
+
+const gchar *applet_metrics_latency_name(AppletLatency latency);
+
+const gchar *applet_metrics_handler_name(AppletHandler handler);
+
+void applet_metrics_add_indicator(gconstpointer indicator, const gchar *name);
+
+/* Called with 1 or -1 as each menubar adds or removes a view of the entry,
+   only the first and last views change the counts */
+void applet_metrics_indicator_entry(gconstpointer indicator,
+                                    gconstpointer entry, gint delta);
+
+void applet_metrics_handler_time(gconstpointer indicator, AppletHandler handler,
+                                 gint64 usec);
+
+void applet_metrics_foreach_indicator(AppletIndicatorMetricsFunc func,
+                                      gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __APPLET_METRICS_H__ */
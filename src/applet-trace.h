@@ -0,0 +1,55 @@
+/*
+Sysprof capture marks for the applet's startup phases.
+
+Built with --enable-sysprof the marks below show up in a sysprof capture
+under the "indicator-applet" group.  Otherwise they expand to nothing and
+their arguments are never evaluated.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __APPLET_TRACE_H__
+#define __APPLET_TRACE_H__
+
+#include <glib.h>
+
+#ifdef HAVE_SYSPROF
+
+#include <sysprof-capture.h>
+
+#define APPLET_TRACE_GROUP "indicator-applet"
+
+/* Current time on the capture's clock */
+#define APPLET_TRACE_NOW() SYSPROF_CAPTURE_CURRENT_TIME
+
+/* Starts a span, declaring begin as its start time */
+#define APPLET_TRACE_BEGIN(begin) \
+  const gint64 begin = SYSPROF_CAPTURE_CURRENT_TIME
+
+/* Ends a span started at begin, the message is printf style */
+#define APPLET_TRACE_END(begin, mark, ...)                              \
+  sysprof_collector_mark_printf((begin),                                \
+                                SYSPROF_CAPTURE_CURRENT_TIME - (begin), \
+                                APPLET_TRACE_GROUP, (mark), __VA_ARGS__)
+
+#else
+
+#define APPLET_TRACE_NOW() G_GINT64_CONSTANT(0)
+#define APPLET_TRACE_BEGIN(begin) G_STMT_START {} G_STMT_END
+#define APPLET_TRACE_END(begin, mark, ...) G_STMT_START {} G_STMT_END
+
+#endif /* HAVE_SYSPROF */
+
+#endif /* __APPLET_TRACE_H__ */
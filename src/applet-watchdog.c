@@ -0,0 +1,352 @@
+/*
+Main loop watchdog that blames stalls on the indicator that caused them.
+
+The default context's poll function is wrapped so the watchdog thread
+knows when the main thread left poll() to dispatch.  It sleeps while the
+main loop is idle and wakes up threshold after a dispatch began; if that
+dispatch is still running the stack of the main thread is sampled and
+the stall is reported from the main loop once it is over.
+
+A stall is blamed on the indicator whose signal the applet was handling,
+see applet_watchdog_enter(), and otherwise on the indicator module with
+a frame in the stack sample.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <config.h>
+
+#include "applet-watchdog.h"
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#ifdef HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
+
+#include "applet-metrics.h"
+
+#define MAX_FRAMES 64
+
+/* How long to wait for the main thread to take its stack sample */
+#define SAMPLE_TIMEOUT_USEC (100 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct {
+  gchar *name;
+  gchar *module_path;
+  AppletWatchdogQuarantineFunc quarantine;
+  gpointer user_data;
+  gpointer indicator;
+  guint stalls;
+  gboolean quarantined;
+} watched_indicator_t;
+
+typedef struct {
+  gint64 begin;
+  gint64 end;
+  watched_indicator_t *scope;
+  void *frames[MAX_FRAMES];
+  gint n_frames;
+} stall_t;
+
+static gint64 threshold = 0;
+static guint quarantine_after = 0;
+
+/* Indicator object -> watched_indicator_t, only used on the main thread.
+   The records are never freed so the watchdog thread may hold on to
+   current_scope. */
+static GHashTable *indicators = NULL;
+static watched_indicator_t *current_scope = NULL;
+
+static GPollFunc default_poll = NULL;
+static pthread_t main_thread;
+
+static struct {
+  /* Protects the fields below */
+  GMutex lock;
+  GCond cond;
+  gboolean in_poll;
+  gint64 busy_since;
+  guint64 busy_serial;
+  /* Set while a stall is being sampled or waited out */
+  gboolean stalled;
+} state;
+
+#ifdef HAVE_EXECINFO_H
+static void *sample_frames[MAX_FRAMES];
+static volatile gint sample_depth = 0;
+static volatile gint sample_ready = 0;
+
+static void sample_handler(int signo G_GNUC_UNUSED) {
+  sample_depth = backtrace(sample_frames, MAX_FRAMES);
+  g_atomic_int_set(&sample_ready, 1);
+}
+#endif
+
+static void sample_main_thread(stall_t *stall) {
+#ifdef HAVE_EXECINFO_H
+  g_atomic_int_set(&sample_ready, 0);
+  if (pthread_kill(main_thread, SIGRTMIN) != 0) {
+    return;
+  }
+
+  const gint64 deadline = g_get_monotonic_time() + SAMPLE_TIMEOUT_USEC;
+  while (!g_atomic_int_get(&sample_ready)) {
+    if (g_get_monotonic_time() > deadline) {
+      return;
+    }
+    g_usleep(G_TIME_SPAN_MILLISECOND);
+  }
+
+  stall->n_frames = sample_depth;
+  memcpy(stall->frames, sample_frames, stall->n_frames * sizeof(void *));
+#endif
+}
+
+static watched_indicator_t *blame_module(const stall_t *stall) {
+  GHashTableIter iter;
+  gpointer value;
+  gint i;
+
+  for (i = 0; i < stall->n_frames; i++) {
+    Dl_info info;
+
+    if (dladdr(stall->frames[i], &info) == 0 || info.dli_fname == NULL) {
+      continue;
+    }
+
+    g_hash_table_iter_init(&iter, indicators);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+      watched_indicator_t *watched = (watched_indicator_t *)value;
+      if (g_strcmp0(watched->module_path, info.dli_fname) == 0) {
+        return watched;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static gchar *format_frames(const stall_t *stall) {
+  GString *str = g_string_new(NULL);
+  gint i;
+
+  for (i = 0; i < stall->n_frames; i++) {
+    Dl_info info = {0};
+
+    if (dladdr(stall->frames[i], &info) == 0) {
+      g_string_append_printf(str, "\n  #%d %p", i, stall->frames[i]);
+    } else if (info.dli_sname != NULL) {
+      g_string_append_printf(
+          str, "\n  #%d %s+0x%tx (%s)", i, info.dli_sname,
+          (gchar *)stall->frames[i] - (gchar *)info.dli_saddr, info.dli_fname);
+    } else {
+      g_string_append_printf(str, "\n  #%d %p (%s)", i, stall->frames[i],
+                             info.dli_fname);
+    }
+  }
+
+  return g_string_free(str, FALSE);
+}
+
+static gboolean report_stall_cb(gpointer data) {
+  stall_t *stall = (stall_t *)data;
+  watched_indicator_t *watched = stall->scope;
+
+  if (watched == NULL) {
+    watched = blame_module(stall);
+  }
+
+  applet_metrics_count(APPLET_COUNTER_STALLS);
+
+  gchar *frames = format_frames(stall);
+  g_warning("Main loop stalled for %" G_GINT64_FORMAT " ms in %s%s",
+            (stall->end - stall->begin) / G_TIME_SPAN_MILLISECOND,
+            watched != NULL ? watched->name : "an unknown place", frames);
+  g_free(frames);
+
+  if (watched != NULL) {
+    watched->stalls++;
+
+    if (quarantine_after > 0 && watched->stalls >= quarantine_after &&
+        !watched->quarantined && watched->quarantine != NULL) {
+      g_warning("Quarantining indicator '%s' after %u stalls", watched->name,
+                watched->stalls);
+      watched->quarantined = TRUE;
+      watched->quarantine(watched->indicator, watched->user_data);
+    }
+  }
+
+  g_free(stall);
+  return G_SOURCE_REMOVE;
+}
+
+static gpointer watchdog_thread_func(gpointer data G_GNUC_UNUSED) {
+  g_mutex_lock(&state.lock);
+
+  while (TRUE) {
+    while (state.in_poll) {
+      g_cond_wait(&state.cond, &state.lock);
+    }
+
+    const guint64 serial = state.busy_serial;
+    const gint64 deadline = state.busy_since + threshold;
+    gboolean timed_out = FALSE;
+
+    while (!state.in_poll && state.busy_serial == serial && !timed_out) {
+      timed_out = !g_cond_wait_until(&state.cond, &state.lock, deadline);
+    }
+    if (state.in_poll || state.busy_serial != serial) {
+      continue;
+    }
+
+    /* Still in the same dispatch, sample it without holding up the main
+       thread should it return to poll() meanwhile */
+    stall_t *stall = g_new0(stall_t, 1);
+    stall->begin = state.busy_since;
+    stall->scope = g_atomic_pointer_get(&current_scope);
+    state.stalled = TRUE;
+    g_mutex_unlock(&state.lock);
+
+    sample_main_thread(stall);
+
+    g_mutex_lock(&state.lock);
+    while (!state.in_poll && state.busy_serial == serial) {
+      g_cond_wait(&state.cond, &state.lock);
+    }
+    state.stalled = FALSE;
+    stall->end = g_get_monotonic_time();
+
+    /* Attaching from this thread wakes the main loop up */
+    GSource *source = g_idle_source_new();
+    g_source_set_callback(source, report_stall_cb, stall, NULL);
+    g_source_attach(source, g_main_context_default());
+    g_source_unref(source);
+  }
+
+  g_mutex_unlock(&state.lock);
+  return NULL;
+}
+
+static gint watchdog_poll(GPollFD *fds, guint nfds, gint timeout) {
+  g_mutex_lock(&state.lock);
+  state.in_poll = TRUE;
+  if (state.stalled) {
+    g_cond_signal(&state.cond);
+  }
+  g_mutex_unlock(&state.lock);
+
+  gint ret = default_poll(fds, nfds, timeout);
+  applet_metrics_count(APPLET_COUNTER_WAKEUPS);
+
+  g_mutex_lock(&state.lock);
+  state.in_poll = FALSE;
+  state.busy_since = g_get_monotonic_time();
+  state.busy_serial++;
+  g_cond_signal(&state.cond);
+  g_mutex_unlock(&state.lock);
+
+  return ret;
+}
+
+void applet_watchdog_start(guint threshold_ms, guint quarantine) {
+  GMainContext *context = g_main_context_default();
+  GError *error = NULL;
+
+  g_return_if_fail(threshold_ms > 0);
+
+  if (default_poll != NULL) {
+    return;
+  }
+
+  threshold = threshold_ms * G_TIME_SPAN_MILLISECOND;
+  quarantine_after = quarantine;
+  main_thread = pthread_self();
+
+  if (indicators == NULL) {
+    indicators = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
+
+#ifdef HAVE_EXECINFO_H
+  /* The first backtrace() may load libgcc, which is not something to do
+     from a signal handler */
+  backtrace(sample_frames, 1);
+
+  struct sigaction action = {0};
+  action.sa_handler = sample_handler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGRTMIN, &action, NULL);
+#endif
+
+  g_mutex_init(&state.lock);
+  g_cond_init(&state.cond);
+  state.busy_since = g_get_monotonic_time();
+
+  default_poll = g_main_context_get_poll_func(context);
+  g_main_context_set_poll_func(context, watchdog_poll);
+
+  GThread *thread =
+      g_thread_try_new("watchdog", watchdog_thread_func, NULL, &error);
+  if (thread == NULL) {
+    g_warning("Unable to start the watchdog thread: %s", error->message);
+    g_error_free(error);
+    g_main_context_set_poll_func(context, default_poll);
+    return;
+  }
+  g_thread_unref(thread);
+}
+
+void applet_watchdog_add_indicator(gpointer indicator, const gchar *name,
+                                   const gchar *module_path,
+                                   AppletWatchdogQuarantineFunc quarantine,
+                                   gpointer user_data) {
+  g_return_if_fail(indicator != NULL);
+
+  if (indicators == NULL) {
+    indicators = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
+
+  if (g_hash_table_contains(indicators, indicator)) {
+    return;
+  }
+
+  watched_indicator_t *watched = g_new0(watched_indicator_t, 1);
+  watched->name = g_strdup(name);
+  watched->module_path = g_strdup(module_path);
+  watched->quarantine = quarantine;
+  watched->user_data = user_data;
+  watched->indicator = indicator;
+  g_hash_table_insert(indicators, indicator, watched);
+}
+
+gpointer applet_watchdog_enter(gpointer indicator) {
+  watched_indicator_t *previous = current_scope;
+
+  if (indicators != NULL) {
+    g_atomic_pointer_set(&current_scope,
+                         g_hash_table_lookup(indicators, indicator));
+  }
+
+  return previous;
+}
+
+void applet_watchdog_leave(gpointer previous) {
+  g_atomic_pointer_set(&current_scope, previous);
+}
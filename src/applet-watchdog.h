@@ -0,0 +1,51 @@
+/*
+Main loop watchdog that blames stalls on the indicator that caused them.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __APPLET_WATCHDOG_H__
+#define __APPLET_WATCHDOG_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Called on the main loop once an indicator stalled it quarantine_after
+   times, it should stop listening to the indicator and hide it */
+typedef void (*AppletWatchdogQuarantineFunc)(gpointer indicator,
+                                             gpointer user_data);
+
+/* Must be called from the main thread.  A dispatch of the default main
+   context that takes longer than threshold_ms is reported as a stall,
+   quarantine_after is 0 to never quarantine. */
+void applet_watchdog_start(guint threshold_ms, guint quarantine_after);
+
+/* module_path is the file the indicator was loaded from, or NULL when it
+   does not have its own module */
+void applet_watchdog_add_indicator(gpointer indicator, const gchar *name,
+                                   const gchar *module_path,
+                                   AppletWatchdogQuarantineFunc quarantine,
+                                   gpointer user_data);
+
+/* Stalls until the matching applet_watchdog_leave() are blamed on
+   indicator.  Returns the scope to hand back to applet_watchdog_leave(). */
+gpointer applet_watchdog_enter(gpointer indicator);
+
+void applet_watchdog_leave(gpointer previous);
+
+G_END_DECLS
+
+#endif /* __APPLET_WATCHDOG_H__ */
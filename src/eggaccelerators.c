@@ -38,95 +38,110 @@ enum {
 
 #define MODMAP_ENTRY_TO_MODIFIER(x) (1 << (x))
 
+/* Virtual modifiers live in bits 0-7 and 24-29, concrete ones in bits 0-7 */
+#define VIRTUAL_LO_BITS 8
+#define VIRTUAL_HI_SHIFT 24
+#define VIRTUAL_HI_BITS 6
+
 typedef struct {
   EggVirtualModifierType mapping[EGG_MODMAP_ENTRY_LAST];
 
+  /* Lookup tables derived from mapping, indexed by modifier bit patterns */
+  guint to_concrete_lo[1 << VIRTUAL_LO_BITS];
+  guint to_concrete_hi[1 << VIRTUAL_HI_BITS];
+  guint to_virtual[1 << EGG_MODMAP_ENTRY_LAST];
+
+  /* Value of keymap_generation when this modmap was built */
+  guint generation;
 } EggModmap;
 
+/* Bumped whenever a keymap reports a change; modmaps built for an older
+ * generation are reloaded the next time they are asked for.
+ */
+static guint keymap_generation = 1;
+
 const EggModmap *egg_keymap_get_modmap(GdkKeymap *keymap);
 
-static inline gboolean is_alt(const gchar *string) {
-  return ((string[0] == '<') && (string[1] == 'a' || string[1] == 'A') &&
-          (string[2] == 'l' || string[2] == 'L') &&
-          (string[3] == 't' || string[3] == 'T') && (string[4] == '>'));
-}
+/* Modifier tokens, looked up by a perfect hash of their length and their
+ * first and last characters (case folded), which has no collisions for
+ * this set.  Unknown tokens may share a slot, so the token is compared
+ * once the slot is found.
+ */
+#define MODIFIER_HASH(len, first, last) \
+  (((len) + g_ascii_tolower(first) + g_ascii_tolower(last) * 23) & 31)
 
-static inline gboolean is_ctl(const gchar *string) {
-  return ((string[0] == '<') && (string[1] == 'c' || string[1] == 'C') &&
-          (string[2] == 't' || string[2] == 'T') &&
-          (string[3] == 'l' || string[3] == 'L') && (string[4] == '>'));
-}
+typedef struct {
+  const gchar *name;
+  gsize len;
+  EggVirtualModifierType mask;
+} ModifierToken;
+
+static const ModifierToken modifier_tokens[32] = {
+    [3] = {"shft", 4, EGG_VIRTUAL_SHIFT_MASK},
+    [4] = {"shift", 5, EGG_VIRTUAL_SHIFT_MASK},
+    [6] = {"mod3", 4, EGG_VIRTUAL_MOD3_MASK},
+    [8] = {"meta", 4, EGG_VIRTUAL_META_MASK},
+    [11] = {"hyper", 5, EGG_VIRTUAL_HYPER_MASK},
+    [12] = {"release", 7, EGG_VIRTUAL_RELEASE_MASK},
+    [15] = {"mod2", 4, EGG_VIRTUAL_MOD2_MASK},
+    [16] = {"alt", 3, EGG_VIRTUAL_ALT_MASK},
+    [20] = {"mod5", 4, EGG_VIRTUAL_MOD5_MASK},
+    [22] = {"super", 5, EGG_VIRTUAL_SUPER_MASK},
+    [24] = {"mod1", 4, EGG_VIRTUAL_ALT_MASK},
+    [26] = {"ctl", 3, EGG_VIRTUAL_CONTROL_MASK},
+    [27] = {"ctrl", 4, EGG_VIRTUAL_CONTROL_MASK},
+    [29] = {"mod4", 4, EGG_VIRTUAL_MOD4_MASK},
+    [30] = {"control", 7, EGG_VIRTUAL_CONTROL_MASK},
+};
 
-static inline gboolean is_modx(const gchar *string) {
-  return ((string[0] == '<') && (string[1] == 'm' || string[1] == 'M') &&
-          (string[2] == 'o' || string[2] == 'O') &&
-          (string[3] == 'd' || string[3] == 'D') &&
-          (string[4] >= '1' && string[4] <= '5') && (string[5] == '>'));
-}
+/* Returns the mask of the modifier named by the @len characters at
+ * @token, or 0 for tokens we don't know about.
+ */
+static inline EggVirtualModifierType lookup_modifier(const gchar *token,
+                                                     gsize len) {
+  const ModifierToken *entry;
 
-static inline gboolean is_ctrl(const gchar *string) {
-  return ((string[0] == '<') && (string[1] == 'c' || string[1] == 'C') &&
-          (string[2] == 't' || string[2] == 'T') &&
-          (string[3] == 'r' || string[3] == 'R') &&
-          (string[4] == 'l' || string[4] == 'L') && (string[5] == '>'));
-}
+  if (len == 0) return 0;
 
-static inline gboolean is_shft(const gchar *string) {
-  return ((string[0] == '<') && (string[1] == 's' || string[1] == 'S') &&
-          (string[2] == 'h' || string[2] == 'H') &&
-          (string[3] == 'f' || string[3] == 'F') &&
-          (string[4] == 't' || string[4] == 'T') && (string[5] == '>'));
-}
+  entry = &modifier_tokens[MODIFIER_HASH(len, token[0], token[len - 1])];
+  if (entry->len != len || g_ascii_strncasecmp(token, entry->name, len) != 0)
+    return 0;
 
-static inline gboolean is_shift(const gchar *string) {
-  return ((string[0] == '<') && (string[1] == 's' || string[1] == 'S') &&
-          (string[2] == 'h' || string[2] == 'H') &&
-          (string[3] == 'i' || string[3] == 'I') &&
-          (string[4] == 'f' || string[4] == 'F') &&
-          (string[5] == 't' || string[5] == 'T') && (string[6] == '>'));
+  return entry->mask;
 }
 
-static inline gboolean is_control(const gchar *string) {
-  return ((string[0] == '<') && (string[1] == 'c' || string[1] == 'C') &&
-          (string[2] == 'o' || string[2] == 'O') &&
-          (string[3] == 'n' || string[3] == 'N') &&
-          (string[4] == 't' || string[4] == 'T') &&
-          (string[5] == 'r' || string[5] == 'R') &&
-          (string[6] == 'o' || string[6] == 'O') &&
-          (string[7] == 'l' || string[7] == 'L') && (string[8] == '>'));
-}
+/* Accelerators get parsed again every time the keymap changes, and the
+ * name lookup is by far the slowest part, so remember what names map to.
+ */
+#define KEYVAL_CACHE_MAX 256
 
-static inline gboolean is_release(const gchar *string) {
-  return ((string[0] == '<') && (string[1] == 'r' || string[1] == 'R') &&
-          (string[2] == 'e' || string[2] == 'E') &&
-          (string[3] == 'l' || string[3] == 'L') &&
-          (string[4] == 'e' || string[4] == 'E') &&
-          (string[5] == 'a' || string[5] == 'A') &&
-          (string[6] == 's' || string[6] == 'S') &&
-          (string[7] == 'e' || string[7] == 'E') && (string[8] == '>'));
-}
+G_LOCK_DEFINE_STATIC(keyval_cache);
+static GHashTable *keyval_cache = NULL;
 
-static inline gboolean is_meta(const gchar *string) {
-  return ((string[0] == '<') && (string[1] == 'm' || string[1] == 'M') &&
-          (string[2] == 'e' || string[2] == 'E') &&
-          (string[3] == 't' || string[3] == 'T') &&
-          (string[4] == 'a' || string[4] == 'A') && (string[5] == '>'));
-}
+static guint keyval_from_name_cached(const gchar *name) {
+  gpointer cached;
+  guint keyval;
 
-static inline gboolean is_super(const gchar *string) {
-  return ((string[0] == '<') && (string[1] == 's' || string[1] == 'S') &&
-          (string[2] == 'u' || string[2] == 'U') &&
-          (string[3] == 'p' || string[3] == 'P') &&
-          (string[4] == 'e' || string[4] == 'E') &&
-          (string[5] == 'r' || string[5] == 'R') && (string[6] == '>'));
-}
+  G_LOCK(keyval_cache);
+  if (keyval_cache != NULL &&
+      g_hash_table_lookup_extended(keyval_cache, name, NULL, &cached)) {
+    G_UNLOCK(keyval_cache);
+    return GPOINTER_TO_UINT(cached);
+  }
+  G_UNLOCK(keyval_cache);
 
-static inline gboolean is_hyper(const gchar *string) {
-  return ((string[0] == '<') && (string[1] == 'h' || string[1] == 'H') &&
-          (string[2] == 'y' || string[2] == 'Y') &&
-          (string[3] == 'p' || string[3] == 'P') &&
-          (string[4] == 'e' || string[4] == 'E') &&
-          (string[5] == 'r' || string[5] == 'R') && (string[6] == '>'));
+  keyval = gdk_keyval_from_name(name);
+
+  G_LOCK(keyval_cache);
+  if (keyval_cache == NULL) {
+    keyval_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  } else if (g_hash_table_size(keyval_cache) >= KEYVAL_CACHE_MAX) {
+    g_hash_table_remove_all(keyval_cache);
+  }
+  g_hash_table_insert(keyval_cache, g_strdup(name), GUINT_TO_POINTER(keyval));
+  G_UNLOCK(keyval_cache);
+
+  return keyval;
 }
 
 /**
@@ -159,7 +174,6 @@ gboolean egg_accelerator_parse_virtual(
     EggVirtualModifierType *accelerator_mods) {
   guint keyval;
   GdkModifierType mods;
-  gint len;
   gboolean bad_keyval;
 
   if (accelerator_key) *accelerator_key = 0;
@@ -171,76 +185,24 @@ gboolean egg_accelerator_parse_virtual(
 
   keyval = 0;
   mods = 0;
-  len = strlen(accelerator);
-  while (len) {
-    if (*accelerator == '<') {
-      if (len >= 9 && is_release(accelerator)) {
-        accelerator += 9;
-        len -= 9;
-        mods |= EGG_VIRTUAL_RELEASE_MASK;
-      } else if (len >= 9 && is_control(accelerator)) {
-        accelerator += 9;
-        len -= 9;
-        mods |= EGG_VIRTUAL_CONTROL_MASK;
-      } else if (len >= 7 && is_shift(accelerator)) {
-        accelerator += 7;
-        len -= 7;
-        mods |= EGG_VIRTUAL_SHIFT_MASK;
-      } else if (len >= 6 && is_shft(accelerator)) {
-        accelerator += 6;
-        len -= 6;
-        mods |= EGG_VIRTUAL_SHIFT_MASK;
-      } else if (len >= 6 && is_ctrl(accelerator)) {
-        accelerator += 6;
-        len -= 6;
-        mods |= EGG_VIRTUAL_CONTROL_MASK;
-      } else if (len >= 6 && is_modx(accelerator)) {
-        static const guint mod_vals[] = {
-            EGG_VIRTUAL_ALT_MASK, EGG_VIRTUAL_MOD2_MASK, EGG_VIRTUAL_MOD3_MASK,
-            EGG_VIRTUAL_MOD4_MASK, EGG_VIRTUAL_MOD5_MASK};
-
-        len -= 6;
-        accelerator += 4;
-        mods |= mod_vals[*accelerator - '1'];
-        accelerator += 2;
-      } else if (len >= 5 && is_ctl(accelerator)) {
-        accelerator += 5;
-        len -= 5;
-        mods |= EGG_VIRTUAL_CONTROL_MASK;
-      } else if (len >= 5 && is_alt(accelerator)) {
-        accelerator += 5;
-        len -= 5;
-        mods |= EGG_VIRTUAL_ALT_MASK;
-      } else if (len >= 6 && is_meta(accelerator)) {
-        accelerator += 6;
-        len -= 6;
-        mods |= EGG_VIRTUAL_META_MASK;
-      } else if (len >= 7 && is_hyper(accelerator)) {
-        accelerator += 7;
-        len -= 7;
-        mods |= EGG_VIRTUAL_HYPER_MASK;
-      } else if (len >= 7 && is_super(accelerator)) {
-        accelerator += 7;
-        len -= 7;
-        mods |= EGG_VIRTUAL_SUPER_MASK;
-      } else {
-        gchar last_ch;
-
-        last_ch = *accelerator;
-        while (last_ch && last_ch != '>') {
-          last_ch = *accelerator;
-          accelerator += 1;
-          len -= 1;
-        }
-      }
-    } else {
-      keyval = gdk_keyval_from_name(accelerator);
-
-      if (keyval == 0) bad_keyval = TRUE;
-
-      accelerator += len;
-      len = 0;
+  while (*accelerator == '<') {
+    const gchar *close = strchr(accelerator + 1, '>');
+
+    if (close == NULL) {
+      /* Unterminated modifier, there can't be a key after it */
+      bad_keyval = TRUE;
+      break;
     }
+
+    /* Unknown modifiers are skipped */
+    mods |= lookup_modifier(accelerator + 1, close - accelerator - 1);
+    accelerator = close + 1;
+  }
+
+  if (!bad_keyval && *accelerator != '\0') {
+    keyval = keyval_from_name_cached(accelerator);
+
+    if (keyval == 0) bad_keyval = TRUE;
   }
 
   if (accelerator_key) *accelerator_key = gdk_keyval_to_lower(keyval);
@@ -252,8 +214,6 @@ gboolean egg_accelerator_parse_virtual(
 void egg_keymap_resolve_virtual_modifiers(GdkKeymap *keymap,
                                           EggVirtualModifierType virtual_mods,
                                           GdkModifierType *concrete_mods) {
-  GdkModifierType concrete;
-  int i;
   const EggModmap *modmap;
 
   g_return_if_fail(GDK_IS_KEYMAP(keymap));
@@ -261,24 +221,15 @@ void egg_keymap_resolve_virtual_modifiers(GdkKeymap *keymap,
 
   modmap = egg_keymap_get_modmap(keymap);
 
-  /* Not so sure about this algorithm. */
-
-  concrete = 0;
-  i = 0;
-  while (i < EGG_MODMAP_ENTRY_LAST) {
-    if (modmap->mapping[i] & virtual_mods) concrete |= (1 << i);
-
-    ++i;
-  }
-
-  *concrete_mods = concrete;
+  *concrete_mods =
+      modmap->to_concrete_lo[virtual_mods & ((1 << VIRTUAL_LO_BITS) - 1)] |
+      modmap->to_concrete_hi[(virtual_mods >> VIRTUAL_HI_SHIFT) &
+                             ((1 << VIRTUAL_HI_BITS) - 1)];
 }
 
 void egg_keymap_virtualize_modifiers(GdkKeymap *keymap,
                                      GdkModifierType concrete_mods,
                                      EggVirtualModifierType *virtual_mods) {
-  GdkModifierType virtual;
-  int i;
   const EggModmap *modmap;
 
   g_return_if_fail(GDK_IS_KEYMAP(keymap));
@@ -286,41 +237,92 @@ void egg_keymap_virtualize_modifiers(GdkKeymap *keymap,
 
   modmap = egg_keymap_get_modmap(keymap);
 
-  /* Not so sure about this algorithm. */
-
-  virtual = 0;
-  i = 0;
-  while (i < EGG_MODMAP_ENTRY_LAST) {
-    if ((1 << i) & concrete_mods) {
-      EggVirtualModifierType cleaned;
-
-      cleaned =
-          modmap->mapping[i] & ~(EGG_VIRTUAL_MOD2_MASK | EGG_VIRTUAL_MOD3_MASK |
-                                 EGG_VIRTUAL_MOD4_MASK | EGG_VIRTUAL_MOD5_MASK);
-
-      if (cleaned != 0) {
-        virtual |= cleaned;
-      } else {
-        /* Rather than dropping mod2->mod5 if not bound,
-         * go ahead and use the concrete names
-         */
-        virtual |= modmap->mapping[i];
-      }
+  *virtual_mods =
+      modmap->to_virtual[concrete_mods & ((1 << EGG_MODMAP_ENTRY_LAST) - 1)];
+}
+
+/* Fills a table indexed by a bit pattern with the union of the per-bit
+ * values, each pattern reusing the entry for itself minus its lowest bit.
+ */
+static void fill_lookup_table(guint *table, guint n_bits,
+                              const guint *per_bit) {
+  guint pattern;
+
+  table[0] = 0;
+  for (pattern = 1; pattern < (1u << n_bits); pattern++) {
+    guint lowest = g_bit_nth_lsf(pattern, -1);
+
+    table[pattern] = table[pattern & (pattern - 1)] | per_bit[lowest];
+  }
+}
+
+static void build_lookup_tables(EggModmap *modmap) {
+  guint concrete_lo[VIRTUAL_LO_BITS] = {0};
+  guint concrete_hi[VIRTUAL_HI_BITS] = {0};
+  guint virtual[EGG_MODMAP_ENTRY_LAST];
+  int i, bit;
+
+  for (i = 0; i < EGG_MODMAP_ENTRY_LAST; i++) {
+    EggVirtualModifierType cleaned;
+
+    /* Which concrete modifiers each virtual bit resolves to */
+    for (bit = 0; bit < VIRTUAL_LO_BITS; bit++) {
+      if (modmap->mapping[i] & (1 << bit)) concrete_lo[bit] |= (1 << i);
+    }
+    for (bit = 0; bit < VIRTUAL_HI_BITS; bit++) {
+      if (modmap->mapping[i] & (1 << (bit + VIRTUAL_HI_SHIFT)))
+        concrete_hi[bit] |= (1 << i);
     }
 
-    ++i;
+    /* Not so sure about this algorithm. */
+    cleaned =
+        modmap->mapping[i] & ~(EGG_VIRTUAL_MOD2_MASK | EGG_VIRTUAL_MOD3_MASK |
+                               EGG_VIRTUAL_MOD4_MASK | EGG_VIRTUAL_MOD5_MASK);
+
+    /* Rather than dropping mod2->mod5 if not bound,
+     * go ahead and use the concrete names
+     */
+    virtual[i] = (cleaned != 0) ? cleaned : modmap->mapping[i];
   }
 
-  *virtual_mods = virtual;
+  fill_lookup_table(modmap->to_concrete_lo, VIRTUAL_LO_BITS, concrete_lo);
+  fill_lookup_table(modmap->to_concrete_hi, VIRTUAL_HI_BITS, concrete_hi);
+  fill_lookup_table(modmap->to_virtual, EGG_MODMAP_ENTRY_LAST, virtual);
+}
+
+static EggVirtualModifierType keysym_to_virtual_mask(KeySym keysym) {
+  switch (keysym) {
+    case GDK_KEY_Num_Lock:
+      return EGG_VIRTUAL_NUM_LOCK_MASK;
+    case GDK_KEY_Scroll_Lock:
+      return EGG_VIRTUAL_SCROLL_LOCK_MASK;
+    case GDK_KEY_Meta_L:
+    case GDK_KEY_Meta_R:
+      return EGG_VIRTUAL_META_MASK;
+    case GDK_KEY_Hyper_L:
+    case GDK_KEY_Hyper_R:
+      return EGG_VIRTUAL_HYPER_MASK;
+    case GDK_KEY_Super_L:
+    case GDK_KEY_Super_R:
+      return EGG_VIRTUAL_SUPER_MASK;
+    case GDK_KEY_Mode_switch:
+      return EGG_VIRTUAL_MODE_SWITCH_MASK;
+    default:
+      return 0;
+  }
 }
 
 static void reload_modmap(GdkKeymap *keymap, EggModmap *modmap) {
+  Display *xdisplay;
   XModifierKeymap *xmodmap;
+  KeySym *keysyms;
+  int keysyms_per_keycode;
+  int min_keycode, max_keycode;
   int map_size;
-  int i;
+  int i, j;
 
-  /* FIXME multihead */
-  xmodmap = XGetModifierMapping(gdk_x11_get_default_xdisplay());
+  xdisplay = GDK_DISPLAY_XDISPLAY(gdk_keymap_get_display(keymap));
+  xmodmap = XGetModifierMapping(xdisplay);
 
   memset(modmap->mapping, 0, sizeof(modmap->mapping));
 
@@ -328,42 +330,44 @@ static void reload_modmap(GdkKeymap *keymap, EggModmap *modmap) {
    * and control
    */
   map_size = 8 * xmodmap->max_keypermod;
-  i = 3 * xmodmap->max_keypermod;
-  while (i < map_size) {
+
+  /* Find the keycode range the interesting modifiers use, so their
+   * keysyms can be fetched in one round trip
+   */
+  min_keycode = G_MAXINT;
+  max_keycode = 0;
+  for (i = 3 * xmodmap->max_keypermod; i < map_size; i++) {
+    int keycode = xmodmap->modifiermap[i];
+
+    if (keycode == 0) continue;
+
+    min_keycode = MIN(min_keycode, keycode);
+    max_keycode = MAX(max_keycode, keycode);
+  }
+
+  keysyms = NULL;
+  keysyms_per_keycode = 0;
+  if (max_keycode != 0) {
+    keysyms = XGetKeyboardMapping(xdisplay, min_keycode,
+                                  max_keycode - min_keycode + 1,
+                                  &keysyms_per_keycode);
+  }
+
+  for (i = 3 * xmodmap->max_keypermod; keysyms != NULL && i < map_size; i++) {
     /* get the key code at this point in the map,
      * see if its keysym is one we're interested in
      */
     int keycode = xmodmap->modifiermap[i];
-    GdkKeymapKey *keys;
-    guint *keyvals;
-    int n_entries;
-    int j;
+    const KeySym *syms;
     EggVirtualModifierType mask;
 
-    keys = NULL;
-    keyvals = NULL;
-    n_entries = 0;
+    if (keycode == 0) continue;
 
-    gdk_keymap_get_entries_for_keycode(keymap, keycode, &keys, &keyvals,
-                                       &n_entries);
+    syms = keysyms + (keycode - min_keycode) * keysyms_per_keycode;
 
     mask = 0;
-    j = 0;
-    while (j < n_entries) {
-      if (keyvals[j] == GDK_KEY_Num_Lock)
-        mask |= EGG_VIRTUAL_NUM_LOCK_MASK;
-      else if (keyvals[j] == GDK_KEY_Scroll_Lock)
-        mask |= EGG_VIRTUAL_SCROLL_LOCK_MASK;
-      else if (keyvals[j] == GDK_KEY_Meta_L || keyvals[j] == GDK_KEY_Meta_R)
-        mask |= EGG_VIRTUAL_META_MASK;
-      else if (keyvals[j] == GDK_KEY_Hyper_L || keyvals[j] == GDK_KEY_Hyper_R)
-        mask |= EGG_VIRTUAL_HYPER_MASK;
-      else if (keyvals[j] == GDK_KEY_Super_L || keyvals[j] == GDK_KEY_Super_R)
-        mask |= EGG_VIRTUAL_SUPER_MASK;
-      else if (keyvals[j] == GDK_KEY_Mode_switch)
-        mask |= EGG_VIRTUAL_MODE_SWITCH_MASK;
-
-      ++j;
+    for (j = 0; j < keysyms_per_keycode; j++) {
+      mask |= keysym_to_virtual_mask(syms[j]);
     }
 
     /* Mod1Mask is 1 << 3 for example, i.e. the
@@ -371,11 +375,6 @@ static void reload_modmap(GdkKeymap *keymap, EggModmap *modmap) {
      * index
      */
     modmap->mapping[i / xmodmap->max_keypermod] |= mask;
-
-    g_free(keyvals);
-    g_free(keys);
-
-    ++i;
   }
 
   /* Add in the not-really-virtual fixed entries */
@@ -388,7 +387,16 @@ static void reload_modmap(GdkKeymap *keymap, EggModmap *modmap) {
   modmap->mapping[EGG_MODMAP_ENTRY_MOD4] |= EGG_VIRTUAL_MOD4_MASK;
   modmap->mapping[EGG_MODMAP_ENTRY_MOD5] |= EGG_VIRTUAL_MOD5_MASK;
 
+  if (keysyms != NULL) XFree(keysyms);
   XFreeModifiermap(xmodmap);
+
+  build_lookup_tables(modmap);
+  modmap->generation = keymap_generation;
+}
+
+static void keymap_keys_changed(GdkKeymap *keymap G_GNUC_UNUSED,
+                                gpointer data G_GNUC_UNUSED) {
+  keymap_generation++;
 }
 
 const EggModmap *egg_keymap_get_modmap(GdkKeymap *keymap) {
@@ -403,13 +411,17 @@ const EggModmap *egg_keymap_get_modmap(GdkKeymap *keymap) {
   if (modmap == NULL) {
     modmap = g_new0(EggModmap, 1);
 
-    /* FIXME modify keymap change events with an event filter
-     * and force a reload if we get one
-     */
-
     reload_modmap(keymap, modmap);
 
     g_object_set_data_full(G_OBJECT(keymap), "egg-modmap", modmap, g_free);
+
+    /* Connected before anyone can query us from their own keys-changed
+     * handler, so the modmap they get is already the reloaded one.
+     */
+    g_signal_connect(keymap, "keys-changed", G_CALLBACK(keymap_keys_changed),
+                     NULL);
+  } else if (modmap->generation != keymap_generation) {
+    reload_modmap(keymap, modmap);
   }
 
   g_assert(modmap != NULL);
@@ -0,0 +1,714 @@
+/*
+Runs one legacy indicator module outside of the applet.
+
+Loads the module given on the command line and exports its entries as a
+menu model and an action group on the peer to peer D-Bus connection it
+inherits from the applet, see indicator-remote.h for the layout.  The
+applet renders them like it does new style indicators, so the module's
+CPU time, memory and crashes stay in this process.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <gtk/gtk.h>
+#include <stdlib.h>
+
+#include "indicator-remote.h"
+
+/* GtkMenuItem -> the GSimpleAction activating it.  Kept across rebuilds
+   while the item is shown, so the applet's widgets keep their action. */
+#define ITEM_DATA_ACTION "indicator-module-host-action"
+
+typedef struct {
+  guint id;
+  IndicatorObjectEntry *entry;
+  /* The entry's menu, linked from its item in the root menu */
+  GMenu *submenu;
+  /* Items of the submenu with an ITEM_DATA_ACTION */
+  GHashTable *items;
+  /* Menus and items with watch handlers connected */
+  GPtrArray *watched;
+  gboolean header_dirty;
+  gboolean menu_dirty;
+  guint update_id;
+} host_entry_t;
+
+static IndicatorObject *io = NULL;
+static GMenu *root = NULL;
+static GSimpleActionGroup *actions = NULL;
+/* host_entry_t in the order of the root menu */
+static GPtrArray *entries = NULL;
+static guint next_entry_id = 0;
+static guint next_item_id = 0;
+
+static gint fd = -1;
+
+static const GOptionEntry options[] = {
+    {"fd", 0, 0, G_OPTION_ARG_INT, &fd,
+     "File descriptor of the socket connected to the applet", "FD"},
+    {NULL}};
+
+/*************
+ * Header
+ * ***********/
+
+static GIcon *image_get_icon(GtkImage *image) {
+  switch (gtk_image_get_storage_type(image)) {
+    case GTK_IMAGE_ICON_NAME: {
+      const gchar *icon_name = NULL;
+      gtk_image_get_icon_name(image, &icon_name, NULL);
+      return icon_name != NULL ? g_themed_icon_new(icon_name) : NULL;
+    }
+    case GTK_IMAGE_GICON: {
+      GIcon *gicon = NULL;
+      gtk_image_get_gicon(image, &gicon, NULL);
+      return gicon != NULL ? g_object_ref(gicon) : NULL;
+    }
+    case GTK_IMAGE_PIXBUF: {
+      /* Serializes to the PNG bytes */
+      GdkPixbuf *pixbuf = gtk_image_get_pixbuf(image);
+      return pixbuf != NULL ? G_ICON(g_object_ref(pixbuf)) : NULL;
+    }
+    default:
+      return NULL;
+  }
+}
+
+static GVariant *header_state(host_entry_t *host_entry) {
+  IndicatorObjectEntry *entry = host_entry->entry;
+  GVariantBuilder builder;
+
+  g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+  if (entry->label != NULL) {
+    const gchar *label = gtk_label_get_text(entry->label);
+    g_variant_builder_add(&builder, "{sv}", "label",
+                          g_variant_new_string(label != NULL ? label : ""));
+    gboolean label_visible = gtk_widget_get_visible(GTK_WIDGET(entry->label));
+    g_variant_builder_add(&builder, "{sv}", "label-visible",
+                          g_variant_new_boolean(label_visible));
+  }
+
+  if (entry->image != NULL) {
+    GIcon *icon = image_get_icon(entry->image);
+    if (icon != NULL) {
+      GVariant *serialized = g_icon_serialize(icon);
+      if (serialized != NULL) {
+        g_variant_builder_add(&builder, "{sv}", "icon", serialized);
+        g_variant_unref(serialized);
+      }
+      g_object_unref(icon);
+    }
+    gboolean image_visible = gtk_widget_get_visible(GTK_WIDGET(entry->image));
+    g_variant_builder_add(&builder, "{sv}", "icon-visible",
+                          g_variant_new_boolean(image_visible));
+  }
+
+  if (entry->accessible_desc != NULL) {
+    g_variant_builder_add(&builder, "{sv}", "accessible-desc",
+                          g_variant_new_string(entry->accessible_desc));
+  }
+  if (entry->name_hint != NULL) {
+    g_variant_builder_add(&builder, "{sv}", "name-hint",
+                          g_variant_new_string(entry->name_hint));
+  }
+
+  return g_variant_builder_end(&builder);
+}
+
+/*************
+ * Menus
+ * ***********/
+
+static void schedule_update(host_entry_t *host_entry);
+
+static void menu_changed_cb(GtkWidget *widget G_GNUC_UNUSED,
+                            gpointer user_data) {
+  host_entry_t *host_entry = (host_entry_t *)user_data;
+  host_entry->menu_dirty = TRUE;
+  schedule_update(host_entry);
+}
+
+static void menu_child_changed_cb(GtkWidget *widget,
+                                  GtkWidget *child G_GNUC_UNUSED,
+                                  gpointer user_data) {
+  menu_changed_cb(widget, user_data);
+}
+
+static void menu_insert_cb(GtkWidget *widget, GtkWidget *child,
+                           gint position G_GNUC_UNUSED, gpointer user_data) {
+  menu_child_changed_cb(widget, child, user_data);
+}
+
+static void item_notify_cb(GtkWidget *widget, GParamSpec *pspec,
+                           gpointer user_data) {
+  GSimpleAction *action =
+      g_object_get_data(G_OBJECT(widget), ITEM_DATA_ACTION);
+
+  /* Mirror toggles and sensitivity without rebuilding the menu */
+  if (GTK_IS_CHECK_MENU_ITEM(widget) && action != NULL &&
+      g_strcmp0(pspec->name, "active") == 0) {
+    g_simple_action_set_state(
+        action, g_variant_new_boolean(gtk_check_menu_item_get_active(
+                    GTK_CHECK_MENU_ITEM(widget))));
+    return;
+  }
+  if (action != NULL && g_strcmp0(pspec->name, "sensitive") == 0) {
+    g_simple_action_set_enabled(action, gtk_widget_get_sensitive(widget));
+    return;
+  }
+
+  menu_changed_cb(widget, user_data);
+}
+
+static void watch(host_entry_t *host_entry, GtkWidget *widget) {
+  g_ptr_array_add(host_entry->watched, g_object_ref(widget));
+
+  if (GTK_IS_MENU_SHELL(widget)) {
+    g_signal_connect(widget, "insert", G_CALLBACK(menu_insert_cb),
+                     host_entry);
+    g_signal_connect(widget, "remove", G_CALLBACK(menu_child_changed_cb),
+                     host_entry);
+    return;
+  }
+
+  const gchar *props[] = {"notify::label", "notify::visible",
+                          "notify::sensitive", "notify::submenu"};
+  guint i;
+  for (i = 0; i < G_N_ELEMENTS(props); i++) {
+    g_signal_connect(widget, props[i], G_CALLBACK(item_notify_cb), host_entry);
+  }
+  if (GTK_IS_CHECK_MENU_ITEM(widget)) {
+    g_signal_connect(widget, "notify::active", G_CALLBACK(item_notify_cb),
+                     host_entry);
+  }
+}
+
+static void unwatch_all(host_entry_t *host_entry) {
+  guint i;
+
+  for (i = 0; i < host_entry->watched->len; i++) {
+    GObject *widget = g_ptr_array_index(host_entry->watched, i);
+    g_signal_handlers_disconnect_by_data(widget, host_entry);
+  }
+
+  g_ptr_array_set_size(host_entry->watched, 0);
+}
+
+static void item_activate_cb(GSimpleAction *action G_GNUC_UNUSED,
+                             GVariant *parameter G_GNUC_UNUSED,
+                             gpointer user_data) {
+  gtk_menu_item_activate(GTK_MENU_ITEM(user_data));
+}
+
+static void fill_menu(host_entry_t *host_entry, GMenu *menu,
+                      GtkMenuShell *shell);
+
+static GMenuItem *menu_item_new(host_entry_t *host_entry, GtkMenuItem *item) {
+  GtkWidget *submenu = gtk_menu_item_get_submenu(item);
+  GMenuItem *menu_item = g_menu_item_new(gtk_menu_item_get_label(item), NULL);
+
+  if (submenu != NULL) {
+    GMenu *menu = g_menu_new();
+    fill_menu(host_entry, menu, GTK_MENU_SHELL(submenu));
+    g_menu_item_set_submenu(menu_item, G_MENU_MODEL(menu));
+    g_object_unref(menu);
+    return menu_item;
+  }
+
+  GSimpleAction *action = g_object_get_data(G_OBJECT(item), ITEM_DATA_ACTION);
+
+  if (action == NULL) {
+    gchar *name = g_strdup_printf("item%u", next_item_id++);
+
+    if (GTK_IS_CHECK_MENU_ITEM(item)) {
+      /* Radio items are shown as check items */
+      action = g_simple_action_new_stateful(
+          name, NULL,
+          g_variant_new_boolean(
+              gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(item))));
+    } else {
+      action = g_simple_action_new(name, NULL);
+    }
+    g_signal_connect_object(action, "activate", G_CALLBACK(item_activate_cb),
+                            item, 0);
+    g_action_map_add_action(G_ACTION_MAP(actions), G_ACTION(action));
+    g_object_set_data_full(G_OBJECT(item), ITEM_DATA_ACTION, action,
+                           g_object_unref);
+    g_free(name);
+  } else if (GTK_IS_CHECK_MENU_ITEM(item)) {
+    g_simple_action_set_state(
+        action, g_variant_new_boolean(gtk_check_menu_item_get_active(
+                    GTK_CHECK_MENU_ITEM(item))));
+  }
+  g_simple_action_set_enabled(action,
+                              gtk_widget_get_sensitive(GTK_WIDGET(item)));
+  g_hash_table_add(host_entry->items, g_object_ref(item));
+
+  gchar *detailed = g_strconcat(INDICATOR_REMOTE_ACTION_NAMESPACE ".",
+                                g_action_get_name(G_ACTION(action)), NULL);
+  g_menu_item_set_detailed_action(menu_item, detailed);
+  g_free(detailed);
+
+  return menu_item;
+}
+
+/* Separators start a new section */
+static void fill_menu(host_entry_t *host_entry, GMenu *menu,
+                      GtkMenuShell *shell) {
+  GMenu *section = g_menu_new();
+  GList *children = gtk_container_get_children(GTK_CONTAINER(shell));
+  GList *child = NULL;
+
+  watch(host_entry, GTK_WIDGET(shell));
+
+  for (child = children; child != NULL; child = g_list_next(child)) {
+    GtkWidget *widget = GTK_WIDGET(child->data);
+
+    if (!GTK_IS_MENU_ITEM(widget)) {
+      continue;
+    }
+
+    watch(host_entry, widget);
+
+    if (!gtk_widget_get_visible(widget)) {
+      continue;
+    }
+
+    if (GTK_IS_SEPARATOR_MENU_ITEM(widget)) {
+      if (g_menu_model_get_n_items(G_MENU_MODEL(section)) > 0) {
+        g_menu_append_section(menu, NULL, G_MENU_MODEL(section));
+        g_object_unref(section);
+        section = g_menu_new();
+      }
+      continue;
+    }
+
+    GMenuItem *menu_item = menu_item_new(host_entry, GTK_MENU_ITEM(widget));
+    g_menu_append_item(section, menu_item);
+    g_object_unref(menu_item);
+  }
+
+  if (g_menu_model_get_n_items(G_MENU_MODEL(section)) > 0) {
+    g_menu_append_section(menu, NULL, G_MENU_MODEL(section));
+  }
+  g_object_unref(section);
+  g_list_free(children);
+}
+
+static void item_action_remove(GObject *item) {
+  GAction *action = g_object_get_data(item, ITEM_DATA_ACTION);
+
+  g_action_map_remove_action(G_ACTION_MAP(actions),
+                             g_action_get_name(action));
+  g_object_set_data(item, ITEM_DATA_ACTION, NULL);
+}
+
+/* Removes the actions of the items not also in keep, which may be NULL */
+static void remove_item_actions(GHashTable *items, GHashTable *keep) {
+  GHashTableIter iter;
+  gpointer item;
+
+  g_hash_table_iter_init(&iter, items);
+  while (g_hash_table_iter_next(&iter, &item, NULL)) {
+    if (keep == NULL || !g_hash_table_contains(keep, item)) {
+      item_action_remove(G_OBJECT(item));
+    }
+  }
+
+  g_hash_table_remove_all(items);
+}
+
+static GHashTable *items_new(void) {
+  return g_hash_table_new_full(NULL, NULL, g_object_unref, NULL);
+}
+
+/* Items still shown keep their action, so only the menu model changes */
+static void rebuild_menu(host_entry_t *host_entry) {
+  GHashTable *old_items = host_entry->items;
+
+  unwatch_all(host_entry);
+  g_menu_remove_all(host_entry->submenu);
+
+  host_entry->items = items_new();
+  if (host_entry->entry->menu != NULL) {
+    fill_menu(host_entry, host_entry->submenu,
+              GTK_MENU_SHELL(host_entry->entry->menu));
+  }
+
+  remove_item_actions(old_items, host_entry->items);
+  g_hash_table_unref(old_items);
+}
+
+/*************
+ * Entries
+ * ***********/
+
+static gchar *entry_action_name(host_entry_t *host_entry,
+                                const gchar *suffix) {
+  return g_strdup_printf("entry%u%s", host_entry->id, suffix);
+}
+
+static void update_header(host_entry_t *host_entry) {
+  gchar *name = entry_action_name(host_entry, "");
+  GAction *action = g_action_map_lookup_action(G_ACTION_MAP(actions), name);
+
+  if (action != NULL) {
+    g_simple_action_set_state(G_SIMPLE_ACTION(action),
+                              header_state(host_entry));
+  }
+  g_free(name);
+}
+
+static gboolean update_cb(gpointer user_data) {
+  host_entry_t *host_entry = (host_entry_t *)user_data;
+
+  host_entry->update_id = 0;
+
+  if (host_entry->header_dirty) {
+    host_entry->header_dirty = FALSE;
+    update_header(host_entry);
+  }
+  if (host_entry->menu_dirty) {
+    host_entry->menu_dirty = FALSE;
+    rebuild_menu(host_entry);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Changes usually come in bursts, send them once they are over */
+static void schedule_update(host_entry_t *host_entry) {
+  if (host_entry->update_id == 0) {
+    host_entry->update_id = g_idle_add(update_cb, host_entry);
+  }
+}
+
+static void header_changed_cb(GObject *object G_GNUC_UNUSED,
+                              GParamSpec *pspec G_GNUC_UNUSED,
+                              gpointer user_data) {
+  host_entry_t *host_entry = (host_entry_t *)user_data;
+  host_entry->header_dirty = TRUE;
+  schedule_update(host_entry);
+}
+
+static void entry_activate_cb(GSimpleAction *action G_GNUC_UNUSED,
+                              GVariant *parameter, gpointer user_data) {
+  host_entry_t *host_entry = (host_entry_t *)user_data;
+  indicator_object_entry_activate(io, host_entry->entry,
+                                  g_variant_get_uint32(parameter));
+}
+
+static void entry_secondary_cb(GSimpleAction *action G_GNUC_UNUSED,
+                               GVariant *parameter, gpointer user_data) {
+  host_entry_t *host_entry = (host_entry_t *)user_data;
+  g_signal_emit_by_name(io, INDICATOR_OBJECT_SIGNAL_SECONDARY_ACTIVATE,
+                        host_entry->entry, g_variant_get_uint32(parameter));
+}
+
+static void entry_scroll_cb(GSimpleAction *action G_GNUC_UNUSED,
+                            GVariant *parameter, gpointer user_data) {
+  host_entry_t *host_entry = (host_entry_t *)user_data;
+  gint delta;
+  guint direction;
+
+  /* The same signals the applet emits for in process modules */
+  g_variant_get(parameter, "(iu)", &delta, &direction);
+  g_signal_emit_by_name(io, "scroll", delta, direction);
+  g_signal_emit_by_name(io, "scroll-entry", host_entry->entry, delta,
+                        direction);
+  g_signal_emit_by_name(io, INDICATOR_OBJECT_SIGNAL_ENTRY_SCROLLED,
+                        host_entry->entry, delta, direction);
+}
+
+/* The applet opened or closed its copy of the menu.  Modules that fill it
+   in or refresh it on "show" do so now, and the rebuild follows. */
+static void entry_menu_cb(GSimpleAction *action G_GNUC_UNUSED,
+                          GVariant *parameter, gpointer user_data) {
+  host_entry_t *host_entry = (host_entry_t *)user_data;
+  GtkWidget *menu = GTK_WIDGET(host_entry->entry->menu);
+
+  if (menu == NULL) {
+    return;
+  }
+
+  if (g_variant_get_boolean(parameter)) {
+    gtk_widget_show(menu);
+  } else {
+    gtk_widget_hide(menu);
+  }
+}
+
+static void add_entry_action(host_entry_t *host_entry, const gchar *suffix,
+                             const GVariantType *parameter_type,
+                             GVariant *state, GCallback callback) {
+  gchar *name = entry_action_name(host_entry, suffix);
+  GSimpleAction *action =
+      state != NULL
+          ? g_simple_action_new_stateful(name, parameter_type, state)
+          : g_simple_action_new(name, parameter_type);
+
+  g_signal_connect(action, "activate", callback, host_entry);
+  g_action_map_add_action(G_ACTION_MAP(actions), G_ACTION(action));
+  g_object_unref(action);
+  g_free(name);
+}
+
+static void remove_entry_action(host_entry_t *host_entry,
+                                const gchar *suffix) {
+  gchar *name = entry_action_name(host_entry, suffix);
+  g_action_map_remove_action(G_ACTION_MAP(actions), name);
+  g_free(name);
+}
+
+static gint find_entry(IndicatorObjectEntry *entry) {
+  guint i;
+
+  for (i = 0; i < entries->len; i++) {
+    host_entry_t *host_entry = g_ptr_array_index(entries, i);
+    if (host_entry->entry == entry) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static GMenuItem *root_item_new(host_entry_t *host_entry) {
+  gchar *name = entry_action_name(host_entry, "");
+  gchar *detailed =
+      g_strconcat(INDICATOR_REMOTE_ACTION_NAMESPACE ".", name, NULL);
+  GMenuItem *item = g_menu_item_new(NULL, NULL);
+
+  /* Not a detailed action, activating the entry needs a timestamp */
+  g_menu_item_set_attribute(item, G_MENU_ATTRIBUTE_ACTION, "s", detailed);
+  g_menu_item_set_submenu(item, G_MENU_MODEL(host_entry->submenu));
+
+  g_free(detailed);
+  g_free(name);
+  return item;
+}
+
+static void entry_added(IndicatorObject *object G_GNUC_UNUSED,
+                        IndicatorObjectEntry *entry,
+                        gpointer user_data G_GNUC_UNUSED) {
+  if (find_entry(entry) >= 0) {
+    return;
+  }
+
+  host_entry_t *host_entry = g_new0(host_entry_t, 1);
+  host_entry->id = next_entry_id++;
+  host_entry->entry = entry;
+  host_entry->submenu = g_menu_new();
+  host_entry->items = items_new();
+  host_entry->watched = g_ptr_array_new_with_free_func(g_object_unref);
+
+  if (entry->label != NULL) {
+    g_signal_connect(entry->label, "notify::label",
+                     G_CALLBACK(header_changed_cb), host_entry);
+    g_signal_connect(entry->label, "notify::visible",
+                     G_CALLBACK(header_changed_cb), host_entry);
+  }
+  if (entry->image != NULL) {
+    g_signal_connect(entry->image, "notify", G_CALLBACK(header_changed_cb),
+                     host_entry);
+  }
+
+  add_entry_action(host_entry, "", G_VARIANT_TYPE_UINT32,
+                   header_state(host_entry), G_CALLBACK(entry_activate_cb));
+  add_entry_action(host_entry, "-secondary", G_VARIANT_TYPE_UINT32, NULL,
+                   G_CALLBACK(entry_secondary_cb));
+  add_entry_action(host_entry, "-scroll", G_VARIANT_TYPE("(iu)"), NULL,
+                   G_CALLBACK(entry_scroll_cb));
+  add_entry_action(host_entry, "-menu", G_VARIANT_TYPE_BOOLEAN, NULL,
+                   G_CALLBACK(entry_menu_cb));
+  rebuild_menu(host_entry);
+
+  guint position = indicator_object_get_location(io, entry);
+  position = MIN(position, entries->len);
+  g_ptr_array_insert(entries, position, host_entry);
+
+  GMenuItem *item = root_item_new(host_entry);
+  g_menu_insert_item(root, position, item);
+  g_object_unref(item);
+}
+
+static void entry_removed(IndicatorObject *object G_GNUC_UNUSED,
+                          IndicatorObjectEntry *entry,
+                          gpointer user_data G_GNUC_UNUSED) {
+  gint position = find_entry(entry);
+
+  if (position < 0) {
+    return;
+  }
+
+  host_entry_t *host_entry = g_ptr_array_index(entries, position);
+  g_ptr_array_remove_index(entries, position);
+  g_menu_remove(root, position);
+
+  if (entry->label != NULL) {
+    g_signal_handlers_disconnect_by_data(entry->label, host_entry);
+  }
+  if (entry->image != NULL) {
+    g_signal_handlers_disconnect_by_data(entry->image, host_entry);
+  }
+  if (host_entry->update_id != 0) {
+    g_source_remove(host_entry->update_id);
+  }
+
+  unwatch_all(host_entry);
+  remove_item_actions(host_entry->items, NULL);
+  remove_entry_action(host_entry, "");
+  remove_entry_action(host_entry, "-secondary");
+  remove_entry_action(host_entry, "-scroll");
+  remove_entry_action(host_entry, "-menu");
+
+  g_ptr_array_unref(host_entry->watched);
+  g_hash_table_unref(host_entry->items);
+  g_object_unref(host_entry->submenu);
+  g_free(host_entry);
+}
+
+static void entry_moved(IndicatorObject *object G_GNUC_UNUSED,
+                        IndicatorObjectEntry *entry, gint old G_GNUC_UNUSED,
+                        gint new, gpointer user_data G_GNUC_UNUSED) {
+  gint position = find_entry(entry);
+
+  if (position < 0) {
+    return;
+  }
+
+  host_entry_t *host_entry = g_ptr_array_index(entries, position);
+  g_ptr_array_remove_index(entries, position);
+  g_menu_remove(root, position);
+
+  guint new_position = MIN((guint)MAX(new, 0), entries->len);
+  g_ptr_array_insert(entries, new_position, host_entry);
+
+  GMenuItem *item = root_item_new(host_entry);
+  g_menu_insert_item(root, new_position, item);
+  g_object_unref(item);
+}
+
+static void accessible_desc_update(IndicatorObject *object G_GNUC_UNUSED,
+                                   IndicatorObjectEntry *entry,
+                                   gpointer user_data G_GNUC_UNUSED) {
+  gint position = find_entry(entry);
+
+  if (position >= 0) {
+    header_changed_cb(NULL, NULL, g_ptr_array_index(entries, position));
+  }
+}
+
+/*************
+ * main
+ * ***********/
+
+static void connection_closed_cb(GDBusConnection *connection G_GNUC_UNUSED,
+                                 gboolean remote_peer_vanished G_GNUC_UNUSED,
+                                 GError *error G_GNUC_UNUSED,
+                                 gpointer user_data G_GNUC_UNUSED) {
+  gtk_main_quit();
+}
+
+int main(int argc, char **argv) {
+  GOptionContext *context = g_option_context_new("MODULE");
+  GError *error = NULL;
+
+  g_option_context_add_main_entries(context, options, NULL);
+  g_option_context_add_group(context, gtk_get_option_group(TRUE));
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+
+  if (argc != 2 || fd < 0) {
+    g_printerr("Usage: %s --fd=FD MODULE\n", g_get_prgname());
+    return EXIT_FAILURE;
+  }
+
+  GSocket *socket = g_socket_new_from_fd(fd, &error);
+  if (socket == NULL) {
+    g_printerr("Unable to use socket %d: %s\n", fd, error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  GSocketConnection *stream =
+      g_socket_connection_factory_create_connection(socket);
+  GDBusConnection *connection = g_dbus_connection_new_sync(
+      G_IO_STREAM(stream), NULL,
+      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+          G_DBUS_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING,
+      NULL, NULL, &error);
+  g_object_unref(stream);
+  g_object_unref(socket);
+  if (connection == NULL) {
+    g_printerr("Unable to connect to the applet: %s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  io = indicator_object_new_from_file(argv[1]);
+  if (io == NULL) {
+    g_printerr("Unable to load module: %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  root = g_menu_new();
+  actions = g_simple_action_group_new();
+  entries = g_ptr_array_new();
+
+  g_signal_connect(io, INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED,
+                   G_CALLBACK(entry_added), NULL);
+  g_signal_connect(io, INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED,
+                   G_CALLBACK(entry_removed), NULL);
+  g_signal_connect(io, INDICATOR_OBJECT_SIGNAL_ENTRY_MOVED,
+                   G_CALLBACK(entry_moved), NULL);
+  g_signal_connect(io, INDICATOR_OBJECT_SIGNAL_ACCESSIBLE_DESC_UPDATE,
+                   G_CALLBACK(accessible_desc_update), NULL);
+
+  GList *initial = indicator_object_get_entries(io);
+  GList *entry = NULL;
+  for (entry = initial; entry != NULL; entry = g_list_next(entry)) {
+    entry_added(io, (IndicatorObjectEntry *)entry->data, NULL);
+  }
+  g_list_free(initial);
+
+  /* Export once populated so the applet's first query sees every entry */
+  if (g_dbus_connection_export_action_group(
+          connection, INDICATOR_REMOTE_OBJECT_PATH, G_ACTION_GROUP(actions),
+          &error) == 0 ||
+      g_dbus_connection_export_menu_model(connection,
+                                          INDICATOR_REMOTE_OBJECT_PATH,
+                                          G_MENU_MODEL(root), &error) == 0) {
+    g_printerr("Unable to export the entries: %s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  g_signal_connect(connection, "closed", G_CALLBACK(connection_closed_cb),
+                   NULL);
+  g_dbus_connection_start_message_processing(connection);
+
+  gtk_main();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,666 @@
+/*
+An indicator object whose module runs in mate-indicator-module-host.
+
+The host is spawned with one end of a socket pair, over which this side
+runs the server end of a peer to peer D-Bus connection.  The entries are
+built from the exported menu model and header actions, with their menus
+made by gtk_menu_new_from_model() as for new style indicators.
+
+New style services are shown the same way from the session bus.  Unlike
+libindicator, which rebuilds a whole section of widgets whenever the
+section changes, GTK's menu tracker applies each items-changed to the
+widgets it covers and only fills a submenu in once it is shown.  Custom
+item types, such as sliders and calendars, are shown as plain items.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include "indicator-remote.h"
+
+#include <errno.h>
+#include <gtk/gtk.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define HOST_NAME "mate-indicator-module-host"
+
+#define SERVICE_GROUP "Indicator Service"
+
+typedef struct {
+  IndicatorObjectEntry entry;
+  IndicatorRemote *self;
+  /* Names of the header, secondary and scroll actions, without the
+     namespace.  Only services have the latter two. */
+  gchar *action;
+  gchar *secondary_action;
+  gchar *scroll_action;
+} remote_entry_t;
+
+struct _IndicatorRemote {
+  IndicatorObject parent;
+
+  gchar *path;
+  GSubprocess *process;
+  GCancellable *cancellable;
+  GDBusConnection *connection;
+  GMenuModel *menu;
+  GActionGroup *actions;
+  /* remote_entry_t in the order of the root menu */
+  GPtrArray *entries;
+
+  /* Set for a service, which has no host */
+  gchar *object_path;
+  gchar *menu_path;
+  gchar *name_hint;
+  guint watch_id;
+};
+
+G_DEFINE_TYPE(IndicatorRemote, indicator_remote, INDICATOR_OBJECT_TYPE)
+
+static void activate_action(IndicatorRemote *self, const gchar *action,
+                            const gchar *suffix, GVariant *parameter);
+
+/*************
+ * Entries
+ * ***********/
+
+static void entry_update(IndicatorRemote *self, remote_entry_t *remote_entry,
+                         GVariant *state) {
+  IndicatorObjectEntry *entry = &remote_entry->entry;
+  const gchar *label = NULL;
+  const gchar *accessible_desc = NULL;
+  gboolean visible = FALSE;
+  GVariant *serialized_icon = NULL;
+
+  if (state == NULL ||
+      !g_variant_is_of_type(state, G_VARIANT_TYPE_VARDICT)) {
+    return;
+  }
+
+  /* Only services say whether the whole entry shows */
+  g_variant_lookup(state, "visible", "b", &visible);
+  gboolean label_visible = visible;
+  gboolean icon_visible = visible;
+
+  g_variant_lookup(state, "label", "&s", &label);
+  g_variant_lookup(state, "label-visible", "b", &label_visible);
+  g_variant_lookup(state, "icon-visible", "b", &icon_visible);
+  g_variant_lookup(state, "accessible-desc", "&s", &accessible_desc);
+  serialized_icon = g_variant_lookup_value(state, "icon", NULL);
+
+  gtk_label_set_text(entry->label, label != NULL ? label : "");
+  gtk_widget_set_visible(GTK_WIDGET(entry->label),
+                         label_visible && label != NULL && *label != '\0');
+
+  GIcon *icon = NULL;
+  if (serialized_icon != NULL) {
+    icon = g_icon_deserialize(serialized_icon);
+    g_variant_unref(serialized_icon);
+  }
+  if (icon != NULL) {
+    gtk_image_set_from_gicon(entry->image, icon, GTK_ICON_SIZE_LARGE_TOOLBAR);
+    g_object_unref(icon);
+  } else {
+    gtk_image_clear(entry->image);
+    icon_visible = FALSE;
+  }
+  gtk_widget_set_visible(GTK_WIDGET(entry->image), icon_visible);
+
+  if (g_strcmp0(accessible_desc, entry->accessible_desc) != 0) {
+    g_free((gchar *)entry->accessible_desc);
+    entry->accessible_desc = g_strdup(accessible_desc);
+    g_signal_emit_by_name(self, INDICATOR_OBJECT_SIGNAL_ACCESSIBLE_DESC_UPDATE,
+                          entry);
+  }
+
+  if (entry->name_hint == NULL) {
+    const gchar *name_hint = NULL;
+    if (g_variant_lookup(state, "name-hint", "&s", &name_hint)) {
+      entry->name_hint = g_strdup(name_hint);
+    }
+  }
+}
+
+/* The root item's action attribute, without the namespace */
+static gchar *entry_action(IndicatorRemote *self, gint position,
+                           const gchar *attribute) {
+  gchar *action = NULL;
+  gchar *name = NULL;
+
+  if (g_menu_model_get_item_attribute(self->menu, position, attribute, "s",
+                                      &action) &&
+      g_str_has_prefix(action, INDICATOR_REMOTE_ACTION_NAMESPACE ".")) {
+    name = g_strdup(action + strlen(INDICATOR_REMOTE_ACTION_NAMESPACE "."));
+  }
+  g_free(action);
+  return name;
+}
+
+/* The host shows the module's own menu along, for modules that fill it in
+   on "show" */
+static void entry_menu_shown_cb(GtkWidget *menu, gpointer user_data) {
+  remote_entry_t *remote_entry = (remote_entry_t *)user_data;
+
+  activate_action(remote_entry->self, remote_entry->action, "-menu",
+                  g_variant_new_boolean(gtk_widget_get_visible(menu)));
+}
+
+static remote_entry_t *entry_new(IndicatorRemote *self, gint position) {
+  remote_entry_t *remote_entry = g_new0(remote_entry_t, 1);
+  IndicatorObjectEntry *entry = &remote_entry->entry;
+
+  remote_entry->self = self;
+  remote_entry->action = entry_action(self, position, G_MENU_ATTRIBUTE_ACTION);
+  if (self->object_path != NULL) {
+    remote_entry->secondary_action =
+        entry_action(self, position, "x-ayatana-secondary-action");
+    if (remote_entry->secondary_action == NULL) {
+      remote_entry->secondary_action =
+          entry_action(self, position, "x-canonical-secondary-action");
+    }
+    remote_entry->scroll_action =
+        entry_action(self, position, "x-ayatana-scroll-action");
+    if (remote_entry->scroll_action == NULL) {
+      remote_entry->scroll_action =
+          entry_action(self, position, "x-canonical-scroll-action");
+    }
+    entry->name_hint = g_strdup(self->name_hint);
+  }
+
+  entry->label = GTK_LABEL(g_object_ref_sink(gtk_label_new(NULL)));
+  entry->image = GTK_IMAGE(g_object_ref_sink(gtk_image_new()));
+
+  GMenuModel *submenu =
+      g_menu_model_get_item_link(self->menu, position, G_MENU_LINK_SUBMENU);
+  if (submenu != NULL) {
+    entry->menu =
+        GTK_MENU(g_object_ref_sink(gtk_menu_new_from_model(submenu)));
+    gtk_widget_insert_action_group(GTK_WIDGET(entry->menu),
+                                   INDICATOR_REMOTE_ACTION_NAMESPACE,
+                                   self->actions);
+    g_object_unref(submenu);
+
+    if (self->object_path == NULL) {
+      g_signal_connect(entry->menu, "show", G_CALLBACK(entry_menu_shown_cb),
+                       remote_entry);
+      g_signal_connect(entry->menu, "hide", G_CALLBACK(entry_menu_shown_cb),
+                       remote_entry);
+    }
+  }
+
+  if (remote_entry->action != NULL) {
+    GVariant *state =
+        g_action_group_get_action_state(self->actions, remote_entry->action);
+    if (state != NULL) {
+      entry_update(self, remote_entry, state);
+      g_variant_unref(state);
+    }
+  }
+
+  return remote_entry;
+}
+
+static void entry_free(remote_entry_t *remote_entry) {
+  IndicatorObjectEntry *entry = &remote_entry->entry;
+
+  gtk_widget_destroy(GTK_WIDGET(entry->label));
+  gtk_widget_destroy(GTK_WIDGET(entry->image));
+  g_object_unref(entry->label);
+  g_object_unref(entry->image);
+  if (entry->menu != NULL) {
+    g_signal_handlers_disconnect_by_data(entry->menu, remote_entry);
+    gtk_widget_destroy(GTK_WIDGET(entry->menu));
+    g_object_unref(entry->menu);
+  }
+
+  g_free((gchar *)entry->accessible_desc);
+  g_free((gchar *)entry->name_hint);
+  g_free(remote_entry->action);
+  g_free(remote_entry->secondary_action);
+  g_free(remote_entry->scroll_action);
+  g_free(remote_entry);
+}
+
+static void remove_entries(IndicatorRemote *self, guint position,
+                           guint count) {
+  guint i;
+
+  for (i = 0; i < count && position < self->entries->len; i++) {
+    remote_entry_t *remote_entry = g_ptr_array_index(self->entries, position);
+
+    g_ptr_array_remove_index(self->entries, position);
+    g_signal_emit_by_name(self, INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED,
+                          &remote_entry->entry);
+    entry_free(remote_entry);
+  }
+}
+
+static void menu_items_changed_cb(GMenuModel *menu G_GNUC_UNUSED,
+                                  gint position, gint removed, gint added,
+                                  gpointer user_data) {
+  IndicatorRemote *self = INDICATOR_REMOTE(user_data);
+  gint i;
+
+  remove_entries(self, position, removed);
+
+  for (i = 0; i < added; i++) {
+    remote_entry_t *remote_entry = entry_new(self, position + i);
+
+    g_ptr_array_insert(self->entries, position + i, remote_entry);
+    g_signal_emit_by_name(self, INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED,
+                          &remote_entry->entry);
+  }
+}
+
+static remote_entry_t *find_entry(IndicatorRemote *self,
+                                  const gchar *action) {
+  guint i;
+
+  for (i = 0; i < self->entries->len; i++) {
+    remote_entry_t *remote_entry = g_ptr_array_index(self->entries, i);
+    if (g_strcmp0(remote_entry->action, action) == 0) {
+      return remote_entry;
+    }
+  }
+
+  return NULL;
+}
+
+static void action_state_changed_cb(GActionGroup *actions G_GNUC_UNUSED,
+                                    const gchar *action, GVariant *state,
+                                    gpointer user_data) {
+  IndicatorRemote *self = INDICATOR_REMOTE(user_data);
+  remote_entry_t *remote_entry = find_entry(self, action);
+
+  if (remote_entry != NULL) {
+    entry_update(self, remote_entry, state);
+  }
+}
+
+static void action_added_cb(GActionGroup *actions, const gchar *action,
+                            gpointer user_data) {
+  IndicatorRemote *self = INDICATOR_REMOTE(user_data);
+  remote_entry_t *remote_entry = find_entry(self, action);
+
+  if (remote_entry != NULL) {
+    GVariant *state = g_action_group_get_action_state(actions, action);
+    if (state != NULL) {
+      entry_update(self, remote_entry, state);
+      g_variant_unref(state);
+    }
+  }
+}
+
+/*************
+ * Host
+ * ***********/
+
+static void host_gone(IndicatorRemote *self) {
+  if (self->menu != NULL) {
+    g_signal_handlers_disconnect_by_data(self->menu, self);
+    g_clear_object(&self->menu);
+  }
+  if (self->actions != NULL) {
+    g_signal_handlers_disconnect_by_data(self->actions, self);
+    g_clear_object(&self->actions);
+  }
+
+  remove_entries(self, 0, self->entries->len);
+}
+
+static void host_exited_cb(GObject *object, GAsyncResult *result,
+                           gpointer user_data) {
+  GSubprocess *process = G_SUBPROCESS(object);
+  GError *error = NULL;
+
+  if (!g_subprocess_wait_finish(process, result, &error)) {
+    /* Cancelled, the object is gone */
+    g_error_free(error);
+    return;
+  }
+
+  IndicatorRemote *self = INDICATOR_REMOTE(user_data);
+
+  if (g_subprocess_get_if_signaled(process)) {
+    g_warning("Module host for '%s' was killed by signal %d", self->path,
+              g_subprocess_get_term_sig(process));
+  } else {
+    g_warning("Module host for '%s' exited with status %d", self->path,
+              g_subprocess_get_exit_status(process));
+  }
+
+  host_gone(self);
+  g_clear_object(&self->process);
+}
+
+static void models_get(IndicatorRemote *self, GDBusConnection *connection,
+                       const gchar *bus_name, const gchar *object_path,
+                       const gchar *menu_path) {
+  self->actions = G_ACTION_GROUP(
+      g_dbus_action_group_get(connection, bus_name, object_path));
+  g_signal_connect(self->actions, "action-added", G_CALLBACK(action_added_cb),
+                   self);
+  g_signal_connect(self->actions, "action-state-changed",
+                   G_CALLBACK(action_state_changed_cb), self);
+
+  self->menu =
+      G_MENU_MODEL(g_dbus_menu_model_get(connection, bus_name, menu_path));
+  g_signal_connect(self->menu, "items-changed",
+                   G_CALLBACK(menu_items_changed_cb), self);
+
+  /* Both only start fetching once asked for their contents */
+  g_strfreev(g_action_group_list_actions(self->actions));
+  g_menu_model_get_n_items(self->menu);
+}
+
+static void connection_ready_cb(GObject *object G_GNUC_UNUSED,
+                                GAsyncResult *result, gpointer user_data) {
+  GError *error = NULL;
+  GDBusConnection *connection = g_dbus_connection_new_finish(result, &error);
+
+  if (connection == NULL) {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      g_warning("Unable to connect to the module host: %s", error->message);
+    }
+    g_error_free(error);
+    return;
+  }
+
+  IndicatorRemote *self = INDICATOR_REMOTE(user_data);
+  self->connection = connection;
+
+  /* NULL bus names, the connection is peer to peer */
+  models_get(self, connection, NULL, INDICATOR_REMOTE_OBJECT_PATH,
+             INDICATOR_REMOTE_OBJECT_PATH);
+}
+
+/*************
+ * Service
+ * ***********/
+
+static void service_appeared_cb(GDBusConnection *connection,
+                                const gchar *name, const gchar *name_owner,
+                                gpointer user_data) {
+  IndicatorRemote *self = INDICATOR_REMOTE(user_data);
+
+  g_debug("Service %s appeared as %s", name, name_owner);
+  host_gone(self);
+  /* The owner rather than the name, a restarted service has new menus */
+  models_get(self, connection, name_owner, self->object_path,
+             self->menu_path);
+}
+
+static void service_vanished_cb(GDBusConnection *connection G_GNUC_UNUSED,
+                                const gchar *name, gpointer user_data) {
+  g_debug("Service %s is not running", name);
+  host_gone(INDICATOR_REMOTE(user_data));
+}
+
+/*************
+ * Object
+ * ***********/
+
+static GList *indicator_remote_get_entries(IndicatorObject *io) {
+  IndicatorRemote *self = INDICATOR_REMOTE(io);
+  GList *entries = NULL;
+  gint i;
+
+  for (i = self->entries->len - 1; i >= 0; i--) {
+    remote_entry_t *remote_entry = g_ptr_array_index(self->entries, i);
+    entries = g_list_prepend(entries, &remote_entry->entry);
+  }
+
+  return entries;
+}
+
+static guint indicator_remote_get_location(IndicatorObject *io,
+                                           IndicatorObjectEntry *entry) {
+  IndicatorRemote *self = INDICATOR_REMOTE(io);
+  guint i;
+
+  for (i = 0; i < self->entries->len; i++) {
+    remote_entry_t *remote_entry = g_ptr_array_index(self->entries, i);
+    if (&remote_entry->entry == entry) {
+      return i;
+    }
+  }
+
+  return 0;
+}
+
+/* parameter is floating, and consumed */
+static void activate_action(IndicatorRemote *self, const gchar *action,
+                            const gchar *suffix, GVariant *parameter) {
+  if (self->actions == NULL || action == NULL) {
+    if (parameter != NULL) {
+      g_variant_unref(g_variant_ref_sink(parameter));
+    }
+    return;
+  }
+
+  gchar *name = g_strconcat(action, suffix, NULL);
+  g_action_group_activate_action(self->actions, name, parameter);
+  g_free(name);
+}
+
+static void indicator_remote_entry_activate(IndicatorObject *io,
+                                            IndicatorObjectEntry *entry,
+                                            guint timestamp) {
+  IndicatorRemote *self = INDICATOR_REMOTE(io);
+
+  /* A service's header action holds the state, its menu is all there is */
+  if (self->object_path == NULL) {
+    activate_action(self, ((remote_entry_t *)entry)->action, "",
+                    g_variant_new_uint32(timestamp));
+  }
+}
+
+/* Class handlers of the signals the applet emits */
+static void indicator_remote_secondary_activate(
+    IndicatorObject *io, IndicatorObjectEntry *entry, guint timestamp,
+    gpointer user_data G_GNUC_UNUSED) {
+  IndicatorRemote *self = INDICATOR_REMOTE(io);
+  remote_entry_t *remote_entry = (remote_entry_t *)entry;
+
+  if (self->object_path != NULL) {
+    activate_action(self, remote_entry->secondary_action, "", NULL);
+  } else {
+    activate_action(self, remote_entry->action, "-secondary",
+                    g_variant_new_uint32(timestamp));
+  }
+}
+
+static void indicator_remote_entry_scrolled(
+    IndicatorObject *io, IndicatorObjectEntry *entry, gint delta,
+    IndicatorScrollDirection direction, gpointer user_data G_GNUC_UNUSED) {
+  IndicatorRemote *self = INDICATOR_REMOTE(io);
+  remote_entry_t *remote_entry = (remote_entry_t *)entry;
+
+  if (self->object_path != NULL) {
+    /* Services take a signed step, up or right being positive */
+    if (direction == INDICATOR_OBJECT_SCROLL_DOWN ||
+        direction == INDICATOR_OBJECT_SCROLL_LEFT) {
+      delta = -delta;
+    }
+    activate_action(self, remote_entry->scroll_action, "",
+                    g_variant_new_int32(delta));
+  } else {
+    activate_action(self, remote_entry->action, "-scroll",
+                    g_variant_new("(iu)", delta, direction));
+  }
+}
+
+static void indicator_remote_dispose(GObject *object) {
+  IndicatorRemote *self = INDICATOR_REMOTE(object);
+
+  if (self->cancellable != NULL) {
+    g_cancellable_cancel(self->cancellable);
+    g_clear_object(&self->cancellable);
+  }
+
+  if (self->watch_id != 0) {
+    g_bus_unwatch_name(self->watch_id);
+    self->watch_id = 0;
+  }
+
+  host_gone(self);
+
+  if (self->connection != NULL) {
+    g_dbus_connection_close(self->connection, NULL, NULL, NULL);
+    g_clear_object(&self->connection);
+  }
+  if (self->process != NULL) {
+    g_subprocess_force_exit(self->process);
+    g_clear_object(&self->process);
+  }
+
+  G_OBJECT_CLASS(indicator_remote_parent_class)->dispose(object);
+}
+
+static void indicator_remote_finalize(GObject *object) {
+  IndicatorRemote *self = INDICATOR_REMOTE(object);
+
+  g_ptr_array_unref(self->entries);
+  g_free(self->path);
+  g_free(self->object_path);
+  g_free(self->menu_path);
+  g_free(self->name_hint);
+
+  G_OBJECT_CLASS(indicator_remote_parent_class)->finalize(object);
+}
+
+static void indicator_remote_class_init(IndicatorRemoteClass *klass) {
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  IndicatorObjectClass *io_class = INDICATOR_OBJECT_CLASS(klass);
+
+  object_class->dispose = indicator_remote_dispose;
+  object_class->finalize = indicator_remote_finalize;
+
+  io_class->get_entries = indicator_remote_get_entries;
+  io_class->get_location = indicator_remote_get_location;
+  io_class->entry_activate = indicator_remote_entry_activate;
+  io_class->secondary_activate = indicator_remote_secondary_activate;
+  io_class->entry_scrolled = indicator_remote_entry_scrolled;
+}
+
+static void indicator_remote_init(IndicatorRemote *self) {
+  self->entries = g_ptr_array_new();
+  self->cancellable = g_cancellable_new();
+}
+
+static const gchar *host_path(void) {
+  const gchar *path = g_getenv(INDICATOR_REMOTE_HOST_ENV);
+  return (path != NULL && *path != '\0') ? path : LIBEXECDIR "/" HOST_NAME;
+}
+
+IndicatorObject *indicator_remote_new(const gchar *path, GError **error) {
+  gint fds[2];
+
+  g_return_val_if_fail(path != NULL, NULL);
+
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+    gint saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                "Unable to create a socket pair: %s", g_strerror(saved_errno));
+    return NULL;
+  }
+
+  GSocket *socket = g_socket_new_from_fd(fds[0], error);
+  if (socket == NULL) {
+    close(fds[0]);
+    close(fds[1]);
+    return NULL;
+  }
+
+  GSubprocessLauncher *launcher =
+      g_subprocess_launcher_new(G_SUBPROCESS_FLAGS_NONE);
+  g_subprocess_launcher_take_fd(launcher, fds[1], 3);
+  GSubprocess *process = g_subprocess_launcher_spawn(
+      launcher, error, host_path(), "--fd=3", path, NULL);
+  g_object_unref(launcher);
+
+  if (process == NULL) {
+    g_object_unref(socket);
+    return NULL;
+  }
+
+  IndicatorRemote *self = g_object_new(INDICATOR_REMOTE_TYPE, NULL);
+  self->path = g_strdup(path);
+  self->process = process;
+
+  g_subprocess_wait_async(process, self->cancellable, host_exited_cb, self);
+
+  GSocketConnection *stream =
+      g_socket_connection_factory_create_connection(socket);
+  gchar *guid = g_dbus_generate_guid();
+  g_dbus_connection_new(G_IO_STREAM(stream), guid,
+                        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER, NULL,
+                        self->cancellable, connection_ready_cb, self);
+  g_free(guid);
+  g_object_unref(stream);
+  g_object_unref(socket);
+
+  return INDICATOR_OBJECT(self);
+}
+
+IndicatorObject *indicator_remote_new_for_service(const gchar *service_file,
+                                                  const gchar *profile,
+                                                  GError **error) {
+  g_return_val_if_fail(service_file != NULL, NULL);
+  g_return_val_if_fail(profile != NULL, NULL);
+
+  GKeyFile *keyfile = g_key_file_new();
+  gchar *name = NULL;
+  gchar *object_path = NULL;
+  gchar *menu_path = NULL;
+
+  if (!g_key_file_load_from_file(keyfile, service_file, G_KEY_FILE_NONE,
+                                 error) ||
+      (name = g_key_file_get_string(keyfile, SERVICE_GROUP, "Name",
+                                    error)) == NULL ||
+      (object_path = g_key_file_get_string(keyfile, SERVICE_GROUP,
+                                           "ObjectPath", error)) == NULL ||
+      (menu_path = g_key_file_get_string(keyfile, profile, "ObjectPath",
+                                         error)) == NULL) {
+    g_free(name);
+    g_free(object_path);
+    g_key_file_free(keyfile);
+    return NULL;
+  }
+  g_key_file_free(keyfile);
+
+  IndicatorRemote *self = g_object_new(INDICATOR_REMOTE_TYPE, NULL);
+  /* The file is named after the service's bus name */
+  self->path = g_path_get_basename(service_file);
+  self->object_path = object_path;
+  self->menu_path = menu_path;
+  self->name_hint = name;
+
+  self->watch_id = g_bus_watch_name(
+      G_BUS_TYPE_SESSION, self->path, G_BUS_NAME_WATCHER_FLAGS_AUTO_START,
+      service_appeared_cb, service_vanished_cb, self, NULL);
+
+  return INDICATOR_OBJECT(self);
+}
+
+const gchar *indicator_remote_get_identifier(IndicatorRemote *self) {
+  g_return_val_if_fail(INDICATOR_IS_REMOTE(self), NULL);
+
+  return self->process != NULL ? g_subprocess_get_identifier(self->process)
+                               : NULL;
+}
@@ -0,0 +1,99 @@
+/*
+An indicator object whose module runs in mate-indicator-module-host, or
+that shows a new style indicator service straight from its menu model.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INDICATOR_REMOTE_H__
+#define __INDICATOR_REMOTE_H__
+
+#include <gio/gio.h>
+
+#if HAVE_UBUNTU_INDICATOR
+#include <libindicator/indicator-object.h>
+#endif
+
+#if HAVE_AYATANA_INDICATOR
+#include <libayatana-indicator/indicator-object.h>
+#endif
+
+G_BEGIN_DECLS
+
+/*
+ * The host and the applet talk over a private peer to peer D-Bus
+ * connection on a socket pair, the host exports at
+ * INDICATOR_REMOTE_OBJECT_PATH:
+ *
+ * - a menu with one item per entry, in entry order.  The item's "action"
+ *   is "indicator.entry<N>" and its "submenu" link the entry's menu.
+ * - the actions, in the "indicator" namespace for the applet.
+ *   "entry<N>" has the a{sv} header state below and activates the entry
+ *   with a u timestamp, "entry<N>-secondary" takes a u timestamp,
+ *   "entry<N>-scroll" a (iu) delta and direction and "entry<N>-menu" a b,
+ *   whether the applet shows the entry's menu.  The menu items use
+ *   "item<N>" actions, stateful with a boolean for check and radio items,
+ *   and an item keeps its action name for as long as it is shown.
+ *
+ * The header state holds "label" (s), "icon" (v, a serialized GIcon),
+ * "accessible-desc" (s), "name-hint" (s), "label-visible" (b) and
+ * "icon-visible" (b).
+ *
+ * New style services export the same shape on the session bus, with the
+ * root menu at the profile's object path and the actions at the service's.
+ * Their header state has "visible" (b) in place of the two visibility
+ * flags, and the root item names its secondary and scroll actions in
+ * "x-ayatana-" or "x-canonical-secondary-action" and "-scroll-action".
+ */
+#define INDICATOR_REMOTE_OBJECT_PATH "/org/mate/IndicatorApplet/Module"
+#define INDICATOR_REMOTE_ACTION_NAMESPACE "indicator"
+
+/* Path of the host binary, instead of the installed one */
+#define INDICATOR_REMOTE_HOST_ENV "INDICATOR_APPLET_MODULE_HOST"
+
+#define INDICATOR_REMOTE_TYPE (indicator_remote_get_type())
+#define INDICATOR_REMOTE(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), INDICATOR_REMOTE_TYPE, IndicatorRemote))
+#define INDICATOR_IS_REMOTE(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), INDICATOR_REMOTE_TYPE))
+
+typedef struct _IndicatorRemote IndicatorRemote;
+typedef struct _IndicatorRemoteClass IndicatorRemoteClass;
+
+struct _IndicatorRemoteClass {
+  IndicatorObjectClass parent_class;
+};
+
+GType indicator_remote_get_type(void);
+
+/* Starts a host for the module at path.  The entries show up as the host
+   exports them, and are all removed should the host go away. */
+IndicatorObject *indicator_remote_new(const gchar *path, GError **error);
+
+/* Shows the service described by the .indicator file at service_file, in
+   the given profile, with menus built by GTK from the service's menu model
+   rather than by libindicator.  The service is started if need be, and
+   the entries are all removed while it is not running. */
+IndicatorObject *indicator_remote_new_for_service(const gchar *service_file,
+                                                  const gchar *profile,
+                                                  GError **error);
+
+/* The host's process ID, as a string, or NULL once it exited or for a
+   service */
+const gchar *indicator_remote_get_identifier(IndicatorRemote *self);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_REMOTE_H__ */
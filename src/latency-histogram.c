@@ -0,0 +1,136 @@
+/*
+Log-linear histogram for latency measurements.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "latency-histogram.h"
+
+/* Every power of two is split into this many linear sub-buckets, which
+   keeps the reported percentiles within 12.5% of the recorded values. */
+#define SUB_BUCKET_BITS 3
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+
+/* Values up to 2^40 us (about 12 days) are told apart */
+#define MAX_EXPONENT 40
+#define N_BUCKETS ((MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS)
+
+struct _LatencyHistogram {
+  guint64 buckets[N_BUCKETS];
+  guint64 count;
+  gint64 max;
+};
+
+static guint value_to_bucket(gint64 usec) {
+  guint64 value = (usec > 0) ? (guint64)usec : 0;
+  guint exponent;
+
+  if (value < SUB_BUCKETS) {
+    return (guint)value;
+  }
+
+  if (value >> 32) {
+    exponent = 32 + g_bit_nth_msf((gulong)(value >> 32), -1);
+  } else {
+    exponent = g_bit_nth_msf((gulong)value, -1);
+  }
+  if (exponent > MAX_EXPONENT) {
+    return N_BUCKETS - 1;
+  }
+
+  return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS +
+         ((value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+}
+
+/* The largest value that lands in the given bucket */
+static gint64 bucket_to_value(guint bucket) {
+  guint exponent;
+  guint64 sub;
+
+  if (bucket < SUB_BUCKETS) {
+    return bucket;
+  }
+
+  exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+  sub = bucket % SUB_BUCKETS;
+
+  return (gint64)((((guint64)SUB_BUCKETS + sub + 1)
+                   << (exponent - SUB_BUCKET_BITS)) -
+                  1);
+}
+
+LatencyHistogram *latency_histogram_new(void) {
+  return g_new0(LatencyHistogram, 1);
+}
+
+void latency_histogram_free(LatencyHistogram *histogram) { g_free(histogram); }
+
+void latency_histogram_record(LatencyHistogram *histogram, gint64 usec) {
+  g_return_if_fail(histogram != NULL);
+
+  histogram->buckets[value_to_bucket(usec)]++;
+  histogram->count++;
+  histogram->max = MAX(histogram->max, usec);
+}
+
+guint64 latency_histogram_get_count(const LatencyHistogram *histogram) {
+  g_return_val_if_fail(histogram != NULL, 0);
+
+  return histogram->count;
+}
+
+gint64 latency_histogram_get_max(const LatencyHistogram *histogram) {
+  g_return_val_if_fail(histogram != NULL, 0);
+
+  return histogram->max;
+}
+
+/* Returns the upper bound of the bucket holding the given percentile
+   (0-100), never more than the largest value actually recorded. */
+gint64 latency_histogram_get_percentile(const LatencyHistogram *histogram,
+                                        gdouble percentile) {
+  guint64 rank, seen;
+  guint i;
+
+  g_return_val_if_fail(histogram != NULL, 0);
+
+  if (histogram->count == 0) {
+    return 0;
+  }
+
+  rank = (guint64)(histogram->count * CLAMP(percentile, 0.0, 100.0) / 100.0);
+  rank = CLAMP(rank, 1, histogram->count);
+
+  seen = 0;
+  for (i = 0; i < N_BUCKETS; i++) {
+    seen += histogram->buckets[i];
+    if (seen >= rank) {
+      return MIN(bucket_to_value(i), histogram->max);
+    }
+  }
+
+  return histogram->max;
+}
+
+gchar *latency_histogram_to_string(const LatencyHistogram *histogram) {
+  g_return_val_if_fail(histogram != NULL, NULL);
+
+  return g_strdup_printf(
+      "n=%" G_GUINT64_FORMAT " p50=%" G_GINT64_FORMAT "us p95=%" G_GINT64_FORMAT
+      "us p99=%" G_GINT64_FORMAT "us max=%" G_GINT64_FORMAT "us",
+      histogram->count, latency_histogram_get_percentile(histogram, 50.0),
+      latency_histogram_get_percentile(histogram, 95.0),
+      latency_histogram_get_percentile(histogram, 99.0), histogram->max);
+}
@@ -0,0 +1,45 @@
+/*
+Log-linear histogram for latency measurements.
+
+Copyright 2022 Libre MATE
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __LATENCY_HISTOGRAM_H__
+#define __LATENCY_HISTOGRAM_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _LatencyHistogram LatencyHistogram;
+
+LatencyHistogram *latency_histogram_new(void);
+
+void latency_histogram_free(LatencyHistogram *histogram);
+
+void latency_histogram_record(LatencyHistogram *histogram, gint64 usec);
+
+guint64 latency_histogram_get_count(const LatencyHistogram *histogram);
+
+gint64 latency_histogram_get_max(const LatencyHistogram *histogram);
+
+gint64 latency_histogram_get_percentile(const LatencyHistogram *histogram,
+                                        gdouble percentile);
+
+gchar *latency_histogram_to_string(const LatencyHistogram *histogram);
+
+G_END_DECLS
+
+#endif /* __LATENCY_HISTOGRAM_H__ */
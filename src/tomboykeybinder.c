@@ -19,10 +19,15 @@
 #include "tomboykeybinder.h"
 
 #include <X11/Xlib.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <gdk/gdk.h>
 #include <gdk/gdkwindow.h>
 #include <gdk/gdkx.h>
+#include <glib-unix.h>
+#include <poll.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "eggaccelerators.h"
 
@@ -43,14 +48,76 @@ typedef struct _Binding {
   char *keystring;
   uint keycode;
   uint modifiers;
+  guint id;
 } Binding;
 
 static GSList *bindings = NULL;
+static guint next_binding_id = 1;
 static guint32 last_event_time = 0;
+static gint64 last_event_received = 0;
 static gboolean processing_event = FALSE;
 
 static guint num_lock_mask, caps_lock_mask, scroll_lock_mask;
 
+/*
+ * Threaded mode: the key grabs live on a private X connection serviced
+ * by a dedicated thread, so a busy main loop does not delay reception.
+ * Matched presses are handed to the main loop through a single-producer,
+ * single-consumer ring and dispatched from a high priority idle.
+ */
+
+typedef struct _GrabRequest {
+  uint keycode;
+  uint modifiers;
+  guint id;
+} GrabRequest;
+
+typedef struct _HotkeyEvent {
+  guint id;
+  guint32 time;
+  gint64 received;
+} HotkeyEvent;
+
+/* Must be a power of two */
+#define HOTKEY_QUEUE_SIZE 64
+
+/* How long the main loop waits for the thread to apply new grabs */
+#define HOTKEY_GRAB_TIMEOUT_US (G_USEC_PER_SEC / 2)
+
+static struct {
+  GThread *thread;
+  Display *xdisplay;
+  gint wakeup_pipe[2];
+
+  /* Protects the fields below, which the thread copies on wakeup */
+  GMutex lock;
+  GArray *requests;
+  guint ignorable_masks[3];
+  gboolean quit;
+  /* Bumped by the main loop for each new set of requests, and by the
+     thread once it has grabbed them, with the IDs it failed to grab */
+  guint requested;
+  guint applied;
+  GArray *failed;
+  GCond applied_cond;
+
+  /* Set by the error handler while the thread grabs, only it touches this */
+  gboolean grab_error;
+
+  /* Ring buffer; tail is written by the thread, head by the main loop */
+  HotkeyEvent queue[HOTKEY_QUEUE_SIZE];
+  gint head;
+  gint tail;
+  gint dispatch_pending;
+} hotkey_thread;
+
+/* Set by tomboy_keybinder_init_threaded(), the thread is started by the
+   first binding and stopped by tomboy_keybinder_shutdown() */
+static gboolean threaded = FALSE;
+static XErrorHandler previous_error_handler = NULL;
+
+static TomboyDispatchHandler dispatch_handler = NULL;
+
 static void lookup_ignorable_modifiers(GdkKeymap *keymap) {
   egg_keymap_resolve_virtual_modifiers(keymap, EGG_VIRTUAL_LOCK_MASK,
                                        &caps_lock_mask);
@@ -116,6 +183,10 @@ static gboolean do_grab_key(Binding *binding) {
 
   TRACE(g_print("Got modmask %d\n", binding->modifiers));
 
+  /* The hotkey thread grabs on its own connection, see
+     hotkey_thread_grab_failed() */
+  if (hotkey_thread.thread != NULL) return TRUE;
+
   gdk_x11_display_error_trap_push(gdk_display);
 
   grab_ungrab_with_ignorable_modifiers(rootwin, binding, TRUE /* grab */);
@@ -135,6 +206,8 @@ static gboolean do_ungrab_key(Binding *binding) {
 
   TRACE(g_print("Removing grab for '%s'\n", binding->keystring));
 
+  if (hotkey_thread.thread != NULL) return TRUE;
+
   grab_ungrab_with_ignorable_modifiers(rootwin, binding, FALSE /* ungrab */);
 
   return TRUE;
@@ -161,6 +234,7 @@ static GdkFilterReturn filter_func(GdkXEvent *gdk_xevent,
        */
       processing_event = TRUE;
       last_event_time = xevent->xkey.time;
+      last_event_received = g_get_monotonic_time();
 
       event_mods = xevent->xkey.state &
                    ~(num_lock_mask | caps_lock_mask | scroll_lock_mask);
@@ -186,6 +260,283 @@ static GdkFilterReturn filter_func(GdkXEvent *gdk_xevent,
   return return_val;
 }
 
+static void hotkey_thread_wakeup(void) {
+  gssize written;
+
+  do {
+    written = write(hotkey_thread.wakeup_pipe[1], "w", 1);
+  } while (written < 0 && errno == EINTR);
+}
+
+/*
+ * Publishes the current set of bindings to the hotkey thread.  With wait,
+ * waits for it to grab them, so that failures can be reported as they are
+ * without the thread.
+ */
+static void hotkey_thread_update_grabs(gboolean wait) {
+  GSList *iter;
+  guint requested;
+  gint64 deadline;
+
+  if (hotkey_thread.thread == NULL) return;
+
+  g_mutex_lock(&hotkey_thread.lock);
+
+  g_array_set_size(hotkey_thread.requests, 0);
+  for (iter = bindings; iter != NULL; iter = iter->next) {
+    Binding *binding = (Binding *)iter->data;
+    GrabRequest request = {binding->keycode, binding->modifiers, binding->id};
+
+    g_array_append_val(hotkey_thread.requests, request);
+  }
+
+  hotkey_thread.ignorable_masks[0] = num_lock_mask;
+  hotkey_thread.ignorable_masks[1] = caps_lock_mask;
+  hotkey_thread.ignorable_masks[2] = scroll_lock_mask;
+  requested = ++hotkey_thread.requested;
+
+  hotkey_thread_wakeup();
+
+  deadline = g_get_monotonic_time() + HOTKEY_GRAB_TIMEOUT_US;
+  while (wait && hotkey_thread.applied != requested) {
+    if (!g_cond_wait_until(&hotkey_thread.applied_cond, &hotkey_thread.lock,
+                           deadline)) {
+      g_warning("Hotkey thread did not grab the keys in time");
+      break;
+    }
+  }
+
+  g_mutex_unlock(&hotkey_thread.lock);
+}
+
+/* Whether the hotkey thread could not grab the binding, as of the last
+   hotkey_thread_update_grabs() */
+static gboolean hotkey_thread_grab_failed(const Binding *binding) {
+  gboolean failed = FALSE;
+  guint i;
+
+  g_mutex_lock(&hotkey_thread.lock);
+  for (i = 0; i < hotkey_thread.failed->len && !failed; i++) {
+    failed = g_array_index(hotkey_thread.failed, guint, i) == binding->id;
+  }
+  g_mutex_unlock(&hotkey_thread.lock);
+
+  return failed;
+}
+
+static gboolean hotkey_thread_dispatch(gpointer data G_GNUC_UNUSED) {
+  gint head;
+
+  /* Reset before draining so a press queued meanwhile schedules us again */
+  g_atomic_int_set(&hotkey_thread.dispatch_pending, 0);
+
+  head = g_atomic_int_get(&hotkey_thread.head);
+  while (head != g_atomic_int_get(&hotkey_thread.tail)) {
+    HotkeyEvent event =
+        hotkey_thread.queue[(guint)head & (HOTKEY_QUEUE_SIZE - 1)];
+    gint64 latency = g_get_monotonic_time() - event.received;
+    GSList *iter;
+
+    head++;
+    g_atomic_int_set(&hotkey_thread.head, head);
+
+    if (dispatch_handler != NULL) dispatch_handler(latency);
+
+    processing_event = TRUE;
+    last_event_time = event.time;
+    last_event_received = event.received;
+
+    for (iter = bindings; iter != NULL; iter = iter->next) {
+      Binding *binding = (Binding *)iter->data;
+
+      if (binding->id != event.id) continue;
+
+      g_debug("Hotkey '%s' dispatched %" G_GINT64_FORMAT " us after reception",
+              binding->keystring, latency);
+
+      (binding->handler)(binding->keystring, binding->user_data);
+      break;
+    }
+
+    processing_event = FALSE;
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Xlib's error handler is process wide, so errors on the thread's own
+ * connection are told apart by display and everything else goes to the
+ * handler installed before, GDK's.  Xlib calls it from the thread reading
+ * the reply, which for the thread's connection is the thread itself.
+ * While GDK has an error trap pushed its own handler is installed, which
+ * ignores errors on displays it did not open, so a grab failing just then
+ * goes unreported rather than fatal.  BadAccess is the usual error,
+ * another client holding the combination.
+ */
+static int hotkey_thread_error(Display *xdisplay, XErrorEvent *error) {
+  if (xdisplay != hotkey_thread.xdisplay) {
+    return previous_error_handler != NULL
+               ? previous_error_handler(xdisplay, error)
+               : 0;
+  }
+
+  TRACE(g_print("Hotkey thread got X error %d\n", error->error_code));
+
+  hotkey_thread.grab_error = TRUE;
+  return 0;
+}
+
+/* Returns FALSE if the server refused any of the grabs */
+static gboolean hotkey_thread_grab(Display *xdisplay,
+                                   const GrabRequest *request,
+                                   const guint *masks, gboolean grab) {
+  guint mod_masks[] = {
+      0, /* modifier only */
+      masks[0],
+      masks[1],
+      masks[2],
+      masks[0] | masks[1],
+      masks[0] | masks[2],
+      masks[1] | masks[2],
+      masks[0] | masks[1] | masks[2],
+  };
+  Window root = DefaultRootWindow(xdisplay);
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(mod_masks); i++) {
+    if (grab) {
+      XGrabKey(xdisplay, request->keycode, request->modifiers | mod_masks[i],
+               root, False, GrabModeAsync, GrabModeAsync);
+    } else {
+      XUngrabKey(xdisplay, request->keycode, request->modifiers | mod_masks[i],
+                 root);
+    }
+  }
+
+  hotkey_thread.grab_error = FALSE;
+  XSync(xdisplay, False);
+  return !hotkey_thread.grab_error;
+}
+
+static void hotkey_thread_key_press(const XKeyEvent *xkey,
+                                    const GArray *grabbed,
+                                    const guint *masks) {
+  guint event_mods = xkey->state & ~(masks[0] | masks[1] | masks[2]);
+  guint i;
+
+  for (i = 0; i < grabbed->len; i++) {
+    const GrabRequest *request = &g_array_index(grabbed, GrabRequest, i);
+    HotkeyEvent *event;
+    gint tail;
+
+    if (request->keycode != xkey->keycode || request->modifiers != event_mods)
+      continue;
+
+    tail = g_atomic_int_get(&hotkey_thread.tail);
+    if ((guint)(tail - g_atomic_int_get(&hotkey_thread.head)) >=
+        HOTKEY_QUEUE_SIZE) {
+      /* The main loop is not keeping up; the press is lost either way */
+      continue;
+    }
+
+    event = &hotkey_thread.queue[(guint)tail & (HOTKEY_QUEUE_SIZE - 1)];
+    event->id = request->id;
+    event->time = xkey->time;
+    event->received = g_get_monotonic_time();
+    g_atomic_int_set(&hotkey_thread.tail, tail + 1);
+
+    if (g_atomic_int_compare_and_exchange(&hotkey_thread.dispatch_pending, 0,
+                                          1)) {
+      g_idle_add_full(G_PRIORITY_HIGH, hotkey_thread_dispatch, NULL, NULL);
+    }
+  }
+}
+
+static gpointer hotkey_thread_func(gpointer data G_GNUC_UNUSED) {
+  Display *xdisplay = hotkey_thread.xdisplay;
+  GArray *grabbed = g_array_new(FALSE, FALSE, sizeof(GrabRequest));
+  guint masks[3] = {0, 0, 0};
+  struct pollfd fds[2];
+  gboolean quit = FALSE;
+
+  fds[0].fd = ConnectionNumber(xdisplay);
+  fds[0].events = POLLIN;
+  fds[1].fd = hotkey_thread.wakeup_pipe[0];
+  fds[1].events = POLLIN;
+
+  while (!quit) {
+    /* Also flushes any requests we queued */
+    while (XPending(xdisplay) > 0) {
+      XEvent xevent;
+
+      XNextEvent(xdisplay, &xevent);
+      if (xevent.type == KeyPress) {
+        TRACE(g_print("Hotkey thread got KeyPress! keycode: %d, "
+                      "modifiers: %d\n",
+                      xevent.xkey.keycode, xevent.xkey.state));
+        hotkey_thread_key_press(&xevent.xkey, grabbed, masks);
+      }
+    }
+
+    if (poll(fds, G_N_ELEMENTS(fds), -1) < 0) {
+      if (errno == EINTR) continue;
+
+      g_warning("Hotkey thread stopped polling: %s", g_strerror(errno));
+      break;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      gchar buf[16];
+      GArray *failed = g_array_new(FALSE, FALSE, sizeof(guint));
+      guint requested;
+      guint i;
+
+      while (read(hotkey_thread.wakeup_pipe[0], buf, sizeof(buf)) > 0)
+        ;
+
+      for (i = 0; i < grabbed->len; i++) {
+        hotkey_thread_grab(xdisplay, &g_array_index(grabbed, GrabRequest, i),
+                           masks, FALSE);
+      }
+
+      g_mutex_lock(&hotkey_thread.lock);
+      g_array_set_size(grabbed, 0);
+      g_array_append_vals(grabbed, hotkey_thread.requests->data,
+                          hotkey_thread.requests->len);
+      memcpy(masks, hotkey_thread.ignorable_masks, sizeof(masks));
+      requested = hotkey_thread.requested;
+      quit = hotkey_thread.quit;
+      g_mutex_unlock(&hotkey_thread.lock);
+
+      if (quit) {
+        g_array_free(failed, TRUE);
+        break;
+      }
+
+      for (i = 0; i < grabbed->len; i++) {
+        GrabRequest *request = &g_array_index(grabbed, GrabRequest, i);
+
+        if (!hotkey_thread_grab(xdisplay, request, masks, TRUE)) {
+          /* Let go of whatever part of the combination was granted */
+          hotkey_thread_grab(xdisplay, request, masks, FALSE);
+          g_array_append_val(failed, request->id);
+        }
+      }
+
+      g_mutex_lock(&hotkey_thread.lock);
+      g_array_free(hotkey_thread.failed, TRUE);
+      hotkey_thread.failed = failed;
+      hotkey_thread.applied = requested;
+      g_cond_broadcast(&hotkey_thread.applied_cond);
+      g_mutex_unlock(&hotkey_thread.lock);
+    }
+  }
+
+  g_array_free(grabbed, TRUE);
+  return NULL;
+}
+
 static void keymap_changed(GdkKeymap *map G_GNUC_UNUSED) {
   GdkKeymap *keymap = gdk_keymap_get_for_display(gdk_display_get_default());
   GSList *iter;
@@ -203,6 +554,16 @@ static void keymap_changed(GdkKeymap *map G_GNUC_UNUSED) {
     Binding *binding = (Binding *)iter->data;
     do_grab_key(binding);
   }
+
+  if (hotkey_thread.thread == NULL) return;
+
+  hotkey_thread_update_grabs(TRUE);
+  for (iter = bindings; iter != NULL; iter = iter->next) {
+    Binding *binding = (Binding *)iter->data;
+
+    if (hotkey_thread_grab_failed(binding))
+      g_warning("Binding '%s' failed!\n", binding->keystring);
+  }
 }
 
 void tomboy_keybinder_init(void) {
@@ -216,25 +577,150 @@ void tomboy_keybinder_init(void) {
   g_signal_connect(keymap, "keys_changed", G_CALLBACK(keymap_changed), NULL);
 }
 
-void tomboy_keybinder_bind(const char *keystring, TomboyBindkeyHandler handler,
-                           gpointer user_data) {
+/* Falls back to tomboy_keybinder_init()'s filter, whose keymap handler is
+   connected already */
+static void hotkey_thread_fallback(void) {
+  threaded = FALSE;
+  gdk_window_add_filter(gdk_get_default_root_window(), filter_func, NULL);
+}
+
+static gboolean hotkey_thread_start(void) {
+  GError *error = NULL;
+
+  /* libX11 >= 1.8 initializes its thread support on its own */
+  hotkey_thread.xdisplay =
+      XOpenDisplay(DisplayString(gdk_x11_get_default_xdisplay()));
+  if (hotkey_thread.xdisplay == NULL) {
+    g_warning("Unable to open a connection for the hotkey thread");
+    return FALSE;
+  }
+
+  if (!g_unix_open_pipe(hotkey_thread.wakeup_pipe, FD_CLOEXEC, &error) ||
+      !g_unix_set_fd_nonblocking(hotkey_thread.wakeup_pipe[0], TRUE, &error)) {
+    g_warning("Unable to create the hotkey thread wakeup pipe: %s",
+              error->message);
+    g_error_free(error);
+    XCloseDisplay(hotkey_thread.xdisplay);
+    hotkey_thread.xdisplay = NULL;
+    return FALSE;
+  }
+
+  hotkey_thread.requests = g_array_new(FALSE, FALSE, sizeof(GrabRequest));
+  hotkey_thread.failed = g_array_new(FALSE, FALSE, sizeof(guint));
+  hotkey_thread.quit = FALSE;
+
+  hotkey_thread.thread =
+      g_thread_try_new("hotkeys", hotkey_thread_func, NULL, &error);
+  if (hotkey_thread.thread == NULL) {
+    g_warning("Unable to start the hotkey thread: %s", error->message);
+    g_error_free(error);
+    close(hotkey_thread.wakeup_pipe[0]);
+    close(hotkey_thread.wakeup_pipe[1]);
+    g_array_free(hotkey_thread.requests, TRUE);
+    g_array_free(hotkey_thread.failed, TRUE);
+    XCloseDisplay(hotkey_thread.xdisplay);
+    hotkey_thread.xdisplay = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Has the thread let go of its grabs and return, then closes its
+   connection */
+static void hotkey_thread_stop(void) {
+  g_mutex_lock(&hotkey_thread.lock);
+  hotkey_thread.quit = TRUE;
+  hotkey_thread_wakeup();
+  g_mutex_unlock(&hotkey_thread.lock);
+
+  g_thread_join(hotkey_thread.thread);
+  hotkey_thread.thread = NULL;
+
+  XCloseDisplay(hotkey_thread.xdisplay);
+  hotkey_thread.xdisplay = NULL;
+  close(hotkey_thread.wakeup_pipe[0]);
+  close(hotkey_thread.wakeup_pipe[1]);
+  g_array_free(hotkey_thread.requests, TRUE);
+  hotkey_thread.requests = NULL;
+  g_array_free(hotkey_thread.failed, TRUE);
+  hotkey_thread.failed = NULL;
+
+  /* Presses not dispatched yet have nothing left to go to */
+  g_atomic_int_set(&hotkey_thread.head,
+                   g_atomic_int_get(&hotkey_thread.tail));
+}
+
+/*
+ * Like tomboy_keybinder_init(), but grabs keys and receives their presses
+ * on a dedicated thread with its own X connection, started by the first
+ * binding.  Falls back to the regular main loop filter if the connection
+ * or thread can't be set up.  Must be called before any key is bound.
+ */
+void tomboy_keybinder_init_threaded(void) {
+  GdkKeymap *keymap = gdk_keymap_get_for_display(gdk_display_get_default());
+
+  g_mutex_init(&hotkey_thread.lock);
+  g_cond_init(&hotkey_thread.applied_cond);
+  /* Before any GDK error trap is pushed, see hotkey_thread_error() */
+  previous_error_handler = XSetErrorHandler(hotkey_thread_error);
+  threaded = TRUE;
+
+  lookup_ignorable_modifiers(keymap);
+
+  g_signal_connect(keymap, "keys_changed", G_CALLBACK(keymap_changed), NULL);
+}
+
+/*
+ * Stops the hotkey thread and closes its connection, for once nothing is
+ * bound any more or at exit.  The next tomboy_keybinder_bind() starts it
+ * again.
+ */
+void tomboy_keybinder_shutdown(void) {
+  if (hotkey_thread.thread == NULL) return;
+
+  hotkey_thread_stop();
+}
+
+gboolean tomboy_keybinder_bind(const char *keystring,
+                               TomboyBindkeyHandler handler,
+                               gpointer user_data) {
   Binding *binding;
   gboolean success;
 
+  if (threaded && hotkey_thread.thread == NULL && !hotkey_thread_start())
+    hotkey_thread_fallback();
+
   binding = g_new0(Binding, 1);
   binding->keystring = g_strdup(keystring);
   binding->handler = handler;
   binding->user_data = user_data;
+  binding->id = next_binding_id++;
 
   /* Sets the binding's keycode and modifiers */
   success = do_grab_key(binding);
 
   if (success) {
     bindings = g_slist_prepend(bindings, binding);
-  } else {
+
+    if (hotkey_thread.thread != NULL) {
+      hotkey_thread_update_grabs(TRUE);
+      if (hotkey_thread_grab_failed(binding)) {
+        g_warning("Binding '%s' failed!\n", binding->keystring);
+        bindings = g_slist_remove(bindings, binding);
+        /* The thread let go of it already, only forget the request */
+        hotkey_thread_update_grabs(FALSE);
+        success = FALSE;
+      }
+    }
+  }
+
+  if (!success) {
     g_free(binding->keystring);
     g_free(binding);
   }
+
+  return success;
 }
 
 void tomboy_keybinder_unbind(const char *keystring,
@@ -251,6 +737,8 @@ void tomboy_keybinder_unbind(const char *keystring,
     do_ungrab_key(binding);
 
     bindings = g_slist_remove(bindings, binding);
+    /* Nothing to report, the thread lets go of it on its own time */
+    hotkey_thread_update_grabs(FALSE);
 
     g_free(binding->keystring);
     g_free(binding);
@@ -291,3 +779,23 @@ guint32 tomboy_keybinder_get_current_event_time(void) {
   else
     return GDK_CURRENT_TIME;
 }
+
+/*
+ * Monotonic time at which the key press being handled was received by
+ * the keybinder, or 0 outside of a handler.
+ */
+gint64 tomboy_keybinder_get_current_event_received(void) {
+  if (processing_event)
+    return last_event_received;
+  else
+    return 0;
+}
+
+/*
+ * Called on the main loop with how long each press handed over by the
+ * hotkey thread waited to be dispatched, in microseconds.  Never called
+ * unless tomboy_keybinder_init_threaded() is in use.
+ */
+void tomboy_keybinder_set_dispatch_handler(TomboyDispatchHandler handler) {
+  dispatch_handler = handler;
+}
@@ -25,10 +25,17 @@ G_BEGIN_DECLS
 
 typedef void (*TomboyBindkeyHandler)(char *keystring, gpointer user_data);
 
+typedef void (*TomboyDispatchHandler)(gint64 latency);
+
 void tomboy_keybinder_init(void);
 
-void tomboy_keybinder_bind(const char *keystring, TomboyBindkeyHandler handler,
-                           gpointer user_data);
+void tomboy_keybinder_init_threaded(void);
+
+void tomboy_keybinder_shutdown(void);
+
+gboolean tomboy_keybinder_bind(const char *keystring,
+                               TomboyBindkeyHandler handler,
+                               gpointer user_data);
 
 void tomboy_keybinder_unbind(const char *keystring,
                              TomboyBindkeyHandler handler);
@@ -37,6 +44,10 @@ gboolean tomboy_keybinder_is_modifier(guint keycode);
 
 guint32 tomboy_keybinder_get_current_event_time(void);
 
+gint64 tomboy_keybinder_get_current_event_received(void);
+
+void tomboy_keybinder_set_dispatch_handler(TomboyDispatchHandler handler);
+
 G_END_DECLS
 
 #endif /* __TOMBOY_KEY_BINDER_H__ */